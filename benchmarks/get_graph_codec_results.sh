@@ -0,0 +1,21 @@
+outfile=results/graph_codec_results.data
+
+rm $outfile
+touch $outfile
+
+cd ../querier && make graph_bench && cd ../benchmarks
+
+for f in results/*.prov; do
+    (echo File $f) >> $outfile
+    base=$(basename $f .prov)
+    cd ../compression
+    ./compress_graph_v2.py ../benchmarks/$f
+    ./compress_graph_ef.py ../benchmarks/$f
+    ./compress_graph_bw.py ../benchmarks/$f
+    ./compress_graph_ref.py ../benchmarks/$f
+    ./compress_graph_paged.py ../benchmarks/$f
+    ../querier/graph_bench $base.cpg2 $base.cpge $base.cpgb $base.cpgr \
+        $base.cpgp >> ../benchmarks/$outfile
+    rm $base.cpg2 $base.cpge $base.cpgb $base.cpgr $base.cpgp
+    cd ../benchmarks
+done
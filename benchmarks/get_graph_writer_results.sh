@@ -0,0 +1,16 @@
+outfile=results/graph_writer_results.data
+
+rm $outfile
+touch $outfile
+
+cd ../querier && make graph_write_bench && cd ../benchmarks
+
+for f in results/*.prov; do
+    (echo File $f) >> $outfile
+    base=$(basename $f .prov)
+    cd ../compression
+    ./compress_graph_v2.py --time ../benchmarks/$f >> ../benchmarks/$outfile
+    ../querier/graph_write_bench $base.cpg2 >> ../benchmarks/$outfile
+    rm $base.cpg2
+    cd ../benchmarks
+done
@@ -0,0 +1,21 @@
+outfile=results/query_bench_results.data
+
+rm $outfile
+touch $outfile
+
+cd ../querier && make query_bench && cd ../benchmarks
+
+# compressed and JSON backends, side by side in one process per trace
+for f in results/*.prov; do
+    echo File $f
+    (echo File $f) >> $outfile
+    base=$(basename $f .prov)
+    cd ../compression && ./main.py ../benchmarks/$f --archive=$base.cpa
+    cd ../querier
+    ./query_bench --archive=../compression/$base.cpa \
+        --auditfile=../benchmarks/$f --queries=0,1,2,3,4,5 \
+        --json=../benchmarks/results/$base.bench.json \
+        >> ../benchmarks/$outfile
+    rm ../compression/$base.cpa
+    cd ../benchmarks
+done
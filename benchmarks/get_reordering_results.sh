@@ -0,0 +1,20 @@
+outfile=results/reordering_results.data
+declare -a orders=( bfs rcm gorder time-task )
+
+rm $outfile
+touch $outfile
+
+cd ../querier && make graph_bench && cd ../benchmarks
+
+for f in results/*.prov; do
+    (echo File $f) >> $outfile
+    cd ../compression
+    for o in ${orders[@]}; do
+        ./main.py ../benchmarks/$f --order=$o
+        mv graph.cpg graph.$o.cpg
+    done
+    ../querier/graph_bench --no-check $(for o in ${orders[@]}; do
+        echo graph.$o.cpg; done) >> ../benchmarks/$outfile
+    rm graph.*.cpg
+    cd ../benchmarks
+done
@@ -0,0 +1,31 @@
+outfile=results/scaling_results.data
+
+rm $outfile
+touch $outfile
+
+cd ../querier && make synth_trace query_bench && cd ../benchmarks
+
+# synthetic CamFlow logs of growing size; the compressor (in Python) bounds
+# how far this goes, so larger logs are only generated and timed
+for nodes in 10000 100000 1000000; do
+    for skew in 0 1; do
+        (echo Nodes $nodes skew $skew) >> $outfile
+        base=synth_${nodes}_$skew
+        ../querier/synth_trace --nodes=$nodes --skew=$skew \
+            --out=results/$base.log 2>> $outfile
+        cd ../compression && ./main.py ../benchmarks/results/$base.log \
+            --archive=$base.cpa
+        cd ../querier
+        ./query_bench --archive=../compression/$base.cpa \
+            --auditfile=../benchmarks/results/$base.log --queries=0,1,2,3,4,5 \
+            --json=../benchmarks/results/$base.bench.json \
+            >> ../benchmarks/$outfile
+        rm ../compression/$base.cpa ../benchmarks/results/$base.log
+        cd ../benchmarks
+    done
+done
+
+for nodes in 10000000 100000000 1000000000; do
+    (echo Nodes $nodes generated) >> $outfile
+    (time ../querier/synth_trace --nodes=$nodes > /dev/null) 2>> $outfile
+done
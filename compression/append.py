@@ -0,0 +1,164 @@
+#!/usr/bin/python3
+
+'''
+Adds a batch of CamFlow records to an archive (archive.py) without
+recompressing what is already in it. The batch is compressed as a trace of
+its own, a segment, using the dictionaries of the archive's base trace, and
+added as one SECTION_SEGMENT section. A segment is itself an archive of:
+
+    the compressed metadata, identifiers and graph of the batch, with its
+        nodes numbered on their own
+    SECTION_NODE_MAP: the id of each of its nodes in the archive as a
+        whole. Nodes the base or an earlier segment has keep their id; new
+        ones are numbered on from the last.
+    SECTION_JOURNAL: the batch, for compact.py
+
+Nodes the batch refers to without defining are in the segment as
+"unknown", as in any trace. The querier takes each node's metadata from the
+first part of the archive (the base, then the segments in order) that has
+the node, and its edges from all of them.
+'''
+
+import fcntl
+import os
+import sys
+import zlib
+from archive import (
+    append_sections,
+    archive_bytes,
+    ArchiveReader,
+    SECTION_COMMON_STRS_BIN,
+    SECTION_COMMON_STRS_TXT,
+    SECTION_GRAPH,
+    SECTION_IDENTIFIERS,
+    SECTION_JOURNAL,
+    SECTION_METADATA,
+    SECTION_NODE_MAP,
+    SECTION_PROV_DICTS,
+    SECTION_SEGMENT,
+)
+from compress_graph_v2 import GraphCompressorV2
+from compress_metadata import CompressionEncoder, load_dicts
+from preprocess_v2 import clean_camflow_json, PreprocessorV2
+
+NODE_ID_BYTES = 4
+
+def compress_trace(records, dicts=None, order="bfs"):
+    '''
+    Compresses records as main.py does, returning the sections of their
+    archive instead of writing files. With dicts (load_dicts), the trace is
+    encoded with them and they are left out.
+    '''
+    pp = PreprocessorV2(records, order, identifiers_file=None)
+    pp.process()
+    e = CompressionEncoder(pp, dicts)
+    e.compress_metadata()
+    c = GraphCompressorV2(pp)
+    c.compress()
+    sections = [
+        (SECTION_METADATA, 1, e.metadata_bytes()),
+        (SECTION_IDENTIFIERS, 1, pp.identifiers_byts),
+        (SECTION_GRAPH, 1, bytes(c.header_byts + c.node_byts)),
+    ]
+    if not dicts:
+        files = e.dict_files()
+        sections += [
+            (SECTION_COMMON_STRS_TXT, 1, files["common_strs.txt"]),
+            (SECTION_COMMON_STRS_BIN, 1, files["common_strs.bin"]),
+            (SECTION_PROV_DICTS, 1, files["prov_data_dicts.txt"]),
+        ]
+    return sections
+
+def read_identifiers(byts):
+    '''
+    The node identifiers in an identifiers section, in node order.
+    '''
+    count = int.from_bytes(byts[:4], byteorder="big")
+    return byts[4:].decode().split(",")[:count]
+
+def read_node_map(byts):
+    return [int.from_bytes(byts[i:i + NODE_ID_BYTES], byteorder="big")
+            for i in range(0, len(byts), NODE_ID_BYTES)]
+
+def read_dicts(reader):
+    return load_dicts(reader.read(SECTION_PROV_DICTS),
+                      reader.read(SECTION_COMMON_STRS_TXT),
+                      reader.read(SECTION_COMMON_STRS_BIN))
+
+def node_ids(reader):
+    '''
+    The id of every node in the archive, by identifier.
+    '''
+    ids = {_id:i for (i, _id) in
+           enumerate(read_identifiers(reader.read(SECTION_IDENTIFIERS)))}
+    for i in range(reader.count(SECTION_SEGMENT)):
+        segment = ArchiveReader(reader.read(SECTION_SEGMENT, i))
+        identifiers = read_identifiers(segment.read(SECTION_IDENTIFIERS))
+        node_map = read_node_map(segment.read(SECTION_NODE_MAP))
+        ids.update(zip(identifiers, node_map))
+    return ids
+
+def make_segment(records, journal, dicts, ids):
+    '''
+    The segment for records, given the archive's dictionaries and node ids,
+    which are updated with its new nodes.
+    '''
+    sections = compress_trace(records, dicts)
+    identifiers = read_identifiers(sections[1][2])
+    node_map = bytearray()
+    for _id in identifiers:
+        node_map.extend(ids.setdefault(_id, len(ids)).to_bytes(
+            NODE_ID_BYTES, byteorder="big"))
+    sections.append((SECTION_NODE_MAP, 1, bytes(node_map)))
+    sections.append((SECTION_JOURNAL, 1, zlib.compress(journal)))
+    return archive_bytes(sections)
+
+def has_records(records):
+    '''
+    Whether records hold any node or relation, rather than only prefixes.
+    '''
+    return any(v for r in records for (k, v) in r.items() if k != "prefix")
+
+def add_segment(path, journal):
+    '''
+    Adds the records in journal, the bytes of a CamFlow log, to the archive
+    at path as a new segment. A journal with no records adds nothing, and
+    returns False.
+    '''
+    records = clean_camflow_json(journal.decode().splitlines())
+    if not has_records(records):
+        print("No records in the batch for", path, "- nothing appended")
+        return False
+    with open(path, "rb") as f:
+        reader = ArchiveReader(f)
+        segment = make_segment(records, journal, read_dicts(reader),
+                               node_ids(reader))
+    append_sections(path, [(SECTION_SEGMENT, 1, segment)])
+    return True
+
+def lock_archive(path):
+    '''
+    Opens the archive at path with an exclusive lock, which appends and
+    compactions hold while they change it. Compaction replaces the file, so
+    the lock is retaken if it was replaced while waiting for it.
+    '''
+    while True:
+        f = open(path, "rb")
+        fcntl.flock(f, fcntl.LOCK_EX)
+        if os.fstat(f.fileno()).st_ino == os.stat(path).st_ino:
+            return f
+        f.close()
+
+def append_batch(path, journal):
+    with lock_archive(path):
+        return add_segment(path, journal)
+
+def main():
+    if len(sys.argv) != 3:
+        print("Usage: ./append.py [archive] [logfile]")
+        sys.exit(1)
+    with open(sys.argv[2], "rb") as f:
+        append_batch(sys.argv[1], f.read())
+
+if __name__ == "__main__":
+    main()
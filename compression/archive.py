@@ -0,0 +1,249 @@
+#!/usr/bin/python3
+
+'''
+Packs the files main.py writes for one trace (compressed metadata,
+identifiers, common strings, prov dictionaries and graph) into a single
+archive, which the querier maps once and reads sections of in place.
+
+An archive is a 64-byte header:
+
+    magic "PROVARCH", format version (32 bits), section count (32 bits),
+    offset of the section directory (64 bits), feature flags (32 bits),
+    CRC-32C of the directory (32 bits), CRC-32C of the header up to here
+    (32 bits), then zeros
+
+then the sections, then the directory, one 32-byte entry per section:
+
+    type (32 bits), section version (32 bits), offset (64 bits),
+    length (64 bits), checksum of the section (32 bits), 32 zero bits
+
+Every section starts on a 64-byte boundary and is followed by at least
+PADDING zero bytes, so readers may load whole words past its end. All
+integers are big-endian.
+
+Version 1 archives stop the header after the directory offset, and
+checksum sections with zlib's CRC-32; they are still read, and sections
+appended to one are written the same way. A reader must refuse feature
+flags it does not know.
+
+Sections may be added to an archive after it is written (append_sections):
+they and a new directory go at its end, and the header is rewritten to
+point at the new directory. The old directory is left where it was.
+'''
+
+import io
+import struct
+import sys
+import zlib
+
+MAGIC = b"PROVARCH"
+VERSION = 2
+ALIGN = 64
+PADDING = 16
+
+SECTION_METADATA = 1
+SECTION_IDENTIFIERS = 2
+SECTION_COMMON_STRS_TXT = 3
+SECTION_COMMON_STRS_BIN = 4
+SECTION_PROV_DICTS = 5
+SECTION_GRAPH = 6
+# The raw records the trace was compressed from, zlib-compressed
+SECTION_JOURNAL = 7
+# A trace appended to the archive (append.py), itself an archive
+SECTION_SEGMENT = 8
+# For a segment, the global node id of each of its nodes (32 bits each)
+SECTION_NODE_MAP = 9
+
+# Section checksums are CRC-32C rather than zlib's CRC-32
+FEATURE_CRC32C = 1
+FEATURES = FEATURE_CRC32C
+
+HEADER_V1 = struct.Struct(">8sIIQ")
+HEADER = struct.Struct(">8sIIQII")
+CHECKSUM = struct.Struct(">I")
+ENTRY = struct.Struct(">IIQQII")
+
+def _crc32c_table():
+    table = []
+    for i in range(256):
+        c = i
+        for _ in range(8):
+            c = (c >> 1) ^ 0x82F63B78 if c & 1 else c >> 1
+        table.append(c)
+    return table
+
+_CRC32C_TABLE = _crc32c_table()
+
+def crc32c(byts, crc=0):
+    '''
+    CRC-32C (Castagnoli) of byts, continuing from the CRC of the bytes
+    before them.
+    '''
+    table = _CRC32C_TABLE
+    crc ^= 0xFFFFFFFF
+    for b in byts:
+        crc = table[(crc ^ b) & 0xFF] ^ (crc >> 8)
+    return crc ^ 0xFFFFFFFF
+
+def _checksum(features):
+    return crc32c if features & FEATURE_CRC32C else zlib.crc32
+
+def _align(n):
+    return (n + ALIGN - 1) // ALIGN * ALIGN
+
+def _write_sections(f, sections, entries, features=FEATURES):
+    # Writes sections at the aligned end of f, adding their directory
+    # entries to entries
+    checksum = _checksum(features)
+    for (typ, version, byts) in sections:
+        f.write(b"\0" * (_align(f.tell()) - f.tell()))
+        entries.append((typ, version, f.tell(), len(byts), checksum(byts)))
+        f.write(byts)
+        f.write(b"\0" * PADDING)
+    f.write(b"\0" * (_align(f.tell()) - f.tell()))
+
+def _write_directory(f, entries, version=VERSION, features=FEATURES):
+    dir_offset = f.tell()
+    directory = b"".join(ENTRY.pack(*entry, 0) for entry in entries)
+    f.write(directory)
+    f.write(b"\0" * (_align(f.tell()) - f.tell()))
+    f.seek(0)
+    if version == 1:
+        f.write(HEADER_V1.pack(MAGIC, version, len(entries), dir_offset))
+    else:
+        header = HEADER.pack(MAGIC, version, len(entries), dir_offset,
+                             features, crc32c(directory))
+        f.write(header + CHECKSUM.pack(crc32c(header)))
+
+def _write(f, sections):
+    f.write(b"\0" * ALIGN)
+    entries = []
+    _write_sections(f, sections, entries)
+    _write_directory(f, entries)
+
+def write_archive(path, sections):
+    '''
+    Writes sections, a list of (type, version, bytes), to path.
+    '''
+    with open(path, "wb") as f:
+        _write(f, sections)
+
+def archive_bytes(sections):
+    '''
+    The archive write_archive would write, as bytes.
+    '''
+    f = io.BytesIO()
+    _write(f, sections)
+    return f.getvalue()
+
+def append_sections(path, sections):
+    '''
+    Adds sections, a list of (type, version, bytes), to the archive at path.
+    The header is only rewritten once the sections and new directory are
+    written, so a reader that opens the archive meanwhile sees it as it was.
+    '''
+    with open(path, "r+b") as f:
+        reader = ArchiveReader(f)
+        entries = reader.entries
+        f.seek(0, io.SEEK_END)
+        _write_sections(f, sections, entries, reader.features)
+        f.flush()
+        _write_directory(f, entries, reader.version, reader.features)
+
+class ArchiveReader:
+    '''
+    Reads the sections of an archive, in a file or in bytes, as they are
+    asked for, checking each one's checksum.
+    '''
+
+    def __init__(self, f):
+        if isinstance(f, (bytes, bytearray)):
+            f = io.BytesIO(f)
+        self.f = f
+        f.seek(0)
+        header = f.read(ALIGN)
+        (magic, self.version, count, dir_offset) = HEADER_V1.unpack(
+            header[:HEADER_V1.size])
+        assert magic == MAGIC, "not an archive"
+        assert self.version in (1, VERSION), \
+            "unsupported version %d" % self.version
+        self.features = 0
+        if self.version > 1:
+            (_, _, _, _, self.features, dir_crc) = HEADER.unpack(
+                header[:HEADER.size])
+            (header_crc,) = CHECKSUM.unpack(
+                header[HEADER.size:HEADER.size + CHECKSUM.size])
+            assert crc32c(header[:HEADER.size]) == header_crc, \
+                "bad header checksum"
+            assert not self.features & ~FEATURES, \
+                "unsupported features %#x" % self.features
+        f.seek(dir_offset)
+        directory = f.read(count * ENTRY.size)
+        assert self.version == 1 or crc32c(directory) == dir_crc, \
+            "bad directory checksum"
+        self.entries = [ENTRY.unpack_from(directory, i * ENTRY.size)[:5]
+                        for i in range(count)]
+
+    def count(self, typ):
+        return sum(1 for entry in self.entries if entry[0] == typ)
+
+    def has_section(self, typ):
+        return self.count(typ) > 0
+
+    def read(self, typ, i=0):
+        '''
+        The bytes of the i'th section of type typ.
+        '''
+        (_, _, offset, length, crc) = [e for e in self.entries
+                                       if e[0] == typ][i]
+        self.f.seek(offset)
+        data = self.f.read(length)
+        assert _checksum(self.features)(data) == crc, \
+            "bad checksum in section %d" % typ
+        return data
+
+def read_archive(path):
+    '''
+    Returns {type: (version, bytes)} for the sections of an archive,
+    checking each one's checksum. Of several sections of one type, the last is
+    returned.
+    '''
+    sections = {}
+    with open(path, "rb") as f:
+        reader = ArchiveReader(f)
+        for (typ, version, _, _, _) in reader.entries:
+            sections[typ] = (version, reader.read(typ, reader.count(typ) - 1))
+    return sections
+
+def archive_trace(path, metafile="compressed_metadata.txt",
+                  graphfile="graph.cpg", journal=None):
+    '''
+    Packs the files main.py wrote in the current directory, and the log
+    they were compressed from if journal names it, which lets compact.py
+    rebuild the archive later.
+    '''
+    files = [
+        (SECTION_METADATA, metafile),
+        (SECTION_IDENTIFIERS, "identifiers.txt"),
+        (SECTION_COMMON_STRS_TXT, "common_strs.txt"),
+        (SECTION_COMMON_STRS_BIN, "common_strs.bin"),
+        (SECTION_PROV_DICTS, "prov_data_dicts.txt"),
+        (SECTION_GRAPH, graphfile),
+    ]
+    sections = []
+    for (typ, name) in files:
+        with open(name, "rb") as f:
+            sections.append((typ, 1, f.read()))
+    if journal:
+        with open(journal, "rb") as f:
+            sections.append((SECTION_JOURNAL, 1, zlib.compress(f.read())))
+    write_archive(path, sections)
+
+def main():
+    if len(sys.argv) > 4:
+        print("Usage: ./archive.py [archive] [metafile] [graphfile]")
+        sys.exit(1)
+    archive_trace(*(sys.argv[1:] or ["trace.cpa"]))
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,70 @@
+#!/usr/bin/python3
+
+'''
+Folds the segments of an archive (append.py) into a new base trace,
+recompressing the base and every segment from their journals, so the
+archive must have been written by main.py --journal.
+
+The new archive is built beside the old one and renamed over it, so queriers
+that have the old one open keep reading it until they reopen the archive.
+Appends may go on while it is built; those that land meanwhile are added to
+the new archive as segments before it replaces the old.
+'''
+
+import os
+import sys
+import zlib
+from append import add_segment, compress_trace, lock_archive
+from archive import (
+    ArchiveReader,
+    SECTION_JOURNAL,
+    SECTION_SEGMENT,
+    write_archive,
+)
+from preprocess_v2 import clean_camflow_json
+
+def read_journals(reader, first_segment=0):
+    '''
+    The journals of the base (unless first_segment is past it) and of the
+    segments from first_segment on.
+    '''
+    journals = []
+    if first_segment == 0:
+        if not reader.has_section(SECTION_JOURNAL):
+            print("The archive has no journal; write it with main.py "
+                  "--journal to compact it")
+            sys.exit(1)
+        journals.append(zlib.decompress(reader.read(SECTION_JOURNAL)))
+    for i in range(first_segment, reader.count(SECTION_SEGMENT)):
+        segment = ArchiveReader(reader.read(SECTION_SEGMENT, i))
+        journals.append(zlib.decompress(segment.read(SECTION_JOURNAL)))
+    return journals
+
+def compact(path):
+    with lock_archive(path) as f:
+        reader = ArchiveReader(f)
+        num_segments = reader.count(SECTION_SEGMENT)
+        journals = read_journals(reader)
+    if num_segments == 0:
+        return
+
+    journal = b"\n".join(j.rstrip(b"\n") for j in journals) + b"\n"
+    sections = compress_trace(clean_camflow_json(
+        journal.decode().splitlines()))
+    sections.append((SECTION_JOURNAL, 1, zlib.compress(journal)))
+    tmp = path + ".compact"
+    write_archive(tmp, sections)
+
+    with lock_archive(path) as f:
+        for late in read_journals(ArchiveReader(f), num_segments):
+            add_segment(tmp, late)
+        os.replace(tmp, path)
+
+def main():
+    if len(sys.argv) != 2:
+        print("Usage: ./compact.py [archive]")
+        sys.exit(1)
+    compact(sys.argv[1])
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,94 @@
+#!/usr/bin/python3
+
+from compress_graph_ef import FORMAT_TAG
+from compress_graph_v2 import GraphCompressorV2
+from preprocess_v2 import clean_camflow_json, PreprocessorV2
+import sys
+from util import nbits_for_int, WriterBitString
+
+CODEC_BLOCK_WIDTHS = ord("B")
+
+# Groups per block, as a power of two
+LOG_BLOCK_SIZE = 6
+
+class GraphCompressorBW(GraphCompressorV2):
+    '''
+    Lists are laid out as in GraphCompressorV2, but the degree and delta
+    widths are chosen for each block of 2^LOG_BLOCK_SIZE consecutive groups
+    rather than for the whole file, so an outlying delta only widens the
+    lists in its block. After the group index, the header has
+    LOG_BLOCK_SIZE in 8 bits, then for every block the forward degree,
+    forward delta, backward degree and backward delta widths, 6 bits each.
+    '''
+
+    def compress(self):
+        (graph, collapsed, uf) = self.pp.process()
+        (afwd, aback, collapsed_nodes) = self._construct_asymmetric_graphs(
+            graph, collapsed, uf)
+        (delta_fwd, _) = self._delta_encode_graph(afwd, collapsed_nodes)
+        (delta_back, _) = self._delta_encode_graph(aback, collapsed_nodes)
+        sizes = {self.pp.id2num(k):uf.get_size(k) for k in uf.leaders()}
+        nbits_size_entry = nbits_for_int(max(sizes.values()))
+
+        nodes = sorted(delta_fwd.get_vertices())
+        block_size = 1 << LOG_BLOCK_SIZE
+        blocks = []
+        for i in range(0, len(nodes), block_size):
+            block = nodes[i:i + block_size]
+            blocks.append((block, self._block_stats(block, delta_fwd),
+                           self._block_stats(block, delta_back)))
+
+        index = [0]
+        wbs = WriterBitString()
+        for (block, fwd_stats, back_stats) in blocks:
+            for node in block:
+                length = self._compress_edges(node, delta_fwd, fwd_stats, wbs)
+                length += self._compress_edges(node, delta_back, back_stats,
+                                               wbs)
+                index.append(length)
+        index.pop()
+
+        header_byts = bytearray([FORMAT_TAG, CODEC_BLOCK_WIDTHS])
+        header_byts.extend(nbits_size_entry.to_bytes(1, byteorder="big"))
+        header_byts.extend(self._compress_index(index, sizes,
+                                                nbits_size_entry))
+        header_byts.extend(LOG_BLOCK_SIZE.to_bytes(1, byteorder="big"))
+        hwbs = WriterBitString()
+        for (_, fwd_stats, back_stats) in blocks:
+            for stats in fwd_stats, back_stats:
+                hwbs.write_int(stats["nbits_degree"], 6)
+                hwbs.write_int(stats["nbits_delta"], 6)
+        header_byts.extend(hwbs.to_bytearray())
+
+        self.header_byts = header_byts
+        self.node_byts = wbs.to_bytearray()
+        self.is_initialized = True
+
+    def _block_stats(self, block, delta_graph):
+        stats = {"nbits_degree":1, "nbits_delta":1}
+        for node in block:
+            deltas = delta_graph.get_outgoing_edges(node)
+            if not deltas:
+                continue
+            stats["nbits_degree"] = max(stats["nbits_degree"],
+                                        nbits_for_int(len(deltas)))
+            stats["nbits_delta"] = max(stats["nbits_delta"],
+                                       nbits_for_int(max(abs(x)
+                                                         for x in deltas)))
+        return stats
+
+    def decompress(self):
+        raise NotImplementedError("read block width graphs with Graph_BW")
+
+
+def main():
+    for _file in sys.argv[1:]:
+        with open(_file) as f:
+            pp = PreprocessorV2(clean_camflow_json(f))
+        gc = GraphCompressorBW(pp)
+        gc.compress()
+        basename = _file.split("/")[-1].rsplit(".", 1)[0]
+        gc.write_to_file(basename, ext="cpgb")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,154 @@
+#!/usr/bin/python3
+
+from compress_graph_v2 import GraphCompressorV2
+from preprocess_v2 import clean_camflow_json, PreprocessorV2
+import sys
+from util import nbits_for_int, WriterBitString
+
+# Graph files in a format other than the original start with this byte and
+# then a codec byte; the original format starts with a bit width, which is
+# never this large.
+FORMAT_TAG = 0xFF
+CODEC_ELIAS_FANO = ord("E")
+
+# Lists with more than this many values after the first are split into
+# chunks of this many, so that reaching any value scans a bounded number of
+# bits.
+EF_PARTITION_SIZE = 128
+
+def ef_low_bits(universe, count):
+    if universe < count:
+        return 0
+    return (universe // count).bit_length() - 1
+
+def zigzag(i):
+    return i * 2 if i >= 0 else -i * 2 - 1
+
+class GraphCompressorEF(GraphCompressorV2):
+    '''
+    Same grouping of collapsed versions as GraphCompressorV2, but each group's
+    sorted edge lists are stored in Elias-Fano code, so no width is shared
+    between lists. A list is:
+
+        gamma(degree + 1)
+        gamma(zigzag(first - group id) + 1)          if degree > 0
+        the other values less the first, as a run    if degree > 1
+
+    A run of m non-decreasing values at most u is gamma(u + 1), then the low
+    l = floor(log2(u / m)) bits of each value, then the high bits in unary:
+    bit (v >> l) + i is set for the i-th value. Runs of more than
+    EF_PARTITION_SIZE values are stored as:
+
+        gamma(u + 1), 6 bits nbits_offset
+        for each chunk: its last value, in nbits_for_int(u) bits
+        for each chunk: bit offset of its end, in nbits_offset bits
+        the chunks, each a run of its values less the last value of the
+            chunk before (or less nothing, for the first)
+    '''
+
+    def compress(self):
+        (graph, collapsed, uf) = self.pp.process()
+        (afwd, aback, collapsed_nodes) = self._construct_asymmetric_graphs(
+            graph, collapsed, uf)
+        sizes = {self.pp.id2num(k):uf.get_size(k) for k in uf.leaders()}
+        nbits_size_entry = nbits_for_int(max(sizes.values()))
+
+        header_byts = bytearray([FORMAT_TAG, CODEC_ELIAS_FANO])
+        header_byts.extend(nbits_size_entry.to_bytes(1, byteorder="big"))
+        index = [0]
+        wbs = WriterBitString()
+        for node in sorted(afwd.get_vertices()):
+            length = self._compress_list(node, afwd, wbs)
+            length += self._compress_list(node, aback, wbs)
+            index.append(length)
+        index.pop()
+        header_byts.extend(self._compress_index(index, sizes,
+                                                nbits_size_entry))
+
+        self.header_byts = header_byts
+        self.node_byts = wbs.to_bytearray()
+        self.is_initialized = True
+
+    def _compress_list(self, node, graph, wbs):
+        edges = sorted(graph.get_outgoing_edges(node))
+        length = wbs.write_gamma(len(edges) + 1)
+        if not edges:
+            return length
+        first = edges[0]
+        length += wbs.write_gamma(zigzag(first - node) + 1)
+        if len(edges) > 1:
+            length += self._compress_run([e - first for e in edges[1:]], wbs)
+        return length
+
+    def _compress_run(self, values, wbs):
+        universe = values[-1]
+        if len(values) <= EF_PARTITION_SIZE:
+            length = wbs.write_gamma(universe + 1)
+            return length + self._compress_ef(values, universe, wbs)
+
+        chunks = []
+        prev = 0
+        for i in range(0, len(values), EF_PARTITION_SIZE):
+            chunk = [v - prev for v in values[i:i + EF_PARTITION_SIZE]]
+            cwbs = WriterBitString()
+            cwbs.write_gamma(chunk[-1] + 1)
+            self._compress_ef(chunk, chunk[-1], cwbs)
+            chunks.append((prev + chunk[-1], cwbs))
+            prev += chunk[-1]
+
+        ends = []
+        total = 0
+        for (_, cwbs) in chunks:
+            total += len(cwbs)
+            ends.append(total)
+        nbits_offset = nbits_for_int(total)
+        nbits_upper = nbits_for_int(universe)
+        length = wbs.write_gamma(universe + 1)
+        length += wbs.write_int(nbits_offset, 6)
+        for (last, _) in chunks:
+            length += wbs.write_int(last, nbits_upper)
+        for end in ends:
+            length += wbs.write_int(end, nbits_offset)
+        for (_, cwbs) in chunks:
+            length += self._copy_bits(cwbs, wbs)
+        return length
+
+    def _compress_ef(self, values, universe, wbs):
+        count = len(values)
+        low_bits = ef_low_bits(universe, count)
+        length = 0
+        if low_bits:
+            mask = (1 << low_bits) - 1
+            for v in values:
+                length += wbs.write_int(v & mask, low_bits)
+        high = 0
+        for (i, v) in enumerate(values):
+            bit = (v >> low_bits) + i
+            while high < bit:
+                length += wbs.write_bit(0)
+                high += 1
+            length += wbs.write_bit(1)
+            high += 1
+        return length
+
+    def _copy_bits(self, src, dest):
+        byts = src.to_bytearray()
+        for i in range(len(src)):
+            dest.write_bit((byts[i >> 3] >> (7 - (i & 7))) & 1)
+        return len(src)
+
+    def decompress(self):
+        raise NotImplementedError("read Elias-Fano graphs with Graph_EF")
+
+
+def main():
+    for _file in sys.argv[1:]:
+        with open(_file) as f:
+            pp = PreprocessorV2(clean_camflow_json(f))
+        gc = GraphCompressorEF(pp)
+        gc.compress()
+        basename = _file.split("/")[-1].rsplit(".", 1)[0]
+        gc.write_to_file(basename, ext="cpge")
+
+if __name__ == "__main__":
+    main()
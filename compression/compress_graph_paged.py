@@ -0,0 +1,161 @@
+#!/usr/bin/python3
+
+from compress_graph_ef import FORMAT_TAG
+from compress_graph_v2 import GraphCompressorV2
+from preprocess_v2 import clean_camflow_json, PreprocessorV2
+import sys
+from util import nbits_for_int, WriterBitString
+
+CODEC_PAGED = ord("P")
+
+# Page size in bytes, as a power of two
+LOG_PAGE_SIZE = 14
+
+class GraphCompressorPaged(GraphCompressorV2):
+    '''
+    Lists are encoded as in GraphCompressorV2, but instead of one index of
+    every group up front, groups are packed into pages of 2^log_page_size
+    bytes, each starting with its own index, so that a reader only needs
+    one entry per page in memory and can leave the pages themselves on
+    disk until they are read. A group too big for a page gets a run of as
+    many pages as it needs to itself.
+
+    The header is the tag and codec, the eight list widths of
+    GraphCompressorV2, then in 8 bits each: log_page_size, the width of
+    node offsets within a run, and the widths of a node id, a group number
+    and a page number. Then the node, group and run counts in 64 bits each,
+    then for every run its first node, first group and first page. Pages
+    follow, starting at the first multiple of the page size. A run is:
+
+        group count (32 bits), node count
+        for every group: its first node, relative to the run's, and the
+            bit offset of its lists from the start of the run
+        the groups' lists
+
+    The file ends with 16 zero bytes, so it can be read in place.
+    '''
+
+    def __init__(self, ppv2, log_page_size=LOG_PAGE_SIZE):
+        super().__init__(ppv2)
+        self.log_page_size = log_page_size
+
+    def compress(self):
+        (graph, collapsed, uf) = self.pp.process()
+        (afwd, aback, collapsed_nodes) = self._construct_asymmetric_graphs(
+            graph, collapsed, uf)
+        (delta_fwd, fwd_stats) = self._delta_encode_graph(afwd,
+                                                          collapsed_nodes)
+        (delta_back, back_stats) = self._delta_encode_graph(aback,
+                                                            collapsed_nodes)
+        sizes = {self.pp.id2num(k):uf.get_size(k) for k in uf.leaders()}
+        nodes = sorted(delta_fwd.get_vertices())
+        num_nodes = sum(sizes.values())
+
+        page_bits = 8 << self.log_page_size
+        nbits_page_offset = self.log_page_size + 3
+        nbits_page_nodes = nbits_for_int(num_nodes)
+        nbits_entry = nbits_page_nodes + nbits_page_offset
+        nbits_run_header = 32 + nbits_page_nodes
+
+        # Pack groups into runs greedily, in order
+        runs = [[]]
+        used = nbits_run_header
+        for node in nodes:
+            c = node in collapsed_nodes
+            length = self._edges_len(node, delta_fwd, fwd_stats[c])
+            length += self._edges_len(node, delta_back, back_stats[c])
+            if runs[-1] and used + nbits_entry + length > page_bits:
+                runs.append([])
+                used = nbits_run_header
+            runs[-1].append(node)
+            used += nbits_entry + length
+
+        page_byts = bytearray()
+        run_index = []
+        first_group = 0
+        for run in runs:
+            run_index.append((run[0], first_group, len(page_byts) //
+                              (page_bits // 8)))
+            first_group += len(run)
+            page_byts.extend(self._compress_run(
+                run, sizes, collapsed_nodes, delta_fwd, fwd_stats,
+                delta_back, back_stats, nbits_page_nodes, nbits_page_offset))
+        num_pages = len(page_byts) // (page_bits // 8)
+
+        header_byts = bytearray([FORMAT_TAG, CODEC_PAGED])
+        header_byts.extend(self._compress_header(fwd_stats, back_stats, 0)[:8])
+        nbits_node = nbits_for_int(num_nodes)
+        nbits_group = nbits_for_int(len(nodes))
+        nbits_page = nbits_for_int(num_pages)
+        for x in [self.log_page_size, nbits_page_nodes, nbits_node,
+                  nbits_group, nbits_page]:
+            header_byts.extend(x.to_bytes(1, byteorder="big"))
+        for x in [num_nodes, len(nodes), len(runs)]:
+            header_byts.extend(x.to_bytes(8, byteorder="big"))
+        wbs = WriterBitString()
+        for (node, group, page) in run_index:
+            wbs.write_int(node, nbits_node)
+            wbs.write_int(group, nbits_group)
+            wbs.write_int(page, nbits_page)
+        header_byts.extend(wbs.to_bytearray())
+        header_byts.extend(bytes(-len(header_byts) % (page_bits // 8)))
+
+        self.header_byts = header_byts
+        self.node_byts = page_byts + bytes(16)
+        self.is_initialized = True
+
+    def _compress_run(self, run, sizes, collapsed_nodes, delta_fwd, fwd_stats,
+                      delta_back, back_stats, nbits_page_nodes,
+                      nbits_page_offset):
+        lists = WriterBitString()
+        offsets = []
+        for node in run:
+            c = node in collapsed_nodes
+            offsets.append(len(lists))
+            self._compress_edges(node, delta_fwd, fwd_stats[c], lists)
+            self._compress_edges(node, delta_back, back_stats[c], lists)
+
+        wbs = WriterBitString()
+        index_len = 32 + nbits_page_nodes + len(run) * (nbits_page_nodes +
+                                                        nbits_page_offset)
+        wbs.write_int(len(run), 32)
+        wbs.write_int(sum(sizes[n] for n in run), nbits_page_nodes)
+        for (node, offset) in zip(run, offsets):
+            wbs.write_int(node - run[0], nbits_page_nodes)
+            wbs.write_int(index_len + offset, nbits_page_offset)
+        # the index ends mid-byte, so the lists are copied over bit by bit
+        byts = lists.to_bytearray()
+        for i in range(len(lists)):
+            wbs.write_bit((byts[i >> 3] >> (7 - (i & 7))) & 1)
+        byts = wbs.to_bytearray()
+        page_size = 1 << self.log_page_size
+        return byts + bytes(-len(byts) % page_size)
+
+    def _edges_len(self, node, delta_graph, stats):
+        edges = delta_graph.get_outgoing_edges(node)
+        length = stats["nbits_degree"]
+        if edges:
+            length += stats["nbits_delta"] * len(edges) + 1
+        return length
+
+    def decompress(self):
+        raise NotImplementedError("read paged graphs with Graph_Paged")
+
+
+def main():
+    # --log-page-size=N sets the page size to 2^N bytes.
+    log_page_size = LOG_PAGE_SIZE
+    for arg in sys.argv[1:]:
+        if arg.startswith("--log-page-size="):
+            log_page_size = int(arg[len("--log-page-size="):])
+            sys.argv.remove(arg)
+    for _file in sys.argv[1:]:
+        with open(_file) as f:
+            pp = PreprocessorV2(clean_camflow_json(f))
+        gc = GraphCompressorPaged(pp, log_page_size)
+        gc.compress()
+        basename = _file.split("/")[-1].rsplit(".", 1)[0]
+        gc.write_to_file(basename, ext="cpgp")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,146 @@
+#!/usr/bin/python3
+
+from collections import Counter
+from compress_graph_ef import FORMAT_TAG, zigzag
+from compress_graph_v2 import GraphCompressorV2
+from preprocess_v2 import clean_camflow_json, PreprocessorV2
+import sys
+from util import nbits_for_int, WriterBitString
+
+CODEC_REFERENCE = ord("R")
+
+# How many groups back a list may look for one to copy from, and how long
+# a chain of lists copying from lists copying from ... may be
+WINDOW = 7
+MAX_REF_CHAIN = 3
+
+def gamma_len(i):
+    return 2 * nbits_for_int(i) - 1
+
+class GraphCompressorRef(GraphCompressorV2):
+    '''
+    Groups as in GraphCompressorV2, but a group's list may be stored as a
+    copy of parts of the same-direction list of one of the WINDOW groups
+    before it, plus the values it does not copy, in the style of BV/WebGraph
+    reference compression. A list is:
+
+        gamma(r + 1)              copy from the group r before; 0 for none
+        if r > 0:
+            gamma(k + 1), then k block lengths, gamma(b + 1) for the first
+            and gamma(b) for the rest; blocks alternately copy and skip
+            values of the referenced list, starting with copy, and the
+            values after them are copied if k is even
+        gamma(n + 1)              number of residuals
+        gamma(zigzag(first residual - group id) + 1), then the gaps
+            between residuals, gamma(gap + 1)
+
+    Lists copy from lists at most MAX_REF_CHAIN deep, so decoding any list
+    decodes at most MAX_REF_CHAIN others. After the group index, the header
+    has WINDOW and MAX_REF_CHAIN in 8 bits each.
+    '''
+
+    def compress(self):
+        (graph, collapsed, uf) = self.pp.process()
+        (afwd, aback, collapsed_nodes) = self._construct_asymmetric_graphs(
+            graph, collapsed, uf)
+        sizes = {self.pp.id2num(k):uf.get_size(k) for k in uf.leaders()}
+        nbits_size_entry = nbits_for_int(max(sizes.values()))
+
+        nodes = sorted(afwd.get_vertices())
+        fwd = [sorted(afwd.get_outgoing_edges(n)) for n in nodes]
+        back = [sorted(aback.get_outgoing_edges(n)) for n in nodes]
+        fwd_depth = [0] * len(nodes)
+        back_depth = [0] * len(nodes)
+
+        index = [0]
+        wbs = WriterBitString()
+        for (i, node) in enumerate(nodes):
+            length = self._compress_list(i, node, fwd, fwd_depth, wbs)
+            length += self._compress_list(i, node, back, back_depth, wbs)
+            index.append(length)
+        index.pop()
+
+        header_byts = bytearray([FORMAT_TAG, CODEC_REFERENCE])
+        header_byts.extend(nbits_size_entry.to_bytes(1, byteorder="big"))
+        header_byts.extend(self._compress_index(index, sizes,
+                                                nbits_size_entry))
+        header_byts.extend(WINDOW.to_bytes(1, byteorder="big"))
+        header_byts.extend(MAX_REF_CHAIN.to_bytes(1, byteorder="big"))
+
+        self.header_byts = header_byts
+        self.node_byts = wbs.to_bytearray()
+        self.is_initialized = True
+
+    # Picks the cheapest way to store lists[i], with or without a reference.
+    def _compress_list(self, i, node, lists, depth, wbs):
+        edges = lists[i]
+        best = (self._residuals_len(node, edges), 0, [], edges)
+        if edges:
+            for r in range(1, min(WINDOW, i) + 1):
+                ref = lists[i - r]
+                if not ref or depth[i - r] >= MAX_REF_CHAIN:
+                    continue
+                (blocks, residuals) = self._copy_blocks(ref, edges)
+                cost = gamma_len(r + 1) + gamma_len(len(blocks) + 1)
+                cost += sum(gamma_len(b + (j == 0))
+                            for (j, b) in enumerate(blocks))
+                cost += self._residuals_len(node, residuals)
+                if cost < best[0]:
+                    best = (cost, r, blocks, residuals)
+
+        (_, r, blocks, residuals) = best
+        depth[i] = depth[i - r] + 1 if r else 0
+        length = wbs.write_gamma(r + 1)
+        if r:
+            length += wbs.write_gamma(len(blocks) + 1)
+            for (j, b) in enumerate(blocks):
+                length += wbs.write_gamma(b + (j == 0))
+        length += wbs.write_gamma(len(residuals) + 1)
+        if residuals:
+            length += wbs.write_gamma(zigzag(residuals[0] - node) + 1)
+            for (prev, cur) in zip(residuals, residuals[1:]):
+                length += wbs.write_gamma(cur - prev + 1)
+        return length
+
+    def _residuals_len(self, node, residuals):
+        length = gamma_len(len(residuals) + 1)
+        if residuals:
+            length += gamma_len(zigzag(residuals[0] - node) + 1)
+            for (prev, cur) in zip(residuals, residuals[1:]):
+                length += gamma_len(cur - prev + 1)
+        return length
+
+    # Runs of values of ref that edges has, and does not have, starting with
+    # a (possibly empty) run that it has. The last run is left implicit.
+    def _copy_blocks(self, ref, edges):
+        wanted = Counter(edges)
+        runs = []
+        copying = True
+        run = 0
+        for x in ref:
+            has = wanted[x] > 0
+            if has:
+                wanted[x] -= 1
+            if has != copying:
+                runs.append(run)
+                copying = has
+                run = 0
+            run += 1
+        runs.append(run)
+        return (runs[:-1], sorted(wanted.elements()))
+
+    def decompress(self):
+        raise NotImplementedError("read reference graphs with Graph_Ref")
+
+
+def main():
+    for _file in sys.argv[1:]:
+        with open(_file) as f:
+            pp = PreprocessorV2(clean_camflow_json(f))
+        gc = GraphCompressorRef(pp)
+        gc.compress()
+        basename = _file.split("/")[-1].rsplit(".", 1)[0]
+        gc.write_to_file(basename, ext="cpgr")
+
+if __name__ == "__main__":
+    main()
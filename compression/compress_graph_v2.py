@@ -3,6 +3,7 @@
 from graph import Graph
 from preprocess_v2 import clean_camflow_json, is_version_edge, PreprocessorV2
 import sys
+import time
 from util import nbits_for_int, ReaderBitString, WriterBitString
 
 class GraphCompressorV2:
@@ -29,20 +30,28 @@ class GraphCompressorV2:
                                                   delta_back, back_stats,
                                                   collapsed_nodes)
 
-        nbits_index_entry = nbits_for_int(max(index))
-        header_byts.extend(nbits_index_entry.to_bytes(1, byteorder="big"))
-        header_byts.extend(len(index).to_bytes(4, byteorder="big"))
-        wbs = WriterBitString()
-        for (idx, sz) in zip(index, [sizes[x] for x in sorted(sizes.keys())]):
-            wbs.write_int(idx, nbits_index_entry)
-            wbs.write_int(sz, nbits_size_entry)
-        header_byts.extend(wbs.to_bytearray())
+        header_byts.extend(self._compress_index(index, sizes,
+                                                nbits_size_entry))
         
         self.header_byts = header_byts
         self.node_byts = node_byts
 
         self.is_initialized = True
 
+    # The bit length of every group's edge lists, and the size of every group,
+    # preceded by their widths and the number of groups.
+    def _compress_index(self, index, sizes, nbits_size_entry):
+        byts = bytearray()
+        nbits_index_entry = nbits_for_int(max(index))
+        byts.extend(nbits_index_entry.to_bytes(1, byteorder="big"))
+        byts.extend(len(index).to_bytes(4, byteorder="big"))
+        wbs = WriterBitString()
+        for (idx, sz) in zip(index, [sizes[x] for x in sorted(sizes.keys())]):
+            wbs.write_int(idx, nbits_index_entry)
+            wbs.write_int(sz, nbits_size_entry)
+        byts.extend(wbs.to_bytearray())
+        return byts
+
     def _construct_asymmetric_graphs(self, graph, collapsed, uf):
         asym_fwd = Graph()
         asym_back = Graph()
@@ -274,9 +283,12 @@ class CompressedGraph:
 
 
 def main():
-    if len(sys.argv) > 1:
+    # --time prints how long encoding takes, after preprocessing
+    timed = "--time" in sys.argv[1:]
+    files = [arg for arg in sys.argv[1:] if arg != "--time"]
+    if files:
         json_objs = []
-        for _file in sys.argv[1:]:
+        for _file in files:
             with open(_file) as f:
                 json_objs.append((_file, clean_camflow_json(f)))
     else:
@@ -287,7 +299,14 @@ def main():
     for (_file, json_obj) in json_objs:
         pp = PreprocessorV2(json_obj)
         gc = GraphCompressorV2(pp)
+        pp.process()
+        start = time.time()
         gc.compress()
+        if timed:
+            seconds = time.time() - start
+            nbytes = len(gc.header_byts) + len(gc.node_byts)
+            print("%s encode seconds %.4f bytes %d MB/s %.3f" % (_file,
+                seconds, nbytes, nbytes / seconds / 1e6))
         g = gc.decompress()
         #for i in range(len(g)):
         #    print(i, g.get_outgoing_edges(i), g.get_incoming_edges(i))
@@ -1,3 +1,4 @@
+import ast
 import json
 import sys
 import math
@@ -71,7 +72,9 @@ class Encoder():
     strdict_threshold = 300 
     strdict_bits = util.nbits_for_int(strdict_threshold)
 
-    def __init__(self, pp):
+    # dicts, if given, are the dictionaries of another trace (load_dicts),
+    # to encode this one with instead of its own.
+    def __init__(self, pp, dicts=None):
         self.metadata = pp.get_metadata()
         self.iti = pp.get_id2num_map()
         self.id_bits = util.nbits_for_int(pp.get_graph().get_node_count())
@@ -88,6 +91,9 @@ class Encoder():
                 for (i, elt) in enumerate(Encoder.prov_label_strings)}
 
         self.common_strs_dict = self.construct_common_strs_dict()
+        if dicts:
+            (self.keys_dict, self.vals_dict, self.labels_dict, self.typs_dict,
+             self.common_strs_dict) = dicts
 
     def construct_common_strs_dict(self):
         strval_counter = Counter()
@@ -125,23 +131,42 @@ class Encoder():
 
     def write_to_file(self, outfile):
         with open(outfile, 'wb') as f:
-            bitstring.BitArray(bin=self.encoded_json_bits).tofile(f)
+            f.write(self.metadata_bytes())
+        for (name, byts) in self.dict_files().items():
+            with open(PATH+"/"+name, 'wb') as f:
+                f.write(byts)
 
-        with open(PATH+"/prov_data_dicts.txt", 'w') as f:
-            f.write(str(self.keys_dict))
-            f.write(str(self.vals_dict))
-            f.write(str(self.labels_dict))
-            f.write(str(self.typs_dict))
+    def metadata_bytes(self):
+        return bitstring.BitArray(bin=self.encoded_json_bits).tobytes()
 
+    # The contents of the dictionary files, by name
+    def dict_files(self):
+        prov_dicts = (str(self.keys_dict) + str(self.vals_dict) +
+                      str(self.labels_dict) + str(self.typs_dict))
         keys = ''
         values = ''
         for key, val in self.common_strs_dict.items():
             values += val
             keys += str(key)+","
-        with open(PATH+"/common_strs.txt", 'w') as f:
-            f.write(keys)
-        with open(PATH+"/common_strs.bin", 'bw') as f:
-            bitstring.BitArray(bin=values).tofile(f)
+        return {
+            "prov_data_dicts.txt": prov_dicts.encode(),
+            "common_strs.txt": keys.encode(),
+            "common_strs.bin": bitstring.BitArray(bin=values).tobytes(),
+        }
+
+def load_dicts(prov_dicts, common_strs_txt, common_strs_bin):
+    '''
+    The dictionaries in the contents of the files Encoder.dict_files names,
+    in the order Encoder takes them.
+    '''
+    dicts = [ast.literal_eval(d + DICT_END)
+             for d in prov_dicts.decode().split(DICT_END)[:-1]]
+    assert len(dicts) == 4
+    keys = common_strs_txt.decode().split(",")[:-1]
+    bits = ''.join("{0:08b}".format(x) for x in common_strs_bin)
+    n = Encoder.strdict_bits
+    dicts.append({key:bits[i*n:(i+1)*n] for (i, key) in enumerate(keys)})
+    return tuple(dicts)
 
 class CompressionEncoder(Encoder):
 
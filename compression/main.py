@@ -1,13 +1,36 @@
 #!/usr/bin/python3
+from archive import archive_trace
 from compress_graph_v2 import GraphCompressorV2
 from compress_metadata import CompressionEncoder
-from preprocess_v2 import clean_camflow_json, PreprocessorV2
+from preprocess_v2 import clean_camflow_json, PreprocessorV2, RANKERS
 import process_json as pj
 import sys
 import time
 from process_json import graph_to_dot4
 
 def main():
+    # --order=NAME picks how nodes are numbered; see RANKERS.
+    # --archive=NAME also packs the output into a single archive.
+    # --journal keeps the input log in the archive too, for compact.py.
+    order = "bfs"
+    archive = None
+    journal = False
+    for arg in sys.argv[1:]:
+        if arg == "--journal":
+            journal = True
+            sys.argv.remove(arg)
+            continue
+        if arg.startswith("--archive="):
+            archive = arg[len("--archive="):]
+            sys.argv.remove(arg)
+            continue
+        if arg.startswith("--order="):
+            order = arg[len("--order="):]
+            sys.argv.remove(arg)
+            if order not in RANKERS:
+                print("Unknown order", order, "- one of", ", ".join(RANKERS))
+                sys.exit(1)
+
     if len(sys.argv) == 1:
         infile = "/tmp/audit.log"
         outfile = "compressed_metadata.txt"
@@ -21,11 +44,12 @@ def main():
         outfile = sys.argv[2]
         graph_out = "graph"
     else:
-        print("Usage: ./process_json.py [infile] [outfile]")
+        print("Usage: ./main.py [infile] [outfile] [--order=NAME] "
+              "[--archive=NAME [--journal]]")
         sys.exit(1)
 
     with open(infile) as f:
-        pp = PreprocessorV2(clean_camflow_json(f))
+        pp = PreprocessorV2(clean_camflow_json(f), order)
     pp.process()
 
     start = time.process_time()
@@ -38,6 +62,9 @@ def main():
     e.write_to_file(outfile)
     # Continue to use old extension, to make life easier (maybe).
     c.write_to_file(graph_out, ext="cpg")
+    if archive:
+        archive_trace(archive, outfile, graph_out + ".cpg",
+                      infile if journal else None)
     #print(graph_to_dot4(pp))
 
     #print("Compression Time: ", end-start)
@@ -1,7 +1,8 @@
 #!/usr/bin/python3
 
 from abc import ABCMeta, abstractmethod
-from collections import deque
+from collections import Counter, deque
+import heapq
 from graph import LabeledBackEdgeGraph
 import json
 import sys
@@ -42,8 +43,14 @@ def is_version_edge(edge, metadata):
 
 class PreprocessorV2:
 
-    def __init__(self, json_obj):
+    # order names a ranker in RANKERS, which decides the node numbering.
+    # The identifiers are also written to identifiers_file, unless it is
+    # None.
+    def __init__(self, json_obj, order="bfs",
+                 identifiers_file="identifiers.txt"):
         self.json_obj = json_obj
+        self.order = order
+        self.identifiers_file = identifiers_file
         self.is_initialized = False
 
     def process(self):
@@ -141,7 +148,7 @@ class PreprocessorV2:
 
     def _number_identifiers(self, graph, collapsed, uf):
         sizes = {x:uf.get_size(x) for x in uf.leaders()}
-        ranker = TransposeBfsRanker(graph, collapsed, self.metadata, sizes)
+        ranker = RANKERS[self.order](graph, collapsed, self.metadata, sizes)
         id_map = ranker.rank()
 
         node_count = len(id_map)
@@ -153,11 +160,11 @@ class PreprocessorV2:
                 id_map[_id] = ((id_map[head] << node_bits)
                                + id_map[tail] + node_count)
         sorted_ids = sorted(id_map.keys(), key=lambda v: id_map[v])
-        with open("identifiers.txt", 'wb') as f:
-            f.write(node_count.to_bytes(4, byteorder='big')) 
-        with open("identifiers.txt", 'a') as f:
-            for _id in sorted_ids:
-                f.write(_id + ",")
+        self.identifiers_byts = node_count.to_bytes(4, byteorder='big') + \
+            "".join(_id + "," for _id in sorted_ids).encode()
+        if self.identifiers_file:
+            with open(self.identifiers_file, 'wb') as f:
+                f.write(self.identifiers_byts)
         self.id_map = id_map
         self.id_map_rev = {v:k for (k, v) in id_map.items()} 
 
@@ -203,6 +210,9 @@ class BfsRanker:
                 q.append(v)
             while q:
                 v = q.popleft()
+                # A group can be queued more than once before it is ranked
+                if v in self.rankings:
+                    continue
                 rank = self._rank_collapsed(v, rank)
                 dests = [e.dest for e in get_edges(v)]
                 for d in dests:
@@ -210,6 +220,19 @@ class BfsRanker:
                         q.append(d)
         return self.rankings
 
+    # Numbers the groups in the given order.
+    def _rank_groups(self, order):
+        rank = 0
+        self.rankings = {}
+        for v in order:
+            rank = self._rank_collapsed(v, rank)
+        return self.rankings
+
+    def _undirected_neighbors(self, v):
+        edges = (self.collapsed.get_outgoing_edges(v) +
+                 self.collapsed.get_incoming_edges(v))
+        return {e.dest for e in edges if e.dest != v}
+
     def _rank_collapsed(self, v, rank):
         cur = [v]
         while cur:
@@ -320,6 +343,125 @@ class ForwardDfsRanker(DfsRanker):
     def _get_visiting_order(self):
         return sorted(self.collapsed.get_vertices(), reverse=True)
 
+class RcmRanker(BfsRanker):
+    '''
+    Reverse Cuthill-McKee over the collapsed graph, ignoring direction:
+    breadth first from a least connected group, visiting neighbors least
+    connected first, then reversed.
+    '''
+
+    def rank(self):
+        nbrs = {v:self._undirected_neighbors(v)
+                for v in self.collapsed.get_vertices()}
+        by_degree = lambda v: (len(nbrs[v]), v)
+        order = []
+        visited = set()
+        for s in sorted(nbrs, key=by_degree):
+            if s in visited:
+                continue
+            visited.add(s)
+            q = deque([s])
+            while q:
+                v = q.popleft()
+                order.append(v)
+                for u in sorted(nbrs[v] - visited, key=by_degree):
+                    visited.add(u)
+                    q.append(u)
+        order.reverse()
+        return self._rank_groups(order)
+
+class GorderRanker(BfsRanker):
+    '''
+    Greedy Gorder: the next group is the one most related to the last
+    WINDOW groups placed, counting edges to them and neighbors shared with
+    them. Groups with more than HUB_DEGREE edges one way do not relate
+    their neighbors to each other, which would take quadratic time.
+    '''
+
+    WINDOW = 5
+    HUB_DEGREE = 64
+
+    def rank(self):
+        vs = sorted(self.collapsed.get_vertices())
+        out = {v:[e.dest for e in self.collapsed.get_outgoing_edges(v)
+                  if e.dest != v] for v in vs}
+        inc = {v:[e.dest for e in self.collapsed.get_incoming_edges(v)
+                  if e.dest != v] for v in vs}
+
+        def related(v):
+            for u in out[v] + inc[v]:
+                yield u
+            for x in inc[v]:
+                if len(out[x]) <= self.HUB_DEGREE:
+                    yield from out[x]
+            for x in out[v]:
+                if len(inc[x]) <= self.HUB_DEGREE:
+                    yield from inc[x]
+
+        score = Counter()
+        heap = []
+        placed = set()
+        def bump(v, d):
+            for u in related(v):
+                if u not in placed:
+                    score[u] += d
+                    heapq.heappush(heap, (-score[u], u))
+
+        order = []
+        remaining = iter(vs)
+        while len(order) < len(vs):
+            v = None
+            while heap:
+                (s, u) = heapq.heappop(heap)
+                if u not in placed and -s == score[u]:
+                    v = u
+                    break
+            if v is None:
+                v = next(u for u in remaining if u not in placed)
+            placed.add(v)
+            order.append(v)
+            bump(v, 1)
+            if len(order) > self.WINDOW:
+                bump(order[-self.WINDOW - 1], -1)
+        return self._rank_groups(order)
+
+class TimeTaskRanker(BfsRanker):
+    '''
+    Tasks in the order they started, each followed by the other groups it
+    touches that are not yet placed, oldest first, so that what a task
+    reads and writes is numbered near it. Groups no task touches go last.
+    '''
+
+    def rank(self):
+        vs = sorted(self.collapsed.get_vertices(), key=self._date)
+        order = []
+        placed = set()
+        for v in vs:
+            if not self._is_task(v) or v in placed:
+                continue
+            placed.add(v)
+            order.append(v)
+            for u in sorted(self._undirected_neighbors(v), key=self._date):
+                if u not in placed and not self._is_task(u):
+                    placed.add(u)
+                    order.append(u)
+        order.extend(v for v in vs if v not in placed)
+        return self._rank_groups(order)
+
+    def _date(self, v):
+        return (self.metadata[v].data.get("cf:date", ""), v)
+
+    def _is_task(self, v):
+        return self.metadata[v].data.get("cf:type") == "task"
+
+# Node orderings PreprocessorV2 can number by
+RANKERS = {
+    "bfs": TransposeBfsRanker,
+    "rcm": RcmRanker,
+    "gorder": GorderRanker,
+    "time-task": TimeTaskRanker,
+}
+
 def main():
     with open("example.json") as f:
         json_obj = " ".join([line.strip() for line in f])
@@ -50,6 +50,15 @@ class ReaderBitString:
             width -= 1
         return i
 
+    def read_gamma(self):
+        zeros = 0
+        while not self.read_bit():
+            zeros += 1
+        i = 1
+        for _ in range(zeros):
+            i = (i << 1) | self.read_bit()
+        return i
+
     def read_int_at_pos(self, pos, width):
         self.index = pos // 8
         self.pos = 7 - (pos % 8)
@@ -94,6 +103,15 @@ class WriterBitString:
             k -= 1
         return written 
 
+    # Writes a positive integer in Elias gamma code: one zero for each bit
+    # after the first, then the integer itself.
+    def write_gamma(self, i):
+        assert i > 0
+        width = nbits_for_int(i)
+        for _ in range(width - 1):
+            self.write_bit(0)
+        return width - 1 + self.write_int(i, width)
+
     def to_bytearray(self):
         return self.byts
 
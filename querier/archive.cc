@@ -0,0 +1,217 @@
+#include "archive.hh"
+#include "crc32c.hh"
+
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char ARCHIVE_MAGIC[8] = {'P', 'R', 'O', 'V', 'A', 'R', 'C', 'H'};
+static const uint32_t ARCHIVE_VERSION = 2;
+static const uint32_t KNOWN_FEATURES = FEATURE_CRC32C;
+// Version 2 headers end with a CRC-32C of the bytes before it
+static const size_t HEADER_SIZE = 32;
+static const size_t ENTRY_SIZE = 32;
+// The only version of any section type so far
+static const uint32_t SECTION_VERSION = 1;
+
+static uint64_t read_be(const char* p, size_t nbytes) {
+    uint64_t val = 0;
+    for (size_t i = 0; i < nbytes; ++i) {
+        val = (val << 8) | (unsigned char) p[i];
+    }
+    return val;
+}
+
+struct Crc32_Table {
+    uint32_t t[256];
+
+    Crc32_Table() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+    }
+};
+
+// CRC-32 as in zlib, which version 1 archives use. The table is built once,
+// safely, by whichever thread first checks a section.
+static uint32_t crc32(const char* p, size_t length) {
+    static const Crc32_Table table;
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table.t[(crc ^ (unsigned char) p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+Archive::Archive(const string& path)
+    : path_(path), base_(nullptr), size_(0), mapped_(false), version_(0),
+      features_(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fail(strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int err = errno;
+        close(fd);
+        fail(strerror(err));
+    }
+    size_ = st.st_size;
+    if (size_ < ALIGN) {
+        close(fd);
+        fail("too short");
+    }
+    void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    close(fd);
+    if (p == MAP_FAILED) {
+        fail(strerror(err));
+    }
+    base_ = static_cast<const char*>(p);
+    mapped_ = true;
+    // the destructor does not run for a constructor that throws
+    try {
+        read_directory();
+    } catch (...) {
+        munmap(p, size_);
+        throw;
+    }
+}
+
+Archive::Archive(const string& name, const BitSet& bytes)
+    : path_(name), base_(reinterpret_cast<const char*>(bytes.data())),
+      size_(bytes.size()), mapped_(false), version_(0), features_(0) {
+    if (size_ < ALIGN) {
+        fail("too short");
+    }
+    read_directory();
+}
+
+void Archive::read_directory() {
+    if (memcmp(base_, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0) {
+        fail("not an archive");
+    }
+    version_ = read_be(base_ + 8, 4);
+    if (version_ < 1 || version_ > ARCHIVE_VERSION) {
+        fail("unsupported version " + to_string(version_));
+    }
+    size_t count = read_be(base_ + 12, 4);
+    size_t dir = read_be(base_ + 16, 8);
+    if (version_ > 1) {
+        if (crc32c(base_, HEADER_SIZE) != read_be(base_ + HEADER_SIZE, 4)) {
+            fail("bad header checksum");
+        }
+        features_ = read_be(base_ + 24, 4);
+        if (features_ & ~KNOWN_FEATURES) {
+            fail("unsupported features " + to_string(features_));
+        }
+    }
+    if (dir > size_ || count > (size_ - dir) / ENTRY_SIZE) {
+        fail("directory out of bounds");
+    }
+    if (version_ > 1 &&
+            crc32c(base_ + dir, count * ENTRY_SIZE) != read_be(base_ + 28, 4)) {
+        fail("bad directory checksum");
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const char* e = base_ + dir + i * ENTRY_SIZE;
+        Section s;
+        s.type = read_be(e, 4);
+        s.version = read_be(e + 4, 4);
+        s.offset = read_be(e + 8, 8);
+        s.length = read_be(e + 16, 8);
+        s.checksum = read_be(e + 24, 4);
+        // readers may touch BitSet::PADDING bytes past the end
+        if (s.offset % ALIGN || s.offset > size_ ||
+                s.length + BitSet::PADDING > size_ - s.offset) {
+            fail("section " + to_string(s.type) + " out of bounds");
+        }
+        if (s.version != SECTION_VERSION) {
+            fail("unsupported version " + to_string(s.version) +
+                    " of section " + to_string(s.type));
+        }
+        sections_.push_back(s);
+    }
+}
+
+Archive::~Archive() {
+    if (mapped_) {
+        munmap(const_cast<char*>(base_), size_);
+    }
+}
+
+void Archive::fail(const string& why) const {
+    throw runtime_error(path_ + ": " + why);
+}
+
+bool Archive::has_section(Section_Type type) const {
+    return count(type) > 0;
+}
+
+size_t Archive::count(Section_Type type) const {
+    size_t n = 0;
+    for (auto& s : sections_) {
+        n += s.type == type;
+    }
+    return n;
+}
+
+const Archive::Section& Archive::find(Section_Type type, size_t i) const {
+    for (auto& s : sections_) {
+        if (s.type == type && i-- == 0) {
+            return s;
+        }
+    }
+    fail("no section " + to_string(type));
+    return sections_.front();
+}
+
+bool Archive::check(const Section& s) const {
+    const char* p = base_ + s.offset;
+    return (features_ & FEATURE_CRC32C ? crc32c(p, s.length) :
+            crc32(p, s.length)) == s.checksum;
+}
+
+bool Archive::check_section(Section_Type type, size_t i) const {
+    return check(find(type, i));
+}
+
+Validate_Stats Archive::validate() const {
+    Validate_Stats stats;
+    stats.checksum = features_ & FEATURE_CRC32C ? crc32c_kernel_name() :
+        "crc32";
+    auto start = std::chrono::steady_clock::now();
+    for (auto& s : sections_) {
+        if (!check(s)) {
+            fail("bad checksum in section " + to_string(s.type));
+        }
+        ++stats.sections;
+        stats.bytes += s.length;
+    }
+    stats.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+string Archive::read_section(Section_Type type, size_t i) const {
+    const Section& s = find(type, i);
+    if (!check_section(type, i)) {
+        fail("bad checksum in section " + to_string(type));
+    }
+    return string(base_ + s.offset, s.length);
+}
+
+BitSet Archive::map_section(Section_Type type, size_t i, bool check) const {
+    const Section& s = find(type, i);
+    if (check && !check_section(type, i)) {
+        fail("bad checksum in section " + to_string(type));
+    }
+    return BitSet(base_ + s.offset, s.length);
+}
@@ -0,0 +1,98 @@
+#ifndef ARCHIVE_HH
+#define ARCHIVE_HH
+
+#include "helpers.hh"
+
+// Section types, as numbered by compression/archive.py
+enum Section_Type : uint32_t {
+    SECTION_METADATA = 1,
+    SECTION_IDENTIFIERS = 2,
+    SECTION_COMMON_STRS_TXT = 3,
+    SECTION_COMMON_STRS_BIN = 4,
+    SECTION_PROV_DICTS = 5,
+    SECTION_GRAPH = 6,
+    SECTION_JOURNAL = 7,
+    SECTION_SEGMENT = 8,
+    SECTION_NODE_MAP = 9,
+};
+
+// Archive feature flags, as in compression/archive.py
+enum Archive_Feature : uint32_t {
+    // Section checksums are CRC-32C rather than zlib's CRC-32
+    FEATURE_CRC32C = 1,
+};
+
+struct Validate_Stats {
+    size_t sections;
+    size_t bytes;
+    double seconds;
+    // the checksum used, and for CRC-32C the kernel
+    const char* checksum;
+
+    Validate_Stats() : sections(0), bytes(0), seconds(0), checksum("") {}
+    double bytes_per_sec() const { return seconds ? bytes / seconds : 0; }
+};
+
+/*
+ * A single-file archive of one compressed trace (compression/archive.py).
+ * The file is mapped once, when the archive is opened; a section's pages
+ * are only read when it is, so a large graph section is paged in as it is
+ * traversed. Sections are checked against their checksum when read or
+ * mapped, unless asked not to; validate() checks them all up front, so
+ * that a damaged archive fails at startup rather than mid-query. A missing
+ * file, bad header, missing section or bad checksum throws a runtime_error
+ * naming the file, as other malformed inputs do.
+ *
+ * An archive may hold several sections of one type (compression/append.py
+ * adds segments); they are told apart by their order in the archive.
+ */
+class Archive {
+    public:
+        Archive(const string& path);
+        // An archive held in a section of another, which must outlive it
+        Archive(const string& name, const BitSet& bytes);
+        ~Archive();
+        Archive(const Archive&) = delete;
+        Archive& operator=(const Archive&) = delete;
+
+        bool has_section(Section_Type) const;
+        size_t count(Section_Type) const;
+        // A copy of the bytes of the i'th section of a type
+        string read_section(Section_Type, size_t i = 0) const;
+        // A section's bytes in place, valid while the archive is open.
+        // Checking it reads the whole section in.
+        BitSet map_section(Section_Type, size_t i = 0,
+                bool check = true) const;
+        bool check_section(Section_Type, size_t i = 0) const;
+        // Checks every section, failing at the first bad one
+        Validate_Stats validate() const;
+
+        uint32_t version() const { return version_; }
+        uint32_t features() const { return features_; }
+
+        static const size_t ALIGN = 64;
+
+    private:
+        struct Section {
+            uint32_t type;
+            uint32_t version;
+            uint64_t offset;
+            uint64_t length;
+            uint32_t checksum;
+        };
+
+        string path_;
+        const char* base_;
+        size_t size_;
+        bool mapped_;
+        uint32_t version_;
+        uint32_t features_;
+        vector<Section> sections_;
+
+        void read_directory();
+        const Section& find(Section_Type, size_t i) const;
+        bool check(const Section&) const;
+        void fail(const string& why) const;
+};
+
+#endif
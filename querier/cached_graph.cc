@@ -0,0 +1,172 @@
+#include "cached_graph.hh"
+
+using namespace std;
+
+CachedGraph::CachedGraph(const Graph* graph, size_t budget_bytes)
+    : graph_(graph), shard_budget_(budget_bytes / NUM_SHARDS) {
+    for (auto& shard : shards_) {
+        shard.hand = 0;
+        shard.bytes = 0;
+        shard.dead = 0;
+    }
+}
+
+vector<Node_Id> CachedGraph::get_outgoing_edges(Node_Id node) const {
+    return get_edges(node, true);
+}
+
+vector<Node_Id> CachedGraph::get_incoming_edges(Node_Id node) const {
+    return get_edges(node, false);
+}
+
+map<string, vector<Node_Id>> CachedGraph::friends_of(Node_Id pathname,
+        Node_Id task, const Metadata* metadata) const {
+    return graph_->friends_of(pathname, task, metadata);
+}
+
+size_t CachedGraph::get_node_count() const {
+    return graph_->get_node_count();
+}
+
+Cache_Stats CachedGraph::stats() const {
+    Cache_Stats total;
+    for (auto& shard : shards_) {
+        lock_guard<mutex> lock(shard.mutex);
+        total.hits += shard.stats.hits;
+        total.misses += shard.stats.misses;
+        total.evictions += shard.stats.evictions;
+        total.entries += shard.index.size();
+        total.bytes += shard.arena.capacity() * sizeof(Node_Id) +
+            shard.index.size() * ENTRY_BYTES;
+    }
+    return total;
+}
+
+vector<Node_Id> CachedGraph::get_edges(Node_Id node, bool is_fwd) const {
+    uint64_t key = ((uint64_t)node << 1) | is_fwd;
+    Shard& shard = shards_[(key * 0x9E3779B97F4A7C15ULL) >> 60];
+    {
+        lock_guard<mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            Entry& entry = shard.entries[it->second];
+            entry.referenced = true;
+            ++shard.stats.hits;
+            auto first = shard.arena.begin() + entry.offset;
+            return vector<Node_Id>(first, first + entry.length);
+        }
+        ++shard.stats.misses;
+    }
+
+    // Decode without holding the lock; if another thread got here first,
+    // insert keeps its copy.
+    vector<Node_Id> edges = is_fwd ? graph_->get_outgoing_edges(node) :
+        graph_->get_incoming_edges(node);
+    lock_guard<mutex> lock(shard.mutex);
+    insert(shard, key, edges);
+    return edges;
+}
+
+void CachedGraph::insert(Shard& shard, uint64_t key,
+        const vector<Node_Id>& edges) const {
+    size_t need = edges.size() * sizeof(Node_Id) + ENTRY_BYTES;
+    if (need > shard_budget_ || shard.index.count(key)) {
+        return;
+    }
+    while (shard.bytes + need > shard_budget_) {
+        evict_one(shard);
+    }
+    make_room(shard, edges.size());
+
+    size_t slot;
+    if (shard.free_entries.empty()) {
+        slot = shard.entries.size();
+        shard.entries.push_back(Entry());
+    } else {
+        slot = shard.free_entries.back();
+        shard.free_entries.pop_back();
+    }
+    shard.entries[slot] = {key, shard.arena.size(), edges.size(), false, true};
+    shard.arena.insert(shard.arena.end(), edges.begin(), edges.end());
+    shard.index[key] = slot;
+    shard.bytes += need;
+}
+
+// Advances the clock hand to the first entry not used since the hand last
+// passed it, and evicts that entry.
+void CachedGraph::evict_one(Shard& shard) const {
+    assert(!shard.index.empty());
+    while (true) {
+        if (shard.hand >= shard.entries.size()) {
+            shard.hand = 0;
+        }
+        Entry& entry = shard.entries[shard.hand++];
+        if (!entry.live) {
+            continue;
+        }
+        if (entry.referenced) {
+            entry.referenced = false;
+            continue;
+        }
+        entry.live = false;
+        shard.index.erase(entry.key);
+        shard.free_entries.push_back(shard.hand - 1);
+        shard.bytes -= entry.length * sizeof(Node_Id) + ENTRY_BYTES;
+        shard.dead += entry.length;
+        ++shard.stats.evictions;
+        return;
+    }
+}
+
+// Makes space at the end of the arena for a list of length more, with
+// the arena's capacity and the entries' bookkeeping within the shard's
+// budget. The arena grows by doubling up to that limit; once there, lists
+// are evicted down to three quarters of the budget before compacting, so
+// that each compaction frees room for a quarter of the budget.
+void CachedGraph::make_room(Shard& shard, size_t length) const {
+    auto limit = [&]() {
+        return (shard_budget_ - (shard.index.size() + 1) * ENTRY_BYTES) /
+            sizeof(Node_Id);
+    };
+    if (shard.arena.size() + length > shard.arena.capacity() &&
+            shard.arena.size() + length > limit()) {
+        size_t need = length * sizeof(Node_Id) + ENTRY_BYTES;
+        while (!shard.index.empty() &&
+                shard.bytes + need > shard_budget_ / 4 * 3) {
+            evict_one(shard);
+        }
+        compact(shard);
+    }
+    if (shard.arena.size() + length > shard.arena.capacity()) {
+        shard.arena.reserve(min(max(2 * shard.arena.capacity(),
+                        shard.arena.size() + length), limit()));
+    }
+    // more, shorter lists leave less of the budget for the arena
+    while (!shard.index.empty() && shard.arena.capacity() > limit()) {
+        evict_one(shard);
+    }
+}
+
+// Moves live lists to the front of the arena, in place, dropping evicted
+// ones.
+void CachedGraph::compact(Shard& shard) const {
+    vector<size_t> live;
+    for (size_t slot = 0; slot < shard.entries.size(); ++slot) {
+        if (shard.entries[slot].live) {
+            live.push_back(slot);
+        }
+    }
+    sort(live.begin(), live.end(), [&](size_t a, size_t b) {
+        return shard.entries[a].offset < shard.entries[b].offset;
+    });
+    size_t end = 0;
+    for (size_t slot : live) {
+        Entry& entry = shard.entries[slot];
+        auto first = shard.arena.begin() + entry.offset;
+        copy(first, first + entry.length, shard.arena.begin() + end);
+        entry.offset = end;
+        end += entry.length;
+    }
+    shard.arena.resize(end);
+    shard.dead = 0;
+}
@@ -0,0 +1,76 @@
+#ifndef CACHED_GRAPH_HH
+#define CACHED_GRAPH_HH
+
+#include <mutex>
+#include <unordered_map>
+
+#include "graph.hh"
+
+struct Cache_Stats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t entries;
+    // held against the budget, counting evicted lists not yet compacted
+    // away and the arenas' spare capacity
+    size_t bytes;
+
+    Cache_Stats() : hits(0), misses(0), evictions(0), entries(0), bytes(0) {}
+};
+
+/*
+ * Keeps decoded neighbor lists of recently used nodes in front of another
+ * graph. Lists live back to back in per-shard arenas and are evicted by
+ * CLOCK once the shard is over its share of the byte budget. An arena's
+ * whole capacity counts against the budget, evicted lists included, so it
+ * is compacted in place rather than grown past its share. Lookups are
+ * safe to make from many threads; each shard has its own lock.
+ */
+class CachedGraph : public Graph {
+    public:
+        CachedGraph(const Graph* graph, size_t budget_bytes);
+        std::vector<Node_Id> get_outgoing_edges(Node_Id) const override;
+        std::vector<Node_Id> get_incoming_edges(Node_Id) const override;
+        std::map<std::string, std::vector<Node_Id>> friends_of(Node_Id, Node_Id,
+                const Metadata*) const override;
+        size_t get_node_count() const override;
+        Cache_Stats stats() const;
+
+    private:
+        static const size_t NUM_SHARDS = 16;
+        // bookkeeping charged to each entry besides its list
+        static const size_t ENTRY_BYTES = 64;
+
+        struct Entry {
+            uint64_t key;
+            size_t offset;
+            size_t length;
+            bool referenced;
+            bool live;
+        };
+        struct Shard {
+            std::mutex mutex;
+            std::vector<Node_Id> arena;
+            std::vector<Entry> entries;
+            std::vector<size_t> free_entries;
+            std::unordered_map<uint64_t, size_t> index;
+            size_t hand;
+            // live lists and their bookkeeping
+            size_t bytes;
+            // elements of the arena held by evicted lists
+            size_t dead;
+            Cache_Stats stats;
+        };
+
+        const Graph* graph_;
+        size_t shard_budget_;
+        mutable Shard shards_[NUM_SHARDS];
+
+        std::vector<Node_Id> get_edges(Node_Id, bool) const;
+        void insert(Shard&, uint64_t, const std::vector<Node_Id>&) const;
+        void evict_one(Shard&) const;
+        void make_room(Shard&, size_t length) const;
+        void compact(Shard&) const;
+};
+
+#endif
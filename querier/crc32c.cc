@@ -0,0 +1,148 @@
+#include <cstring>
+
+#include "crc32c.hh"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// The Castagnoli polynomial, bit-reversed
+static const uint32_t POLY = 0x82F63B78;
+// Bytes each stream of the SSE4.2 kernel covers at a time
+static const size_t BLOCK = 4096;
+
+typedef uint32_t (*Crc_Kernel)(const char*, size_t, uint32_t);
+
+struct Byte_Table {
+    uint32_t t[256];
+
+    Byte_Table() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? POLY ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+    }
+};
+
+static const Byte_Table& byte_table() {
+    static const Byte_Table table;
+    return table;
+}
+
+// Runs the CRC register over length bytes, without the inversions at
+// either end
+static uint32_t update(uint32_t r, const unsigned char* p, size_t length) {
+    const uint32_t* t = byte_table().t;
+    for (size_t i = 0; i < length; ++i) {
+        r = t[(r ^ p[i]) & 0xFF] ^ (r >> 8);
+    }
+    return r;
+}
+
+uint32_t crc32c_scalar(const char* data, size_t length, uint32_t crc) {
+    return ~update(~crc,
+            reinterpret_cast<const unsigned char*>(data), length);
+}
+
+#if defined(__x86_64__)
+/*
+ * What running the register over BLOCK zero bytes does to it, which is
+ * linear: the register after a stream that starts from r is that of the
+ * same stream started from 0, xor shift(r). That lets three streams run
+ * independently from 0 and be joined after.
+ */
+struct Block_Shift {
+    // indexed by byte of the register
+    uint32_t t[4][256];
+
+    Block_Shift() {
+        static const unsigned char zeros[BLOCK] = {0};
+        uint32_t bit[32];
+        for (int i = 0; i < 32; ++i) {
+            bit[i] = update(1u << i, zeros, BLOCK);
+        }
+        for (int k = 0; k < 4; ++k) {
+            for (uint32_t b = 0; b < 256; ++b) {
+                uint32_t c = 0;
+                for (int j = 0; j < 8; ++j) {
+                    if (b & (1u << j)) {
+                        c ^= bit[8 * k + j];
+                    }
+                }
+                t[k][b] = c;
+            }
+        }
+    }
+    uint32_t operator()(uint32_t r) const {
+        return t[0][r & 0xFF] ^ t[1][(r >> 8) & 0xFF] ^
+            t[2][(r >> 16) & 0xFF] ^ t[3][r >> 24];
+    }
+};
+
+static const Block_Shift& block_shift() {
+    static const Block_Shift shift;
+    return shift;
+}
+
+static inline uint64_t load64(const char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+__attribute__((target("sse4.2")))
+uint32_t crc32c_sse42(const char* data, size_t length, uint32_t crc) {
+    uint64_t r = ~crc;
+    if (length >= 3 * BLOCK) {
+        const Block_Shift& shift = block_shift();
+        for (; length >= 3 * BLOCK; data += 3 * BLOCK, length -= 3 * BLOCK) {
+            uint64_t r1 = 0, r2 = 0;
+            for (size_t i = 0; i < BLOCK; i += 8) {
+                r = _mm_crc32_u64(r, load64(data + i));
+                r1 = _mm_crc32_u64(r1, load64(data + BLOCK + i));
+                r2 = _mm_crc32_u64(r2, load64(data + 2 * BLOCK + i));
+            }
+            r = shift(r) ^ r1;
+            r = shift(r) ^ r2;
+        }
+    }
+    for (; length >= 8; data += 8, length -= 8) {
+        r = _mm_crc32_u64(r, load64(data));
+    }
+    for (; length; ++data, --length) {
+        r = _mm_crc32_u8(r, *data);
+    }
+    return ~r;
+}
+#endif
+
+struct Kernel_Choice {
+    Crc_Kernel kernel;
+    const char* name;
+};
+
+static Kernel_Choice pick_kernel() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        return {crc32c_sse42, "sse4.2"};
+    }
+#endif
+    return {crc32c_scalar, "scalar"};
+}
+
+static const Kernel_Choice& kernel_choice() {
+    static const Kernel_Choice choice = pick_kernel();
+    return choice;
+}
+
+uint32_t crc32c(const char* data, size_t length, uint32_t crc) {
+    return kernel_choice().kernel(data, length, crc);
+}
+
+const char* crc32c_kernel_name() {
+    return kernel_choice().name;
+}
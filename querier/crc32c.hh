@@ -0,0 +1,25 @@
+#ifndef CRC32C_HH
+#define CRC32C_HH
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * CRC-32C (Castagnoli) of length bytes at data, continuing from the CRC of
+ * the bytes before them (0 for none), as compression/archive.py computes
+ * it. The kernel (SSE4.2 or scalar) is picked once from what the CPU
+ * supports; the SSE4.2 one runs three streams at once, which keeps up with
+ * memory on large inputs.
+ */
+uint32_t crc32c(const char* data, size_t length, uint32_t crc = 0);
+
+// Name of the kernel crc32c uses
+const char* crc32c_kernel_name();
+
+// The individual kernels, for testing and benchmarks
+uint32_t crc32c_scalar(const char* data, size_t length, uint32_t crc = 0);
+#if defined(__x86_64__)
+uint32_t crc32c_sse42(const char* data, size_t length, uint32_t crc = 0);
+#endif
+
+#endif
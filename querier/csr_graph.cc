@@ -0,0 +1,32 @@
+#include "csr_graph.hh"
+
+using namespace std;
+
+CsrGraph::CsrGraph(const Graph* source, Csr& fwd, Csr& back, Csr_Stats stats)
+    : source_(source), stats_(stats) {
+    fwd_.offsets.swap(fwd.offsets);
+    fwd_.targets.swap(fwd.targets);
+    back_.offsets.swap(back.offsets);
+    back_.targets.swap(back.targets);
+}
+
+vector<Node_Id> CsrGraph::get_outgoing_edges(Node_Id node) const {
+    assert(node < get_node_count());
+    return vector<Node_Id>(fwd_.targets.begin() + fwd_.offsets[node],
+            fwd_.targets.begin() + fwd_.offsets[node + 1]);
+}
+
+vector<Node_Id> CsrGraph::get_incoming_edges(Node_Id node) const {
+    assert(node < get_node_count());
+    return vector<Node_Id>(back_.targets.begin() + back_.offsets[node],
+            back_.targets.begin() + back_.offsets[node + 1]);
+}
+
+map<string, vector<Node_Id>> CsrGraph::friends_of(Node_Id pathname,
+        Node_Id task, const Metadata* metadata) const {
+    return source_->friends_of(pathname, task, metadata);
+}
+
+size_t CsrGraph::get_node_count() const {
+    return fwd_.offsets.size() - 1;
+}
@@ -0,0 +1,46 @@
+#ifndef CSR_GRAPH_HH
+#define CSR_GRAPH_HH
+
+#include "graph.hh"
+
+/*
+ * Neighbor lists of every node stored back to back: the neighbors of node
+ * n are targets[offsets[n]] up to targets[offsets[n + 1]].
+ */
+struct Csr {
+    std::vector<size_t> offsets;
+    std::vector<Node_Id> targets;
+};
+
+struct Csr_Stats {
+    size_t edges;
+    size_t threads;
+    double seconds;
+
+    Csr_Stats() : edges(0), threads(0), seconds(0) {}
+    double edges_per_sec() const { return seconds > 0 ? edges / seconds : 0; }
+};
+
+/*
+ * A fully decoded graph, for jobs that touch most of it. Queries that need
+ * the compressed layout (friends_of) are passed on to the graph it was
+ * decoded from, which must outlive it.
+ */
+class CsrGraph : public Graph {
+    public:
+        CsrGraph(const Graph* source, Csr& fwd, Csr& back, Csr_Stats stats);
+        std::vector<Node_Id> get_outgoing_edges(Node_Id) const override;
+        std::vector<Node_Id> get_incoming_edges(Node_Id) const override;
+        std::map<std::string, std::vector<Node_Id>> friends_of(Node_Id, Node_Id,
+                const Metadata*) const override;
+        size_t get_node_count() const override;
+        const Csr_Stats& decode_stats() const { return stats_; }
+
+    private:
+        const Graph* source_;
+        Csr fwd_;
+        Csr back_;
+        Csr_Stats stats_;
+};
+
+#endif
@@ -1,22 +1,24 @@
+#include <algorithm>
 #include <map>
 #include <queue>
 #include <set>
 #include <iostream>
 
 #include "graph.hh"
+#include "metadata.hh"
 
 using namespace std;
 
-vector<Node_Id> Graph::get_all_descendants(Node_Id node) {
+vector<Node_Id> Graph::get_all_descendants(Node_Id node) const {
     return bfs_helper(node, &Graph::get_outgoing_edges);
 }
 
-vector<Node_Id> Graph::get_all_ancestors(Node_Id node) {
+vector<Node_Id> Graph::get_all_ancestors(Node_Id node) const {
     return bfs_helper(node, &Graph::get_incoming_edges);
 }
 
 vector<Node_Id> Graph::bfs_helper(Node_Id node,
-        vector<Node_Id> (Graph::*get_neighbors)(Node_Id)) {
+        vector<Node_Id> (Graph::*get_neighbors)(Node_Id) const) const {
     vector<Node_Id> neighbors = (this->*get_neighbors)(node);
     queue<Node_Id> q;
     set<Node_Id> visited;
@@ -37,7 +39,227 @@ vector<Node_Id> Graph::bfs_helper(Node_Id node,
     return vector<Node_Id>(visited.begin(), visited.end());
 }
 
-vector<vector<Node_Id>> Graph::get_all_paths(Node_Id source, Node_Id sink) {
+vector<Node_Id> Graph::get_all_descendants(Node_Id node,
+        const Traversal_Filter& filter, const Metadata* metadata) const {
+    vector<Node_Id> nodes;
+    traverse(node, true, filter, metadata, [&](Node_Id n) {
+        nodes.push_back(n);
+        return true;
+    });
+    sort(nodes.begin(), nodes.end());
+    return nodes;
+}
+
+vector<Node_Id> Graph::get_all_ancestors(Node_Id node,
+        const Traversal_Filter& filter, const Metadata* metadata) const {
+    vector<Node_Id> nodes;
+    traverse(node, false, filter, metadata, [&](Node_Id n) {
+        nodes.push_back(n);
+        return true;
+    });
+    sort(nodes.begin(), nodes.end());
+    return nodes;
+}
+
+void Graph::traverse(Node_Id node, bool is_fwd, const Traversal_Filter& filter,
+        const Metadata* metadata, function<bool(Node_Id)> visit) const {
+    vector<Node_Id> (Graph::*get_neighbors)(Node_Id) const = is_fwd ?
+        &Graph::get_outgoing_edges : &Graph::get_incoming_edges;
+    bool check_edges = filter.edge_types.any();
+    bool check_nodes = filter.node_types.any() || filter.via_types.any();
+    bool check_times = filter.has_window();
+    assert(!(check_edges || check_nodes || check_times) || metadata);
+
+    set<Node_Id> visited;
+    vector<time_t> times;
+    vector<Node_Id> frontier = {node};
+    vector<Node_Id> next;
+    for (size_t depth = 1; !frontier.empty() && depth <= filter.max_depth;
+            ++depth) {
+        for (Node_Id nid : frontier) {
+            vector<Node_Id> neighbors = (this->*get_neighbors)(nid);
+            if (check_times) {
+                metadata->get_node_times(neighbors, times);
+            }
+            for (size_t i = 0; i < neighbors.size(); ++i) {
+                Node_Id nid2 = neighbors[i];
+                if (visited.count(nid2)) {
+                    continue;
+                }
+                // An edge that fails the filter does not mark its endpoint
+                // as visited, since the node may still be reachable another
+                // way.
+                Node_Id src = is_fwd ? nid : nid2;
+                Node_Id dest = is_fwd ? nid2 : nid;
+                if (check_edges && !Traversal_Filter::matches(
+                            filter.edge_types,
+                            metadata->get_edge_type(src, dest))) {
+                    continue;
+                }
+                if (check_times && !filter.in_window(
+                            metadata->get_edge_time(src, dest))) {
+                    continue;
+                }
+                visited.insert(nid2);
+                if (check_times && !filter.in_window(times[i])) {
+                    continue;
+                }
+                Type_Code typ = check_nodes ?
+                    metadata->get_node_type(nid2) : Metadata::NO_TYPE;
+                if (Traversal_Filter::matches(filter.node_types, typ)
+                        && !visit(nid2)) {
+                    return;
+                }
+                if (Traversal_Filter::matches(filter.via_types, typ)) {
+                    next.push_back(nid2);
+                }
+            }
+        }
+        frontier.swap(next);
+        next.clear();
+    }
+}
+
+void Graph::get_neighborhood(Node_Id node, size_t k, vector<Node_Id>& nodes,
+        vector<pair<Node_Id, Node_Id>>& edges) const {
+    set<Node_Id> visited = {node};
+    vector<Node_Id> frontier = {node};
+    vector<Node_Id> next;
+    nodes = {node};
+    edges.clear();
+    for (size_t depth = 1; !frontier.empty() && depth <= k; ++depth) {
+        for (Node_Id nid : frontier) {
+            for (Node_Id nid2 : get_outgoing_edges(nid)) {
+                edges.push_back(make_pair(nid, nid2));
+                if (visited.insert(nid2).second) {
+                    next.push_back(nid2);
+                }
+            }
+            for (Node_Id nid2 : get_incoming_edges(nid)) {
+                edges.push_back(make_pair(nid2, nid));
+                if (visited.insert(nid2).second) {
+                    next.push_back(nid2);
+                }
+            }
+        }
+        nodes.insert(nodes.end(), next.begin(), next.end());
+        frontier.swap(next);
+        next.clear();
+    }
+    // Edges between two expanded nodes are seen from both ends.
+    sort(edges.begin(), edges.end());
+    edges.erase(unique(edges.begin(), edges.end()), edges.end());
+}
+
+vector<vector<Node_Id>> Graph::multi_source_bfs(const vector<Node_Id>& sources,
+        bool is_fwd, Bfs_Scratch& scratch) const {
+    assert(sources.size() <= BFS_LANES);
+    vector<Node_Id> (Graph::*get_neighbors)(Node_Id) const = is_fwd ?
+        &Graph::get_outgoing_edges : &Graph::get_incoming_edges;
+    auto& seen = scratch.seen;
+    auto& next = scratch.next;
+    auto& frontier = scratch.frontier;
+    seen.clear();
+    next.clear();
+    frontier.clear();
+
+    // As in traverse, a source is only reported if it is reached again.
+    for (size_t lane = 0; lane < sources.size(); ++lane) {
+        next[sources[lane]] |= 1ULL << lane;
+    }
+    while (!next.empty()) {
+        frontier.assign(next.begin(), next.end());
+        next.clear();
+        for (auto& entry : frontier) {
+            for (Node_Id nid : (this->*get_neighbors)(entry.first)) {
+                uint64_t& lanes = seen[nid];
+                uint64_t added = entry.second & ~lanes;
+                if (added) {
+                    lanes |= added;
+                    next[nid] |= added;
+                }
+            }
+        }
+    }
+
+    vector<vector<Node_Id>> results(sources.size());
+    for (auto& entry : seen) {
+        for (uint64_t lanes = entry.second; lanes; lanes &= lanes - 1) {
+            results[__builtin_ctzll(lanes)].push_back(entry.first);
+        }
+    }
+    for (auto& result : results) {
+        sort(result.begin(), result.end());
+    }
+    return results;
+}
+
+/*
+ * Counts what get_all_paths would return without building the paths: a
+ * depth-first search that memoizes the number of paths from each node to
+ * the sink. Edges leading back onto the current path are skipped, and the
+ * count saturates instead of overflowing.
+ */
+size_t Graph::count_paths(Node_Id source, Node_Id sink) const {
+    struct Entry {
+        Node_Id node;
+        vector<Node_Id> children;
+        size_t next;
+        size_t count;
+    };
+    auto add = [](size_t a, size_t b) {
+        return a > numeric_limits<size_t>::max() - b ?
+            numeric_limits<size_t>::max() : a + b;
+    };
+
+    if (source == sink) {
+        return 1;
+    }
+    map<Node_Id, size_t> memo;
+    set<Node_Id> on_path = {source};
+    vector<Entry> stack {{source, get_outgoing_edges(source), 0, 0}};
+    while (true) {
+        Entry& top = stack.back();
+        if (top.next < top.children.size()) {
+            Node_Id child = top.children[top.next++];
+            if (child == sink) {
+                top.count = add(top.count, 1);
+                continue;
+            }
+            auto counted = memo.find(child);
+            if (counted != memo.end()) {
+                top.count = add(top.count, counted->second);
+            } else if (on_path.insert(child).second) {
+                stack.push_back({child, get_outgoing_edges(child), 0, 0});
+            }
+            continue;
+        }
+
+        Node_Id node = top.node;
+        size_t count = top.count;
+        stack.pop_back();
+        if (stack.empty()) {
+            return count;
+        }
+        memo[node] = count;
+        on_path.erase(node);
+        stack.back().count = add(stack.back().count, count);
+    }
+}
+
+bool Graph::path_exists(Node_Id source, Node_Id sink) const {
+    if (source == sink) {
+        return true;
+    }
+    bool found = false;
+    traverse(source, true, Traversal_Filter(), nullptr, [&](Node_Id n) {
+        found = (n == sink);
+        return !found;
+    });
+    return found;
+}
+
+vector<vector<Node_Id>> Graph::get_all_paths(Node_Id source, Node_Id sink) const {
     typedef vector<Node_Id> v;
     struct Entry {
         Node_Id node;
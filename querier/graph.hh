@@ -2,28 +2,104 @@
 #define GRAPH_HH
 
 #include <cstddef>
+#include <ctime>
+#include <functional>
+#include <limits>
 #include <vector>
 #include <map>
 #include <string>
+#include <unordered_map>
 
 #include "metadata.hh"
 
 class Metadata;
 
+/*
+ * Restricts a traversal by cf:type and cf:date. Only edges whose type is in
+ * edge_types are followed, only nodes whose type is in via_types are
+ * expanded further, and only nodes whose type is in node_types are
+ * reported. An empty set matches every type. Edges and nodes dated outside
+ * [t_from, t_to] are neither followed nor reported; undated ones always
+ * pass. Nodes more than max_depth hops away are never reached.
+ */
+struct Traversal_Filter {
+    Type_Set edge_types;
+    Type_Set node_types;
+    Type_Set via_types;
+    time_t t_from;
+    time_t t_to;
+    size_t max_depth;
+
+    Traversal_Filter() : t_from(std::numeric_limits<time_t>::min()),
+        t_to(std::numeric_limits<time_t>::max()),
+        max_depth(std::numeric_limits<size_t>::max()) {}
+
+    bool is_empty() const {
+        return edge_types.none() && node_types.none() && via_types.none()
+            && !has_window()
+            && max_depth == std::numeric_limits<size_t>::max();
+    }
+    bool has_window() const {
+        return t_from != std::numeric_limits<time_t>::min()
+            || t_to != std::numeric_limits<time_t>::max();
+    }
+    bool in_window(time_t t) const {
+        return t == NO_TIME || (t >= t_from && t <= t_to);
+    }
+    static bool matches(const Type_Set& types, Type_Code typ) {
+        return types.none() || (typ < types.size() && types.test(typ));
+    }
+};
+
+/*
+ * Working space for multi_source_bfs, kept between calls so that repeated
+ * batches do not reallocate it.
+ */
+struct Bfs_Scratch {
+    std::unordered_map<Node_Id, uint64_t> seen;
+    std::unordered_map<Node_Id, uint64_t> next;
+    std::vector<std::pair<Node_Id, uint64_t>> frontier;
+};
+
 class Graph {
     public:
-        virtual std::vector<Node_Id> get_outgoing_edges(Node_Id) = 0;
-        virtual std::vector<Node_Id> get_incoming_edges(Node_Id) = 0;
+        static const size_t BFS_LANES = 64;
+
+        virtual ~Graph() {}
+        virtual std::vector<Node_Id> get_outgoing_edges(Node_Id) const = 0;
+        virtual std::vector<Node_Id> get_incoming_edges(Node_Id) const = 0;
         virtual std::map<std::string, std::vector<Node_Id>> friends_of(Node_Id,
-                Node_Id, Metadata*) = 0;
-        virtual size_t get_node_count() = 0;
-        std::vector<Node_Id> get_all_descendants(Node_Id);
-        std::vector<Node_Id> get_all_ancestors(Node_Id);
-        std::vector<std::vector<Node_Id>> get_all_paths(Node_Id, Node_Id);
+                Node_Id, const Metadata*) const = 0;
+        virtual size_t get_node_count() const = 0;
+        std::vector<Node_Id> get_all_descendants(Node_Id) const;
+        std::vector<Node_Id> get_all_ancestors(Node_Id) const;
+        std::vector<std::vector<Node_Id>> get_all_paths(Node_Id, Node_Id) const;
+        std::vector<Node_Id> get_all_descendants(Node_Id, const Traversal_Filter&,
+                const Metadata*) const;
+        std::vector<Node_Id> get_all_ancestors(Node_Id, const Traversal_Filter&,
+                const Metadata*) const;
+        // Nodes within k hops in either direction, and every edge (as a
+        // (src, dest) pair) incident to a node fewer than k hops away,
+        // whichever way it points.
+        void get_neighborhood(Node_Id, size_t, std::vector<Node_Id>&,
+                std::vector<std::pair<Node_Id, Node_Id>>&) const;
+        size_t count_paths(Node_Id, Node_Id) const;
+        bool path_exists(Node_Id, Node_Id) const;
+        // All descendants (or ancestors) of up to BFS_LANES sources at once;
+        // each source owns one bit of a per-node mask, so closures that
+        // overlap are only expanded once.
+        std::vector<std::vector<Node_Id>> multi_source_bfs(
+                const std::vector<Node_Id>&, bool, Bfs_Scratch&) const;
+
+        // Level-synchronous breadth-first traversal from (but not
+        // including) the given node. The visitor is called once per
+        // reported node and may return false to stop the traversal early.
+        void traverse(Node_Id, bool, const Traversal_Filter&, const Metadata*,
+                std::function<bool(Node_Id)>) const;
 
     private:
         std::vector<Node_Id> bfs_helper(Node_Id,
-                std::vector<Node_Id> (Graph::*)(Node_Id));
+                std::vector<Node_Id> (Graph::*)(Node_Id) const) const;
         /*
         std::vector<std::vector<Node_Id>*> all_paths_helper(Node_Id, Node_Id);
         */
@@ -0,0 +1,114 @@
+#include <random>
+
+#include "graph_loader.hh"
+
+/*
+ * Compares compressed graphs of the same trace written with different
+ * codecs: size, bits per edge, time to decode every neighbor list, time
+ * per random neighbor lookup, and time per node reached by full ancestor
+ * and descendant traversals from random nodes. Every graph's lists are
+ * checked against the first one's, unless --no-check is given (for graphs
+ * whose nodes are numbered differently).
+ *
+ * Usage: ./graph_bench graph.cpg [graph.cpge ...] [--lookups=N]
+ *            [--traversals=N] [--no-check]
+ */
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t lookups = 200000;
+    size_t traversals = 200;
+    bool check = true;
+    vector<string> files;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.find("--lookups=") == 0) {
+            lookups = atoi(arg.substr(10).c_str());
+        } else if (arg.find("--traversals=") == 0) {
+            traversals = atoi(arg.substr(13).c_str());
+        } else if (arg == "--no-check") {
+            check = false;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        cerr << "Usage: ./graph_bench graph [graph ...] [--lookups=N] "
+            "[--traversals=N] [--no-check]" << endl;
+        return 1;
+    }
+
+    printf("%-24s %-12s %10s %10s %8s %12s %12s %12s %8s\n", "file",
+            "codec", "bytes", "edges", "bits/e", "scan ns/e", "lookup ns",
+            "bfs ns/node", "mism");
+    Graph_V2* reference = nullptr;
+    bool ok = true;
+    for (auto& file : files) {
+        string buffer;
+        read_file(file, buffer);
+        size_t bytes = buffer.size();
+        Graph_V2* graph = load_compressed_graph(buffer);
+        size_t nodes = graph->get_node_count();
+
+        size_t edges = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (Node_Id n = 0; n < nodes; ++n) {
+            edges += graph->get_outgoing_edges(n).size();
+            edges += graph->get_incoming_edges(n).size();
+        }
+        double scan = seconds_since(start);
+        // each edge is in one outgoing and one incoming list
+        edges /= 2;
+
+        std::mt19937_64 rng(1);
+        size_t sink = 0;
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < lookups; ++i) {
+            Node_Id n = rng() % nodes;
+            sink += (i & 1) ? graph->get_outgoing_edges(n).size() :
+                graph->get_incoming_edges(n).size();
+        }
+        double lookup = seconds_since(start);
+
+        size_t reached = 0;
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < traversals; ++i) {
+            Node_Id n = rng() % nodes;
+            reached += (i & 1) ? graph->get_all_descendants(n).size() :
+                graph->get_all_ancestors(n).size();
+        }
+        double bfs = seconds_since(start);
+
+        size_t mismatches = 0;
+        if (!reference) {
+            reference = graph;
+        } else if (check && reference->get_node_count() != nodes) {
+            mismatches = nodes;
+        } else if (check) {
+            for (Node_Id n = 0; n < nodes; ++n) {
+                mismatches += graph->get_outgoing_edges(n) !=
+                    reference->get_outgoing_edges(n);
+                mismatches += graph->get_incoming_edges(n) !=
+                    reference->get_incoming_edges(n);
+            }
+        }
+        ok = ok && !mismatches;
+
+        printf("%-24s %-12s %10zu %10zu %8.2f %12.1f %12.1f %12.1f %8zu\n",
+                file.substr(file.rfind('/') + 1).c_str(), graph->codec_name(),
+                bytes, edges, edges ? 8.0 * bytes / edges : 0.0,
+                edges ? 1e9 * scan / (2 * edges) : 0.0,
+                lookups ? 1e9 * lookup / lookups : 0.0,
+                reached ? 1e9 * bfs / reached : 0.0, mismatches);
+        if (graph != reference) {
+            delete graph;
+        }
+        (void) sink;
+    }
+    delete reference;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#include "graph_bw.hh"
+
+using namespace std;
+
+Graph_BW::Graph_BW(BitSet compressed)
+    : Graph_V2(std::move(compressed), CODEC_BLOCK_WIDTHS) {
+    size_t pos = ((header_end + 7) >> 3) << 3;
+    pos += data.get_bits<size_t>(log_block_size, 8, pos);
+    size_t num_groups = group_index_length - 1;
+    blocks.resize((num_groups + (1 << log_block_size) - 1) >> log_block_size);
+    for (auto& block : blocks) {
+        pos += data.get_bits<size_t>(block.fwd.nbits_degree, 6, pos);
+        pos += data.get_bits<size_t>(block.fwd.nbits_delta, 6, pos);
+        pos += data.get_bits<size_t>(block.back.nbits_degree, 6, pos);
+        pos += data.get_bits<size_t>(block.back.nbits_delta, 6, pos);
+    }
+    base_pos = ((pos + 7) >> 3) << 3;
+    check_lists_end();
+}
+
+size_t Graph_BW::lists_end(Group_Idx idx) const {
+    const block_t& block = get_block(idx);
+    size_t pos = skip_edges_raw(get_group_pos(idx), block.fwd);
+    if (pos > data.size() * 8) {
+        return pos;
+    }
+    return skip_edges_raw(pos, block.back);
+}
+
+vector<Node_Id> Graph_BW::get_outgoing_edges_raw(Group_Idx idx) const {
+    add_count(decode_counters().groups_decoded);
+    return read_edges_raw(idx, get_group_pos(idx), get_block(idx).fwd);
+}
+
+vector<Node_Id> Graph_BW::get_incoming_edges_raw(Group_Idx idx) const {
+    add_count(decode_counters().groups_decoded);
+    const block_t& block = get_block(idx);
+    size_t pos = skip_edges_raw(get_group_pos(idx), block.fwd);
+    return read_edges_raw(idx, pos, block.back);
+}
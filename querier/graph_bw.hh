@@ -0,0 +1,33 @@
+#ifndef GRAPH_BW_HH
+#define GRAPH_BW_HH
+
+#include "graph_v2.hh"
+
+/*
+ * Graph_V2 lists, with degree and delta widths chosen for each block of
+ * consecutive groups (compress_graph_bw.py) instead of once per file.
+ */
+class Graph_BW : public Graph_V2 {
+    public:
+        Graph_BW(BitSet);
+        const char* codec_name() const override { return "block-widths"; }
+
+    protected:
+        std::vector<Node_Id> get_outgoing_edges_raw(Group_Idx) const override;
+        std::vector<Node_Id> get_incoming_edges_raw(Group_Idx) const override;
+        size_t lists_end(Group_Idx) const override;
+
+    private:
+        struct block_t {
+            info_t fwd;
+            info_t back;
+        };
+        size_t log_block_size;
+        std::vector<block_t> blocks;
+
+        const block_t& get_block(Group_Idx idx) const {
+            return blocks[idx >> log_block_size];
+        }
+};
+
+#endif
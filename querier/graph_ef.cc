@@ -0,0 +1,290 @@
+#include "graph_ef.hh"
+
+using namespace std;
+
+static size_t ef_low_bits(uint64_t universe, size_t count) {
+    if (universe < count) {
+        return 0;
+    }
+    return 63 - __builtin_clzll(universe / count);
+}
+
+static size_t width_of(uint64_t i) {
+    return 64 - __builtin_clzll(max(i, (uint64_t) 1));
+}
+
+// get_gamma that throws, rather than asserting, if no code starts at pos
+// within the file
+static size_t read_gamma(const BitSet& data, uint64_t& val, size_t pos) {
+    size_t bits = data.size() * 8;
+    size_t length = pos < bits ? data.peek_gamma(val, pos) : 0;
+    if (!length || length > bits - pos) {
+        Graph_V2::corrupt("lists run past the end");
+    }
+    add_count(decode_counters().bits_read, length);
+    return length;
+}
+
+Ef_Run::Ef_Run(const BitSet& data, size_t pos, size_t count, uint64_t base)
+    : data_(data), count_(count), base_(base) {
+    if (!is_partitioned()) {
+        whole_ = read_chunk(pos, count, base);
+        end_ = whole_.high_pos + count +
+            ((whole_.last - base) >> whole_.low_bits);
+        return;
+    }
+    uint64_t universe;
+    pos += read_gamma(data_, universe, pos);
+    --universe;
+    pos += data_.get_bits<size_t>(nbits_offset_, 6, pos);
+    nbits_upper_ = width_of(universe);
+    num_chunks_ = (count + EF_PARTITION_SIZE - 1) / EF_PARTITION_SIZE;
+    dir_pos_ = pos;
+    chunks_pos_ = pos + num_chunks_ * (nbits_upper_ + nbits_offset_);
+    end_ = chunks_pos_ + chunk_end(num_chunks_ - 1);
+}
+
+Ef_Run::Chunk Ef_Run::read_chunk(size_t pos, size_t count,
+        uint64_t base) const {
+    Chunk c;
+    uint64_t universe;
+    pos += read_gamma(data_, universe, pos);
+    --universe;
+    c.count = count;
+    c.low_bits = ef_low_bits(universe, count);
+    c.low_pos = pos;
+    c.high_pos = pos + count * c.low_bits;
+    c.base = base;
+    c.last = base + universe;
+    return c;
+}
+
+uint64_t Ef_Run::chunk_upper(size_t j) const {
+    return data_.read_bits(nbits_upper_, dir_pos_ + j * nbits_upper_);
+}
+
+size_t Ef_Run::chunk_end(size_t j) const {
+    return data_.read_bits(nbits_offset_,
+            dir_pos_ + num_chunks_ * nbits_upper_ + j * nbits_offset_);
+}
+
+Ef_Run::Chunk Ef_Run::get_chunk(size_t j) const {
+    size_t pos = chunks_pos_ + (j ? chunk_end(j - 1) : 0);
+    size_t count = min(EF_PARTITION_SIZE, count_ - j * EF_PARTITION_SIZE);
+    return read_chunk(pos, count, base_ + (j ? chunk_upper(j - 1) : 0));
+}
+
+// Position of the i-th set (or clear) high bit of a chunk. A chunk's high
+// bits number fewer than three per value, so this reads a bounded number
+// of words.
+size_t Ef_Run::select(const Chunk& c, size_t i, bool bit) const {
+    size_t pos = c.high_pos;
+    while (true) {
+        uint64_t word = data_.read_bits(64, pos);
+        if (!bit) {
+            word = ~word;
+        }
+        size_t n = __builtin_popcountll(word);
+        if (i < n) {
+            for (; i; --i) {
+                word ^= (1ULL << 63) >> __builtin_clzll(word);
+            }
+            return pos + __builtin_clzll(word);
+        }
+        i -= n;
+        pos += 64;
+    }
+}
+
+// Position of the first set bit at or after pos; there must be one.
+size_t Ef_Run::next_one(size_t pos) const {
+    while (true) {
+        uint64_t word = data_.read_bits(64, pos);
+        if (word) {
+            return pos + __builtin_clzll(word);
+        }
+        pos += 64;
+    }
+}
+
+// The i-th value of a chunk, whose high bit is at high
+uint64_t Ef_Run::chunk_at(const Chunk& c, size_t i, size_t high) const {
+    uint64_t low = data_.read_bits(c.low_bits, c.low_pos + i * c.low_bits);
+    return c.base + (((high - c.high_pos - i) << c.low_bits) | low);
+}
+
+// Index of the first value >= x in a chunk whose last value is >= x
+size_t Ef_Run::chunk_next_geq(const Chunk& c, uint64_t x) const {
+    if (x <= c.base) {
+        return 0;
+    }
+    // Values after the h-th clear high bit have high parts of at least h.
+    uint64_t h = (x - c.base) >> c.low_bits;
+    size_t pos = c.high_pos;
+    size_t i = 0;
+    if (h) {
+        pos = select(c, h - 1, false) + 1;
+        i = pos - c.high_pos - h;
+    }
+    for (pos = next_one(pos); chunk_at(c, i, pos) < x; ++i) {
+        pos = next_one(pos + 1);
+    }
+    return i;
+}
+
+// Appends values of a chunk from index i on, and returns false if it
+// stopped at one not below hi.
+bool Ef_Run::chunk_decode(const Chunk& c, size_t i, uint64_t hi,
+        vector<Node_Id>& out) const {
+    if (i >= c.count) {
+        return true;
+    }
+    size_t pos = select(c, i, true);
+    while (true) {
+        uint64_t val = chunk_at(c, i, pos);
+        if (val >= hi) {
+            return false;
+        }
+        out.push_back(val);
+        if (++i == c.count) {
+            return true;
+        }
+        pos = next_one(pos + 1);
+    }
+}
+
+uint64_t Ef_Run::at(size_t i) const {
+    assert(i < count_);
+    if (!is_partitioned()) {
+        return chunk_at(whole_, i, select(whole_, i, true));
+    }
+    Chunk c = get_chunk(i / EF_PARTITION_SIZE);
+    i %= EF_PARTITION_SIZE;
+    return chunk_at(c, i, select(c, i, true));
+}
+
+size_t Ef_Run::next_geq(uint64_t x) const {
+    if (!is_partitioned()) {
+        return x > whole_.last ? count_ : chunk_next_geq(whole_, x);
+    }
+    size_t lo = 0;
+    size_t hi = num_chunks_;
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) >> 1);
+        if (base_ + chunk_upper(mid) < x) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == num_chunks_) {
+        return count_;
+    }
+    return lo * EF_PARTITION_SIZE + chunk_next_geq(get_chunk(lo), x);
+}
+
+void Ef_Run::decode(size_t i, uint64_t hi, vector<Node_Id>& out) const {
+    if (!is_partitioned()) {
+        chunk_decode(whole_, i, hi, out);
+        return;
+    }
+    for (size_t j = i / EF_PARTITION_SIZE; j < num_chunks_; ++j) {
+        size_t from = j == i / EF_PARTITION_SIZE ? i % EF_PARTITION_SIZE : 0;
+        if (!chunk_decode(get_chunk(j), from, hi, out)) {
+            return;
+        }
+    }
+}
+
+Graph_EF::Graph_EF(BitSet compressed)
+    : Graph_V2(std::move(compressed), CODEC_ELIAS_FANO) {
+    check_lists_end();
+}
+
+size_t Graph_EF::lists_end(Group_Idx idx) const {
+    size_t bits = data.size() * 8;
+    size_t pos = get_group_pos(idx);
+    for (int list = 0; list < 2 && pos <= bits; ++list) {
+        uint64_t degree, first;
+        pos += checked_gamma(degree, pos);
+        --degree;
+        if (degree) {
+            pos += checked_gamma(first, pos);
+        }
+        // every value in a run takes at least a bit
+        if (degree > 1 && degree - 1 > bits - pos) {
+            return bits + 1;
+        }
+        if (degree > 1) {
+            pos = Ef_Run(data, pos, degree - 1, 0).end();
+        }
+    }
+    return pos;
+}
+
+Graph_EF::List Graph_EF::read_list(Group_Idx idx, size_t pos) const {
+    List list;
+    uint64_t val;
+    pos += read_gamma(data, val, pos);
+    list.degree = val - 1;
+    if (list.degree) {
+        pos += read_gamma(data, val, pos);
+        --val;
+        Node_Id base_node = get_group_id(idx);
+        if (val % 2) {
+            list.first = base_node - (val + 1) / 2;
+        } else {
+            list.first = base_node + val / 2;
+        }
+    }
+    list.pos = pos;
+    return list;
+}
+
+Graph_EF::List Graph_EF::get_list(Group_Idx idx, bool is_fwd) const {
+    List fwd = read_list(idx, get_group_pos(idx));
+    if (is_fwd) {
+        return fwd;
+    }
+    size_t pos = fwd.pos;
+    if (fwd.degree > 1) {
+        pos = Ef_Run(data, fwd.pos, fwd.degree - 1, fwd.first).end();
+    }
+    return read_list(idx, pos);
+}
+
+vector<Node_Id> Graph_EF::read_edges(const List& list, Node_Id lo,
+        Node_Id hi) const {
+    vector<Node_Id> edges;
+    if (!list.degree || list.first >= hi) {
+        return edges;
+    }
+    if (list.first >= lo) {
+        edges.reserve(list.degree);
+        edges.push_back(list.first);
+    }
+    if (list.degree == 1) {
+        return edges;
+    }
+    Ef_Run run(data, list.pos, list.degree - 1, list.first);
+    run.decode(edges.empty() ? run.next_geq(lo) : 0, hi, edges);
+    return edges;
+}
+
+vector<Node_Id> Graph_EF::get_outgoing_edges_raw(Group_Idx idx) const {
+    add_count(decode_counters().groups_decoded);
+    return read_edges(get_list(idx, true), 0,
+            numeric_limits<Node_Id>::max());
+}
+
+vector<Node_Id> Graph_EF::get_incoming_edges_raw(Group_Idx idx) const {
+    add_count(decode_counters().groups_decoded);
+    return read_edges(get_list(idx, false), 0,
+            numeric_limits<Node_Id>::max());
+}
+
+vector<Node_Id> Graph_EF::get_raw_edges_between(Group_Idx idx, bool is_fwd,
+        Node_Id lo, Node_Id hi) const {
+    add_count(decode_counters().groups_decoded);
+    return read_edges(get_list(idx, is_fwd), lo, hi);
+}
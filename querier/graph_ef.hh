@@ -0,0 +1,95 @@
+#ifndef GRAPH_EF_HH
+#define GRAPH_EF_HH
+
+#include "graph_v2.hh"
+
+// Runs longer than this are split into chunks of this many values
+const size_t EF_PARTITION_SIZE = 128;
+
+/*
+ * A run of non-decreasing values in Elias-Fano code, read in place. Runs of
+ * up to EF_PARTITION_SIZE values are stored whole; longer ones in chunks
+ * behind a directory of each chunk's last value and end, so that at() and
+ * next_geq() only ever scan within one chunk. See compress_graph_ef.py for
+ * the layout.
+ */
+class Ef_Run {
+    public:
+        Ef_Run(const BitSet& data, size_t pos, size_t count, uint64_t base);
+        size_t size() const { return count_; }
+        // Bit position just past the run
+        size_t end() const { return end_; }
+        uint64_t at(size_t i) const;
+        // Index of the first value >= x, or size() if there is none
+        size_t next_geq(uint64_t x) const;
+        // Appends the values from index i on that are below hi
+        void decode(size_t i, uint64_t hi, std::vector<Node_Id>& out) const;
+
+    private:
+        struct Chunk {
+            size_t count;
+            size_t low_bits;
+            size_t low_pos;
+            size_t high_pos;
+            uint64_t base;
+            uint64_t last;
+        };
+
+        const BitSet& data_;
+        size_t count_;
+        uint64_t base_;
+        size_t end_;
+        // for whole runs
+        Chunk whole_;
+        // for partitioned runs
+        size_t num_chunks_;
+        size_t nbits_upper_;
+        size_t nbits_offset_;
+        size_t dir_pos_;
+        size_t chunks_pos_;
+
+        bool is_partitioned() const { return count_ > EF_PARTITION_SIZE; }
+        Chunk read_chunk(size_t pos, size_t count, uint64_t base) const;
+        Chunk get_chunk(size_t j) const;
+        uint64_t chunk_upper(size_t j) const;
+        size_t chunk_end(size_t j) const;
+        size_t select(const Chunk&, size_t i, bool bit) const;
+        size_t next_one(size_t pos) const;
+        uint64_t chunk_at(const Chunk&, size_t i, size_t high) const;
+        size_t chunk_next_geq(const Chunk&, uint64_t x) const;
+        bool chunk_decode(const Chunk&, size_t i, uint64_t hi,
+                std::vector<Node_Id>& out) const;
+};
+
+/*
+ * Graph_V2 grouping, with each group's lists in Elias-Fano code
+ * (compress_graph_ef.py). Every list carries its own widths, so a single
+ * outlying edge only widens the list it is in.
+ */
+class Graph_EF : public Graph_V2 {
+    public:
+        Graph_EF(BitSet);
+        const char* codec_name() const override { return "elias-fano"; }
+
+    protected:
+        std::vector<Node_Id> get_outgoing_edges_raw(Group_Idx) const override;
+        std::vector<Node_Id> get_incoming_edges_raw(Group_Idx) const override;
+        std::vector<Node_Id> get_raw_edges_between(Group_Idx, bool is_fwd,
+                Node_Id lo, Node_Id hi) const override;
+        size_t lists_end(Group_Idx) const override;
+
+    private:
+        struct List {
+            size_t degree;
+            Node_Id first;
+            // start of the run of the other values, or the end of the list
+            size_t pos;
+        };
+
+        List read_list(Group_Idx, size_t pos) const;
+        List get_list(Group_Idx, bool is_fwd) const;
+        std::vector<Node_Id> read_edges(const List&, Node_Id lo,
+                Node_Id hi) const;
+};
+
+#endif
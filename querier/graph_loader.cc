@@ -0,0 +1,29 @@
+#include "graph_loader.hh"
+#include "graph_bw.hh"
+#include "graph_ef.hh"
+#include "graph_paged.hh"
+#include "graph_ref.hh"
+
+#include <stdexcept>
+
+using namespace std;
+
+Graph_V2* load_compressed_graph(BitSet compressed) {
+    unsigned char tag = compressed.read_bits(8, 0);
+    unsigned char codec = compressed.read_bits(8, 8);
+    if (compressed.size() < 2 || tag != GRAPH_FORMAT_TAG) {
+        return new Graph_V2(std::move(compressed));
+    }
+    switch (codec) {
+        case CODEC_ELIAS_FANO:
+            return new Graph_EF(std::move(compressed));
+        case CODEC_BLOCK_WIDTHS:
+            return new Graph_BW(std::move(compressed));
+        case CODEC_REFERENCE:
+            return new Graph_Ref(std::move(compressed));
+        case CODEC_PAGED:
+            return new Graph_Paged(std::move(compressed));
+        default:
+            throw runtime_error("unknown graph codec " + to_string(codec));
+    }
+}
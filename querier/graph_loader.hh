@@ -0,0 +1,12 @@
+#ifndef GRAPH_LOADER_HH
+#define GRAPH_LOADER_HH
+
+#include "graph_v2.hh"
+
+// Reads a compressed graph with whichever codec its header names. The graph
+// reads the BitSet's bytes in place, so if they are borrowed (say, from a
+// mapped archive) they must outlive it. A damaged or unknown graph throws
+// a runtime_error.
+Graph_V2* load_compressed_graph(BitSet compressed);
+
+#endif
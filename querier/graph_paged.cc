@@ -0,0 +1,130 @@
+#include "graph_paged.hh"
+
+using namespace std;
+
+Graph_Paged::Graph_Paged(BitSet compressed)
+    : Graph_V2(std::move(compressed), CODEC_PAGED, false) {
+    size_t bits = data.size() * 8;
+    size_t pos = header_end;
+    if (pos + 64 + 40 + 192 > bits) {
+        corrupt("too short");
+    }
+    read_list_widths(pos);
+    size_t log_page_size, nbits_node, nbits_group, nbits_page, num_runs;
+    pos += data.get_bits<size_t>(log_page_size, 8, pos);
+    pos += data.get_bits<size_t>(nbits_page_nodes, 8, pos);
+    pos += data.get_bits<size_t>(nbits_node, 8, pos);
+    pos += data.get_bits<size_t>(nbits_group, 8, pos);
+    pos += data.get_bits<size_t>(nbits_page, 8, pos);
+    pos += data.get_bits<size_t>(num_nodes, 64, pos);
+    pos += data.get_bits<size_t>(num_groups, 64, pos);
+    pos += data.get_bits<size_t>(num_runs, 64, pos);
+    nbits_page_offset = log_page_size + 3;
+    size_t run_bits = nbits_node + nbits_group + nbits_page;
+    if (log_page_size > 32 || nbits_page_nodes > 64 || nbits_node > 64 ||
+            nbits_group > 64 || nbits_page > 64 || !run_bits) {
+        corrupt("bad page widths");
+    }
+    if (num_runs > (bits - pos) / run_bits || num_groups > num_nodes ||
+            !num_runs != !num_groups) {
+        corrupt("run index out of bounds");
+    }
+
+    // Each run's index, up to its last entry, has to lie within the file,
+    // and the runs have to go up in node, group and page, or a damaged
+    // header would send the lookups below anywhere in memory.
+    size_t page_bits = (size_t) 8 << log_page_size;
+    size_t pages_pos = (pos + num_runs * run_bits + page_bits - 1) /
+        page_bits * page_bits;
+    if (pages_pos > bits) {
+        corrupt("too short");
+    }
+    size_t num_pages = (bits - pages_pos) / page_bits;
+    size_t entry_bits = nbits_page_nodes + nbits_page_offset;
+    runs.resize(num_runs);
+    size_t prev_page = 0;
+    for (size_t i = 0; i < num_runs; ++i) {
+        run_t& run = runs[i];
+        size_t page;
+        pos += data.get_bits<Node_Id>(run.first_node, nbits_node, pos);
+        pos += data.get_bits<size_t>(run.first_group, nbits_group, pos);
+        pos += data.get_bits<size_t>(page, nbits_page, pos);
+        bool first = i == 0;
+        if (first ? run.first_node || run.first_group || page :
+                run.first_node <= runs[i - 1].first_node ||
+                run.first_group <= runs[i - 1].first_group ||
+                page <= prev_page) {
+            corrupt("bad run " + to_string(i));
+        }
+        if (page >= num_pages) {
+            corrupt("run " + to_string(i) + " out of bounds");
+        }
+        run.pos = pages_pos + page * page_bits;
+        prev_page = page;
+    }
+    run_t end = {(Node_Id) num_nodes, num_groups, 0};
+    runs.push_back(end);
+    for (size_t i = 0; i < num_runs; ++i) {
+        const run_t& run = runs[i];
+        size_t run_groups = runs[i + 1].first_group - run.first_group;
+        size_t index_pos = run.pos + 32 + nbits_page_nodes;
+        if (run.first_node >= num_nodes || run_groups > num_groups ||
+                index_pos > bits ||
+                run_groups > (bits - index_pos) / entry_bits ||
+                data.read_bits(32, run.pos) != run_groups) {
+            corrupt("run " + to_string(i) + " out of bounds");
+        }
+    }
+    header_end = base_pos = pages_pos;
+    check_lists_end();
+}
+
+const Graph_Paged::run_t& Graph_Paged::get_run(Group_Idx idx) const {
+    auto it = upper_bound(runs.begin(), runs.end(), (size_t) idx,
+            [](size_t i, const run_t& run) { return i < run.first_group; });
+    return *(it - 1);
+}
+
+Graph_V2::Group_Idx Graph_Paged::get_group_index(Node_Id node) const {
+    auto it = upper_bound(runs.begin(), runs.end(), node,
+            [](Node_Id n, const run_t& run) { return n < run.first_node; });
+    const run_t& run = *(it - 1);
+    Node_Id offset = node - run.first_node;
+    // the last group in the run whose first node is at or before node
+    size_t lo = 0;
+    size_t hi = it->first_group - run.first_group;
+    while (hi - lo > 1) {
+        size_t mid = lo + ((hi - lo) >> 1);
+        if (data.read_bits(nbits_page_nodes, entry_pos(run, mid)) <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return (Group_Idx) (run.first_group + lo);
+}
+
+size_t Graph_Paged::get_group_size(Group_Idx idx) const {
+    const run_t& run = get_run(idx);
+    size_t slot = idx - run.first_group;
+    size_t first = data.read_bits(nbits_page_nodes, entry_pos(run, slot));
+    size_t next;
+    if (idx + 1 < (&run + 1)->first_group) {
+        next = data.read_bits(nbits_page_nodes, entry_pos(run, slot + 1));
+    } else {
+        next = data.read_bits(nbits_page_nodes, run.pos + 32);
+    }
+    return next - first;
+}
+
+Node_Id Graph_Paged::get_group_id(Group_Idx idx) const {
+    const run_t& run = get_run(idx);
+    return run.first_node + data.read_bits(nbits_page_nodes,
+            entry_pos(run, idx - run.first_group));
+}
+
+size_t Graph_Paged::get_group_pos(Group_Idx idx) const {
+    const run_t& run = get_run(idx);
+    return run.pos + data.read_bits(nbits_page_offset,
+            entry_pos(run, idx - run.first_group) + nbits_page_nodes);
+}
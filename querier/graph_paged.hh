@@ -0,0 +1,47 @@
+#ifndef GRAPH_PAGED_HH
+#define GRAPH_PAGED_HH
+
+#include "graph_v2.hh"
+
+/*
+ * Graph_V2 lists, with groups packed into fixed-size pages that each carry
+ * their own index (compress_graph_paged.py). Only one entry per run of
+ * pages is kept in memory; everything else is read from the data when it
+ * is needed, so a graph read in place from a mapped file (see Archive) is
+ * paged in as it is traversed, and can be larger than memory.
+ */
+class Graph_Paged : public Graph_V2 {
+    public:
+        Graph_Paged(BitSet);
+        size_t get_node_count() const override { return num_nodes; }
+        const char* codec_name() const override { return "paged"; }
+
+    protected:
+        size_t get_group_count() const override { return num_groups; }
+        Group_Idx get_group_index(Node_Id) const override;
+        size_t get_group_size(Group_Idx) const override;
+        Node_Id get_group_id(Group_Idx) const override;
+        size_t get_group_pos(Group_Idx) const override;
+
+    private:
+        struct run_t {
+            Node_Id first_node;
+            size_t first_group;
+            // bit position of the run's index
+            size_t pos;
+        };
+        size_t num_nodes;
+        size_t num_groups;
+        size_t nbits_page_nodes;
+        size_t nbits_page_offset;
+        // ends with a sentinel run
+        std::vector<run_t> runs;
+
+        const run_t& get_run(Group_Idx) const;
+        size_t entry_pos(const run_t& run, size_t slot) const {
+            return run.pos + 32 + nbits_page_nodes +
+                slot * (nbits_page_nodes + nbits_page_offset);
+        }
+};
+
+#endif
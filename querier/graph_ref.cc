@@ -0,0 +1,141 @@
+#include "graph_ref.hh"
+
+using namespace std;
+
+Graph_Ref::Graph_Ref(BitSet compressed)
+    : Graph_V2(std::move(compressed), CODEC_REFERENCE) {
+    size_t pos = ((header_end + 7) >> 3) << 3;
+    pos += data.get_bits<size_t>(window, 8, pos);
+    pos += data.get_bits<size_t>(max_chain, 8, pos);
+    base_pos = pos;
+    // A backward list starts where its forward list ends, which takes
+    // decoding the forward list to find; find them all once, here.
+    back_offsets.resize(get_group_count());
+    for (size_t idx = 0; idx < back_offsets.size(); ++idx) {
+        size_t fwd_pos = get_group_pos(idx);
+        back_offsets[idx] = skip_list(fwd_pos) - fwd_pos;
+    }
+    check_lists_end();
+}
+
+size_t Graph_Ref::lists_end(Group_Idx idx) const {
+    return skip_list(get_list_pos(idx, false));
+}
+
+vector<Node_Id> Graph_Ref::get_outgoing_edges_raw(Group_Idx idx) const {
+    add_count(decode_counters().groups_decoded);
+    return read_list(idx, true, 0, numeric_limits<Node_Id>::max());
+}
+
+vector<Node_Id> Graph_Ref::get_incoming_edges_raw(Group_Idx idx) const {
+    add_count(decode_counters().groups_decoded);
+    return read_list(idx, false, 0, numeric_limits<Node_Id>::max());
+}
+
+vector<Node_Id> Graph_Ref::get_raw_edges_between(Group_Idx idx, bool is_fwd,
+        Node_Id lo, Node_Id hi) const {
+    add_count(decode_counters().groups_decoded);
+    vector<Node_Id> edges = read_list(idx, is_fwd, 0, hi);
+    edges.erase(edges.begin(), lower_bound(edges.begin(), edges.end(), lo));
+    return edges;
+}
+
+size_t Graph_Ref::get_list_pos(Group_Idx idx, bool is_fwd) const {
+    size_t pos = get_group_pos(idx);
+    return is_fwd ? pos : pos + back_offsets[idx];
+}
+
+// Position just past a list, found without decoding the list it copies.
+// Only used while loading, so it checks that the list ends in the file.
+size_t Graph_Ref::skip_list(size_t pos) const {
+    uint64_t ref, count, val;
+    pos += checked_gamma(ref, pos);
+    if (ref > 1) {
+        pos += checked_gamma(count, pos);
+        for (--count; count; --count) {
+            pos += checked_gamma(val, pos);
+        }
+    }
+    pos += checked_gamma(count, pos);
+    for (--count; count; --count) {
+        pos += checked_gamma(val, pos);
+    }
+    return pos;
+}
+
+// The edges of a list below hi. The lists are sorted, so this decodes the
+// lists it copies only as far as hi too.
+vector<Node_Id> Graph_Ref::read_list(Group_Idx idx, bool is_fwd,
+        size_t depth, Node_Id hi) const {
+    size_t start = get_list_pos(idx, is_fwd);
+    size_t pos = start;
+    uint64_t ref, count;
+    pos += data.peek_gamma(ref, pos);
+    --ref;
+
+    vector<Node_Id> copied;
+    if (ref) {
+        if (depth >= max_chain || ref > window || ref > idx) {
+            corrupt("bad reference in group " + to_string(idx));
+        }
+        vector<Node_Id> ref_edges = read_list(idx - ref, is_fwd, depth + 1,
+                hi);
+        size_t avail = ref_edges.size();
+        pos += data.peek_gamma(count, pos);
+        --count;
+        size_t i = 0;
+        for (size_t b = 0; b < count; ++b) {
+            uint64_t len;
+            pos += data.peek_gamma(len, pos);
+            if (!b) {
+                --len;
+            }
+            // blocks alternately copy and skip, starting with copy
+            if (!(b % 2) && i < avail) {
+                copied.insert(copied.end(), ref_edges.begin() + i,
+                        ref_edges.begin() + min<size_t>(i + len, avail));
+            }
+            i += len;
+        }
+        if (!(count % 2) && i < avail) {
+            copied.insert(copied.end(), ref_edges.begin() + i,
+                    ref_edges.end());
+        }
+    }
+
+    pos += data.peek_gamma(count, pos);
+    --count;
+    vector<Node_Id> residuals;
+    if (count) {
+        uint64_t val;
+        pos += data.peek_gamma(val, pos);
+        --val;
+        Node_Id base_node = get_group_id(idx);
+        Node_Id node;
+        if (val % 2) {
+            node = base_node - (val + 1) / 2;
+        } else {
+            node = base_node + val / 2;
+        }
+        for (size_t i = 0; node < hi; ) {
+            residuals.push_back(node);
+            if (++i == count) {
+                break;
+            }
+            pos += data.peek_gamma(val, pos);
+            node += val - 1;
+        }
+    }
+    add_count(decode_counters().bits_read, pos - start);
+    if (copied.empty()) {
+        return residuals;
+    }
+    if (residuals.empty()) {
+        return copied;
+    }
+
+    vector<Node_Id> edges(copied.size() + residuals.size());
+    merge(copied.begin(), copied.end(), residuals.begin(), residuals.end(),
+            edges.begin());
+    return edges;
+}
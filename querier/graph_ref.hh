@@ -0,0 +1,35 @@
+#ifndef GRAPH_REF_HH
+#define GRAPH_REF_HH
+
+#include "graph_v2.hh"
+
+/*
+ * Graph_V2 grouping, where a group's list may copy parts of the list of a
+ * group shortly before it (compress_graph_ref.py). A list is decoded with
+ * at most max_chain others, however the lists refer to each other.
+ */
+class Graph_Ref : public Graph_V2 {
+    public:
+        Graph_Ref(BitSet);
+        const char* codec_name() const override { return "reference"; }
+
+    protected:
+        std::vector<Node_Id> get_outgoing_edges_raw(Group_Idx) const override;
+        std::vector<Node_Id> get_incoming_edges_raw(Group_Idx) const override;
+        std::vector<Node_Id> get_raw_edges_between(Group_Idx, bool is_fwd,
+                Node_Id lo, Node_Id hi) const override;
+        size_t lists_end(Group_Idx) const override;
+
+    private:
+        size_t window;
+        size_t max_chain;
+        // where each group's backward list starts, from its forward list
+        std::vector<size_t> back_offsets;
+
+        size_t get_list_pos(Group_Idx, bool is_fwd) const;
+        size_t skip_list(size_t pos) const;
+        std::vector<Node_Id> read_list(Group_Idx, bool is_fwd,
+                size_t depth, Node_Id hi) const;
+};
+
+#endif
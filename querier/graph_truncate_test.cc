@@ -0,0 +1,62 @@
+#include <memory>
+#include <stdexcept>
+
+#include "graph_loader.hh"
+
+/*
+ * Loads every prefix of a sample graph in each codec. A prefix has to be
+ * refused with a runtime_error, or read back with the same edges as the
+ * whole file; anything else (a crash, an assertion, different edges) is a
+ * codec trusting its input.
+ *
+ * Usage: ./truncate_test (from the querier directory)
+ */
+
+static const char* samples[] = {
+    "samples/copythrice.cpg2",
+    "samples/copythrice.cpge",
+    "samples/copythrice.cpgb",
+    "samples/copythrice.cpgr",
+    "samples/copythrice.cpgp",
+};
+
+static vector<vector<Node_Id>> all_edges(const Graph& graph) {
+    vector<vector<Node_Id>> edges;
+    for (Node_Id node = 0; node < graph.get_node_count(); ++node) {
+        edges.push_back(graph.get_outgoing_edges(node));
+        edges.push_back(graph.get_incoming_edges(node));
+    }
+    return edges;
+}
+
+int main() {
+    bool ok = true;
+    for (const char* file : samples) {
+        string buffer;
+        read_file(file, buffer);
+        unique_ptr<Graph_V2> whole(load_compressed_graph(BitSet(buffer)));
+        vector<vector<Node_Id>> expected = all_edges(*whole);
+
+        size_t loaded = 0;
+        size_t refused = 0;
+        size_t wrong = 0;
+        for (size_t len = 0; len < buffer.size(); ++len) {
+            try {
+                unique_ptr<Graph_V2> graph(load_compressed_graph(
+                            BitSet(buffer.substr(0, len))));
+                if (all_edges(*graph) != expected) {
+                    ++wrong;
+                }
+                ++loaded;
+            } catch (const runtime_error&) {
+                ++refused;
+            }
+        }
+        cout << file << " (" << whole->codec_name() << "): "
+            << buffer.size() << " prefixes, " << refused << " refused, "
+            << loaded << " loaded, " << wrong << " wrong" << endl;
+        ok &= wrong == 0;
+    }
+    cout << (ok ? "PASS" : "FAIL") << endl;
+    return ok ? 0 : 1;
+}
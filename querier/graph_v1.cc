@@ -40,12 +40,13 @@ Graph_V1::Graph_V1(string& compressed) : data(compressed) {
 }
 
 // TODO
-map<string, vector<Node_Id>> Graph_V1::friends_of(Node_Id, Node_Id, Metadata*) {
+map<string, vector<Node_Id>> Graph_V1::friends_of(Node_Id, Node_Id,
+        const Metadata*) const {
     return {};
 }
 
 vector<Node_Id> Graph_V1::get_edges(Node_Id node, size_t pos,
-        size_t nbits_degree, size_t nbits_delta) {
+        size_t nbits_degree, size_t nbits_delta) const {
     size_t degree;
     pos += data.get_bits<size_t>(degree, nbits_degree, pos);
     if (!degree) {
@@ -68,13 +69,13 @@ vector<Node_Id> Graph_V1::get_edges(Node_Id node, size_t pos,
     return children;
 }
 
-vector<Node_Id> Graph_V1::get_outgoing_edges(Node_Id node) {
+vector<Node_Id> Graph_V1::get_outgoing_edges(Node_Id node) const {
     assert(node < get_node_count());
     return get_edges(node, index[node] + base_pos, nbits_outdegree,
             nbits_outdelta);
 }
 
-vector<Node_Id> Graph_V1::get_incoming_edges(Node_Id node) {
+vector<Node_Id> Graph_V1::get_incoming_edges(Node_Id node) const {
     assert(node < get_node_count());
     size_t pos = index[node] + base_pos;
     size_t degree;
@@ -86,7 +87,7 @@ vector<Node_Id> Graph_V1::get_incoming_edges(Node_Id node) {
     return get_edges(node, pos, nbits_indegree, nbits_indelta);
 }
 
-size_t Graph_V1::get_node_count() {
+size_t Graph_V1::get_node_count() const {
     return index_length;
 }
 
@@ -8,11 +8,11 @@ class Graph_V1 : public Graph {
     public:
         Graph_V1(std::string&);
         ~Graph_V1();
-        std::vector<Node_Id> get_outgoing_edges(Node_Id) override;
-        std::vector<Node_Id> get_incoming_edges(Node_Id) override;
+        std::vector<Node_Id> get_outgoing_edges(Node_Id) const override;
+        std::vector<Node_Id> get_incoming_edges(Node_Id) const override;
         std::map<string, std::vector<Node_Id>> friends_of(Node_Id, Node_Id,
-                Metadata*) override;
-        size_t get_node_count() override;
+                const Metadata*) const override;
+        size_t get_node_count() const override;
     private:
         BitSet data;
         size_t* index;
@@ -23,7 +23,7 @@ class Graph_V1 : public Graph {
         size_t nbits_indelta;
         size_t base_pos;
 
-        std::vector<Node_Id> get_edges(Node_Id, size_t, size_t, size_t);
+        std::vector<Node_Id> get_edges(Node_Id, size_t, size_t, size_t) const;
 };
 
 #endif
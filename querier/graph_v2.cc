@@ -1,12 +1,46 @@
 #include "graph_v2.hh"
+#include "perf_counters.hh"
 
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
 #include <tuple>
 
 using namespace std;
 
-Graph_V2::Graph_V2(string& compressed) : data(compressed) {
+// Header fields are checked before they are used, so that a truncated or
+// mismatched file is refused up front rather than read out of bounds
+void Graph_V2::corrupt(const string& why) {
+    throw runtime_error("corrupt graph: " + why);
+}
+
+// Bytes before the group index of the original format
+static const size_t UNTAGGED_HEADER_BYTES = 14;
+
+Graph_V2::Graph_V2(BitSet compressed) : data(std::move(compressed)) {
+    if (data.size() < UNTAGGED_HEADER_BYTES) {
+        corrupt("too short");
+    }
+    size_t pos = 0;
+    read_list_widths(pos);
+
+    size_t nbits_size_entry;
+    pos += data.get_bits<size_t>(nbits_size_entry, 8, pos);
+    read_group_index(nbits_size_entry, pos);
+    header_end = pos;
+    base_pos = ((pos + 7) >> 3) << 3;
+    try {
+        check_lists_end();
+    } catch (...) {
+        delete [] group_index;
+        delete [] idx2pos;
+        throw;
+    }
+}
+
+void Graph_V2::read_list_widths(size_t& pos) {
     info_t fwd_info_c, fwd_info_notc, back_info_c, back_info_notc;
-    int pos = 0;
     pos += data.get_bits<size_t>(fwd_info_c.nbits_degree, 8, pos);
     pos += data.get_bits<size_t>(fwd_info_c.nbits_delta, 8, pos);
     pos += data.get_bits<size_t>(fwd_info_notc.nbits_degree, 8, pos);
@@ -19,14 +53,56 @@ Graph_V2::Graph_V2(string& compressed) : data(compressed) {
     fwd_info[false] = fwd_info_notc;
     back_info[true] = back_info_c;
     back_info[false] = back_info_notc;
+    for (bool c : {true, false}) {
+        for (info_t info : {fwd_info[c], back_info[c]}) {
+            // a first delta is one bit wider than the rest
+            if (info.nbits_degree > 64 || info.nbits_delta > 63) {
+                corrupt("bad list widths");
+            }
+        }
+    }
+}
 
-    size_t nbits_size_entry, nbits_index_entry;
+Graph_V2::Graph_V2(BitSet compressed, Graph_Codec codec, bool has_group_index)
+    : data(std::move(compressed)), group_index(nullptr),
+      group_index_length(0), idx2pos(nullptr) {
+    size_t tag, file_codec, nbits_size_entry;
+    size_t pos = 0;
+    if (data.size() < 3) {
+        corrupt("too short");
+    }
+    pos += data.get_bits<size_t>(tag, 8, pos);
+    pos += data.get_bits<size_t>(file_codec, 8, pos);
+    assert(tag == GRAPH_FORMAT_TAG && file_codec == (size_t) codec);
+    if (!has_group_index) {
+        header_end = base_pos = pos;
+        return;
+    }
     pos += data.get_bits<size_t>(nbits_size_entry, 8, pos);
+    read_group_index(nbits_size_entry, pos);
+    header_end = pos;
+    base_pos = ((pos + 7) >> 3) << 3;
+}
+
+void Graph_V2::read_group_index(size_t nbits_size_entry, size_t& pos) {
+    size_t nbits_index_entry;
+    size_t bits = data.size() * 8;
+    if (pos + 40 > bits) {
+        corrupt("too short");
+    }
     pos += data.get_bits<size_t>(nbits_index_entry, 8, pos);
     pos += data.get_bits<size_t>(group_index_length, 32, pos);
+    size_t entry_bits = nbits_index_entry + nbits_size_entry;
+    if (nbits_index_entry < 1 || nbits_index_entry > 64 ||
+            nbits_size_entry < 1 || nbits_size_entry > 64) {
+        corrupt("bad group index widths");
+    }
+    if (group_index_length > (bits - pos) / entry_bits) {
+        corrupt("group index out of bounds");
+    }
     ++group_index_length;
-    group_index = new Node_Id[group_index_length];
-    idx2pos = new size_t[group_index_length - 1];
+    unique_ptr<Node_Id[]> ids(new Node_Id[group_index_length]);
+    unique_ptr<size_t[]> locs(new size_t[group_index_length - 1]);
     size_t prev_size = 0;
     Node_Id prev_id = 0;
     size_t prev_loc = 0;
@@ -36,14 +112,46 @@ Graph_V2::Graph_V2(string& compressed) : data(compressed) {
         pos += data.get_bits<size_t>(sz, nbits_size_entry, pos);
         Node_Id id = prev_id + prev_size;
         loc += prev_loc;
-        group_index[i] = id;
-        idx2pos[i] = loc;
+        if (sz == 0 || loc < prev_loc || loc > bits - pos) {
+            corrupt("bad group index entry " + to_string(i));
+        }
+        ids[i] = id;
+        locs[i] = loc;
         prev_loc = loc;
         prev_id = id;
         prev_size = sz;
     }
-    group_index[group_index_length - 1] = prev_id + prev_size;
-    base_pos = ((pos + 7) >> 3) << 3;
+    ids[group_index_length - 1] = prev_id + prev_size;
+    group_index = ids.release();
+    idx2pos = locs.release();
+}
+
+// The lists are laid out in group order, so if the last group's lists end
+// within the file, so do all the others.
+void Graph_V2::check_lists_end() const {
+    size_t num_groups = get_group_count();
+    if (num_groups && lists_end((Group_Idx) (num_groups - 1)) >
+            data.size() * 8) {
+        corrupt("lists run past the end");
+    }
+}
+
+size_t Graph_V2::lists_end(Group_Idx idx) const {
+    bool is_collapsed = get_group_size(idx) > 1;
+    size_t pos = skip_edges_raw(get_group_pos(idx), fwd_info[is_collapsed]);
+    if (pos > data.size() * 8) {
+        return pos;
+    }
+    return skip_edges_raw(pos, back_info[is_collapsed]);
+}
+
+size_t Graph_V2::checked_gamma(uint64_t& val, size_t pos) const {
+    size_t bits = data.size() * 8;
+    size_t length = pos < bits ? data.peek_gamma(val, pos) : 0;
+    if (!length || length > bits - pos) {
+        corrupt("lists run past the end");
+    }
+    return length;
 }
 
 Graph_V2::~Graph_V2() {
@@ -51,20 +159,22 @@ Graph_V2::~Graph_V2() {
     delete [] idx2pos;
 }
 
-vector<Node_Id> Graph_V2::get_outgoing_edges(Node_Id node) {
-    return get_edges(node, true, &Graph_V2::get_outgoing_edges_raw,
-            &Graph_V2::get_incoming_edges_raw);
+vector<Node_Id> Graph_V2::get_outgoing_edges(Node_Id node) const {
+    return get_edges(node, true);
 }
 
-vector<Node_Id> Graph_V2::get_incoming_edges(Node_Id node) {
-    return get_edges(node, false, &Graph_V2::get_incoming_edges_raw,
-            &Graph_V2::get_outgoing_edges_raw);
+vector<Node_Id> Graph_V2::get_incoming_edges(Node_Id node) const {
+    return get_edges(node, false);
 }
 
-size_t Graph_V2::get_node_count() {
+size_t Graph_V2::get_node_count() const {
     return group_index[group_index_length - 1];
 }
 
+size_t Graph_V2::get_group_count() const {
+    return group_index_length - 1;
+}
+
 /*
  * Old version that uses linear search.
  *
@@ -80,7 +190,7 @@ Group_Idx Graph_V2::get_group_index(Node_Id node) {
 */
 
 // XXX Assumes that 0 is in the array.
-size_t bin_search(Node_Id a[], size_t length, Node_Id x) {
+size_t bin_search(const Node_Id a[], size_t length, Node_Id x) {
     size_t lo = 0;
     size_t hi = length - 1;
     while (lo <= hi) {
@@ -99,24 +209,28 @@ size_t bin_search(Node_Id a[], size_t length, Node_Id x) {
     return hi;
 }
 
-Graph_V2::Group_Idx Graph_V2::get_group_index(Node_Id node) {
+Graph_V2::Group_Idx Graph_V2::get_group_index(Node_Id node) const {
+    // an edge decoded from a damaged list can point past the last node
+    if (node >= group_index[group_index_length - 1]) {
+        corrupt("node " + to_string(node) + " out of range");
+    }
     return (Group_Idx) bin_search(group_index, group_index_length - 1, node);
 }
 
-size_t Graph_V2::get_group_size(Group_Idx idx) {
+size_t Graph_V2::get_group_size(Group_Idx idx) const {
     return group_index[idx + 1] - group_index[idx]; 
 }
 
-Node_Id Graph_V2::get_group_id(Group_Idx idx) {
+Node_Id Graph_V2::get_group_id(Group_Idx idx) const {
     return group_index[idx];
 }
 
-size_t Graph_V2::get_group_pos(Group_Idx idx) {
+size_t Graph_V2::get_group_pos(Group_Idx idx) const {
     return idx2pos[idx] + base_pos;
 }
 
 vector<Node_Id> Graph_V2::read_edges_raw(Group_Idx idx, size_t pos,
-        info_t info) {
+        info_t info) const {
     size_t degree;
     pos += data.get_bits<size_t>(degree, info.nbits_degree, pos);
     if (!degree) {
@@ -125,49 +239,75 @@ vector<Node_Id> Graph_V2::read_edges_raw(Group_Idx idx, size_t pos,
     Node_Id base_node = get_group_id(idx);
     size_t first;
     pos += data.get_bits<size_t>(first, info.nbits_delta + 1, pos);
-    vector<Node_Id> edges;
     if (first % 2) {
         first = base_node - (first - 1) / 2;
     } else {
         first = base_node + first / 2;
     }
-    edges.push_back(first);
-    for (size_t i = 1; i < degree; ++i) {
-        size_t delta;
-        pos += data.get_bits<size_t>(delta, info.nbits_delta, pos);
-        edges.push_back(edges.back() + delta);
-    }
+    vector<Node_Id> edges(degree);
+    edges[0] = first;
+    // read in bulk, past the BitSet
+    add_count(decode_counters().bits_read, (degree - 1) * info.nbits_delta);
+    unpack_prefix_sum(data.data(), pos, info.nbits_delta, degree - 1, first,
+            edges.data() + 1);
     return edges;
 }
 
-vector<Node_Id> Graph_V2::get_outgoing_edges_raw(Group_Idx idx) {
+vector<Node_Id> Graph_V2::get_outgoing_edges_raw(Group_Idx idx) const {
+    add_count(decode_counters().groups_decoded);
     size_t pos = get_group_pos(idx);
     info_t info = fwd_info[get_group_size(idx) > 1];
     return read_edges_raw(idx, pos, info);
 }
 
-vector<Node_Id> Graph_V2::get_incoming_edges_raw(Group_Idx idx) {
-    size_t pos = get_group_pos(idx);
-    bool is_collapsed = get_group_size(idx) > 1;
-    info_t info = fwd_info[is_collapsed];
+size_t Graph_V2::skip_edges_raw(size_t pos, info_t info) const {
     size_t degree;
     pos += data.get_bits<size_t>(degree, info.nbits_degree, pos);
     if (degree) {
         pos += info.nbits_delta + 1;
         pos += (degree - 1) * info.nbits_delta;
     }
+    return pos;
+}
+
+vector<Node_Id> Graph_V2::get_incoming_edges_raw(Group_Idx idx) const {
+    add_count(decode_counters().groups_decoded);
+    bool is_collapsed = get_group_size(idx) > 1;
+    size_t pos = skip_edges_raw(get_group_pos(idx), fwd_info[is_collapsed]);
     return read_edges_raw(idx, pos, back_info[is_collapsed]);
 }
 
-vector<Node_Id> Graph_V2::get_edges(Node_Id node, bool is_fwd,
-        vector<Node_Id> (Graph_V2::*get_source_edges)(Group_Idx),
-        vector<Node_Id> (Graph_V2::*get_dest_edges)(Group_Idx)) {
+vector<Node_Id> Graph_V2::get_raw_edges_between(Group_Idx idx, bool is_fwd,
+        Node_Id lo, Node_Id hi) const {
+    vector<Node_Id> edges = is_fwd ? get_outgoing_edges_raw(idx) :
+        get_incoming_edges_raw(idx);
+    auto first = lower_bound(edges.begin(), edges.end(), lo);
+    auto last = lower_bound(first, edges.end(), hi);
+    edges.erase(last, edges.end());
+    edges.erase(edges.begin(), first);
+    return edges;
+}
+
+// Each raw edge of a collapsed group is matched by an edge back into the
+// group in the other end's reciprocal list; a list with none, or more than
+// are left, can only come from a damaged file, and would otherwise leave the
+// matching loop spinning or reading past the raw edges.
+static void check_reciprocal(size_t matched, size_t left) {
+    if (!matched || matched > left) {
+        Graph_V2::corrupt("reciprocal lists do not match");
+    }
+}
+
+vector<Node_Id> Graph_V2::get_edges(Node_Id node, bool is_fwd) const {
+    PERF_SCOPE(PERF_GET_EDGES);
     Group_Idx group_idx = get_group_index(node);
     size_t sz = get_group_size(group_idx);
-    vector<Node_Id> raw_edges = (this->*get_source_edges)(group_idx);
+    vector<Node_Id> raw_edges = is_fwd ? get_outgoing_edges_raw(group_idx) :
+        get_incoming_edges_raw(group_idx);
     if (sz < 2) {
         return raw_edges;
     }
+    add_count(decode_counters().collapsed_expansions);
 
     vector<Node_Id> edges;
     Node_Id my_lo = get_group_id(group_idx);
@@ -183,15 +323,10 @@ vector<Node_Id> Graph_V2::get_edges(Node_Id node, bool is_fwd,
     size_t len = raw_edges.size();
     while (my_idx < len) {
         Group_Idx other_grp_idx = get_group_index(raw_edges[my_idx]);
-        vector<Node_Id> other_edges = (this->*get_dest_edges)(other_grp_idx);
-    
+        vector<Node_Id> other_edges = get_raw_edges_between(other_grp_idx,
+                !is_fwd, my_lo, my_hi);
+        check_reciprocal(other_edges.size(), len - my_idx);
         for (Node_Id n : other_edges) {
-            if (n < my_lo) {
-                continue;
-            }
-            if (n >= my_hi) {
-                break;
-            }
             if (n == node) {
                 edges.push_back(raw_edges[my_idx]);
             }
@@ -202,6 +337,142 @@ vector<Node_Id> Graph_V2::get_edges(Node_Id node, bool is_fwd,
     return edges;
 }
 
+// Edges of every node in a group at once: the same matching as get_edges,
+// but each of the group's raw edges is attributed to its node in one pass.
+void Graph_V2::expand_group(Group_Idx idx, bool is_fwd,
+        vector<vector<Node_Id>>& lists) const {
+    size_t sz = get_group_size(idx);
+    Node_Id my_lo = get_group_id(idx);
+    Node_Id my_hi = my_lo + sz;
+    vector<Node_Id> raw_edges = is_fwd ? get_outgoing_edges_raw(idx) :
+        get_incoming_edges_raw(idx);
+    lists.resize(sz);
+    if (sz < 2) {
+        lists[0].swap(raw_edges);
+        return;
+    }
+
+    for (Node_Id node = my_lo; node < my_hi; ++node) {
+        lists[node - my_lo].clear();
+        if (is_fwd && node > my_lo) {
+            lists[node - my_lo].push_back(node - 1);
+        } else if (!is_fwd && node + 1 < my_hi) {
+            lists[node - my_lo].push_back(node + 1);
+        }
+    }
+
+    size_t my_idx = 0;
+    size_t len = raw_edges.size();
+    while (my_idx < len) {
+        Group_Idx other_grp_idx = get_group_index(raw_edges[my_idx]);
+        vector<Node_Id> other_edges = get_raw_edges_between(other_grp_idx,
+                !is_fwd, my_lo, my_hi);
+        check_reciprocal(other_edges.size(), len - my_idx);
+        for (Node_Id n : other_edges) {
+            lists[n - my_lo].push_back(raw_edges[my_idx]);
+            ++my_idx;
+        }
+    }
+}
+
+CsrGraph* Graph_V2::materialize_csr(size_t nthreads) const {
+    auto start = std::chrono::steady_clock::now();
+    if (!nthreads) {
+        nthreads = max(1u, std::thread::hardware_concurrency());
+    }
+    size_t num_groups = get_group_count();
+    size_t num_nodes = get_node_count();
+
+    // Groups are decoded a chunk at a time, each chunk into its own arrays,
+    // which are then copied into place.
+    struct Chunk {
+        Group_Idx lo, hi;
+        Csr fwd, back;
+    };
+    size_t num_chunks = min(num_groups, nthreads * 8);
+    vector<Chunk> chunks(num_chunks);
+    for (size_t i = 0; i < num_chunks; ++i) {
+        chunks[i].lo = (Group_Idx) (num_groups * i / num_chunks);
+        chunks[i].hi = (Group_Idx) (num_groups * (i + 1) / num_chunks);
+    }
+
+    std::atomic<size_t> next_chunk(0);
+    // the first corruption found by any thread, rethrown after the join
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto decode_chunks = [&] {
+        vector<vector<Node_Id>> lists;
+        for (size_t i; (i = next_chunk++) < num_chunks; ) {
+            Chunk& chunk = chunks[i];
+            for (int is_fwd = 1; is_fwd >= 0; --is_fwd) {
+                Csr& csr = is_fwd ? chunk.fwd : chunk.back;
+                for (Group_Idx idx = chunk.lo; idx < chunk.hi; ++idx) {
+                    expand_group(idx, is_fwd, lists);
+                    for (auto& list : lists) {
+                        csr.offsets.push_back(list.size());
+                        csr.targets.insert(csr.targets.end(), list.begin(),
+                                list.end());
+                    }
+                }
+            }
+        }
+    };
+    auto decode = [&] {
+        try {
+            decode_chunks();
+        } catch (...) {
+            lock_guard<mutex> lock(error_mutex);
+            if (!error) {
+                error = current_exception();
+            }
+        }
+    };
+    vector<std::thread> threads;
+    for (size_t t = 1; t < nthreads; ++t) {
+        threads.push_back(std::thread(decode));
+    }
+    decode();
+    for (auto& t : threads) {
+        t.join();
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+
+    Csr fwd, back;
+    for (int is_fwd = 1; is_fwd >= 0; --is_fwd) {
+        Csr& csr = is_fwd ? fwd : back;
+        csr.offsets.resize(num_nodes + 1);
+        size_t node = 0, edge = 0;
+        for (auto& chunk : chunks) {
+            Csr& part = is_fwd ? chunk.fwd : chunk.back;
+            for (size_t degree : part.offsets) {
+                csr.offsets[node++] = edge;
+                edge += degree;
+            }
+        }
+        assert(node == num_nodes);
+        csr.offsets[node] = edge;
+        csr.targets.resize(edge);
+        node = 0;
+        for (auto& chunk : chunks) {
+            Csr& part = is_fwd ? chunk.fwd : chunk.back;
+            copy(part.targets.begin(), part.targets.end(),
+                    csr.targets.begin() + csr.offsets[node]);
+            node += part.offsets.size();
+            vector<size_t>().swap(part.offsets);
+            vector<Node_Id>().swap(part.targets);
+        }
+    }
+
+    Csr_Stats stats;
+    stats.edges = fwd.targets.size();
+    stats.threads = nthreads;
+    stats.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    return new CsrGraph(this, fwd, back, stats);
+}
+
 Node_Id construct_edge_id(Node_Id src, Node_Id dest, int node_count) {
     size_t bits = nbits_for_int(node_count);
     return (dest << bits) + src + node_count;
@@ -239,7 +510,7 @@ vector<tuple<Node_Id, Node_Id>> match_edges(vector<Node_Id>::iterator& it,
 }
 
 map<string, vector<Node_Id>> Graph_V2::friends_of(Node_Id pathname, Node_Id task,
-        Metadata* metadata) {
+        const Metadata* metadata) const {
     string path = metadata->get_identifier(pathname);
     vector<Node_Id> pathname_edges = get_incoming_edges(pathname);
     assert(pathname_edges.size() == 1); 
@@ -1,51 +1,116 @@
 #ifndef GRAPH_V2_HH
 #define GRAPH_V2_HH
 
+#include "csr_graph.hh"
 #include "graph.hh"
 #include "helpers.hh"
+#include "unpack.hh"
 
 #if BESAFE
 #include <boost/serialization/strong_typedef.hpp>
 #endif
 
+// Graph files in a format other than the original start with this byte and
+// then a Graph_Codec; the original format starts with a bit width, which is
+// never this large.
+const unsigned char GRAPH_FORMAT_TAG = 0xFF;
+
+enum Graph_Codec {
+    CODEC_FIXED_WIDTH = 0,
+    CODEC_ELIAS_FANO = 'E',
+    CODEC_BLOCK_WIDTHS = 'B',
+    CODEC_REFERENCE = 'R',
+    CODEC_PAGED = 'P',
+};
+
+/*
+ * Nodes are stored in groups of consecutive ids, where each node but the
+ * first is a new version of the one before. Each group has one forward and
+ * one backward list of raw edges, merged over its nodes; how those lists
+ * are encoded is up to the codec. Graph_V2 itself reads the original
+ * format, with fixed widths from the header.
+ */
 class Graph_V2 : public Graph {
+    friend class Graph_V2_Writer;
+
     public:
-        Graph_V2(std::string&);
-        ~Graph_V2();
-        std::vector<Node_Id> get_outgoing_edges(Node_Id) override;
-        std::vector<Node_Id> get_incoming_edges(Node_Id) override;
+        Graph_V2(BitSet);
+        virtual ~Graph_V2();
+        std::vector<Node_Id> get_outgoing_edges(Node_Id) const override;
+        std::vector<Node_Id> get_incoming_edges(Node_Id) const override;
         std::map<std::string, std::vector<Node_Id>> friends_of(Node_Id, Node_Id,
-                Metadata*) override;
-        size_t get_node_count() override;
-    private:
+                const Metadata*) const override;
+        size_t get_node_count() const override;
+        // Decodes every group into forward and reverse CSR arrays, using
+        // nthreads threads (all cores if zero). This graph must outlive the
+        // result.
+        CsrGraph* materialize_csr(size_t nthreads = 0) const;
+        virtual const char* codec_name() const { return "fixed-width"; }
+        // Throws the runtime_error a damaged file is refused with
+        static void corrupt(const std::string& why);
+
+    protected:
 #if BESAFE
         BOOST_STRONG_TYPEDEF(size_t, Group_Idx)
 #else
         typedef size_t Group_Idx;
 #endif
-        struct info_t {
-            size_t nbits_degree;
-            size_t nbits_delta;
-        };
+        // For tagged formats: checks the tag and codec, and reads the group
+        // index that follows them. A codec with more header fields reads
+        // them from header_end and moves base_pos past them. A codec that
+        // indexes its groups itself passes has_group_index = false and
+        // overrides the group accessors.
+        Graph_V2(BitSet, Graph_Codec, bool has_group_index = true);
+
         BitSet data;
         Node_Id* group_index;
         size_t group_index_length;
+        size_t header_end;
         size_t base_pos;
         size_t* idx2pos;
-        map<bool, info_t> fwd_info;
-        map<bool, info_t> back_info;
-
-        Group_Idx get_group_index(Node_Id);
-        size_t get_group_size(Group_Idx);
-        Node_Id get_group_id(Group_Idx);
-        size_t get_group_pos(Group_Idx);
-
-        std::vector<Node_Id> read_edges_raw(Group_Idx, size_t, info_t);
-        std::vector<Node_Id> get_outgoing_edges_raw(Group_Idx);
-        std::vector<Node_Id> get_incoming_edges_raw(Group_Idx);
-        std::vector<Node_Id> get_edges(Node_Id, bool,
-                std::vector<Node_Id> (Graph_V2::*)(Group_Idx),
-                std::vector<Node_Id> (Graph_V2::*)(Group_Idx));
+
+        virtual size_t get_group_count() const;
+        virtual Group_Idx get_group_index(Node_Id) const;
+        virtual size_t get_group_size(Group_Idx) const;
+        virtual Node_Id get_group_id(Group_Idx) const;
+        virtual size_t get_group_pos(Group_Idx) const;
+
+        virtual std::vector<Node_Id> get_outgoing_edges_raw(Group_Idx) const;
+        virtual std::vector<Node_Id> get_incoming_edges_raw(Group_Idx) const;
+        // The raw edges of a group that fall in [lo, hi)
+        virtual std::vector<Node_Id> get_raw_edges_between(Group_Idx,
+                bool is_fwd, Node_Id lo, Node_Id hi) const;
+
+        // Widths of a list of degree and deltas
+        struct info_t {
+            size_t nbits_degree;
+            size_t nbits_delta;
+        };
+        std::vector<Node_Id> read_edges_raw(Group_Idx, size_t, info_t) const;
+        // Position just past a list read with these widths
+        size_t skip_edges_raw(size_t, info_t) const;
+
+        // indexed by whether the group is collapsed
+        info_t fwd_info[2];
+        info_t back_info[2];
+        // Reads fwd_info and back_info, 8 bits each, from pos
+        void read_list_widths(size_t& pos);
+
+        // Position just past a group's backward list, which a codec may
+        // return early once it is past the end of the file
+        virtual size_t lists_end(Group_Idx) const;
+        // Throws if the lists run past the end of the file; every
+        // constructor calls it once the header is read
+        void check_lists_end() const;
+        // get_gamma for load-time checks: throws if the code runs past the
+        // end of the file
+        size_t checked_gamma(uint64_t& val, size_t pos) const;
+
+    private:
+        void read_group_index(size_t nbits_size_entry, size_t& pos);
+        void expand_group(Group_Idx, bool,
+                std::vector<std::vector<Node_Id>>&) const;
+        std::vector<Node_Id> get_edges(Node_Id, bool) const;
 };
 
 #endif
@@ -0,0 +1,166 @@
+#include "graph_v2_writer.hh"
+
+using namespace std;
+
+// As util.nbits_for_int, whose floating-point rounding the widths in the
+// header depend on
+static size_t nbits_for(uint64_t i) {
+    return floor(log((double) max(i, (uint64_t) 1)) / log(2)) + 1;
+}
+
+/*
+ * Appends integers of any width up to 64 bits to a byte string, most
+ * significant bit first.
+ */
+class Bit_Writer {
+    public:
+        Bit_Writer() : acc_(0), nacc_(0) {}
+
+        void write(uint64_t val, size_t width) {
+            if (width > 56) {
+                write(val >> 32, width - 32);
+                width = 32;
+                val &= 0xFFFFFFFF;
+            }
+            acc_ = (acc_ << width) | val;
+            nacc_ += width;
+            while (nacc_ >= 8) {
+                nacc_ -= 8;
+                bytes_.push_back((char) (acc_ >> nacc_));
+            }
+        }
+        size_t size() const { return bytes_.size() * 8 + nacc_; }
+        // The bytes written, the last one padded with zeros
+        string finish() {
+            if (nacc_) {
+                write(0, 8 - nacc_);
+            }
+            return bytes_;
+        }
+
+    private:
+        string bytes_;
+        uint64_t acc_;
+        size_t nacc_;
+};
+
+struct List_Widths {
+    size_t nbits_degree;
+    size_t nbits_delta;
+
+    List_Widths() : nbits_degree(1), nbits_delta(1) {}
+};
+
+static void widen(List_Widths& widths, const vector<Node_Id>& edges,
+        Node_Id id) {
+    if (edges.empty()) {
+        return;
+    }
+    widths.nbits_degree = max(widths.nbits_degree, nbits_for(edges.size()));
+    uint64_t max_delta = edges[0] < id ? id - edges[0] : edges[0] - id;
+    for (size_t i = 1; i < edges.size(); ++i) {
+        max_delta = max<uint64_t>(max_delta, edges[i] - edges[i - 1]);
+    }
+    widths.nbits_delta = max(widths.nbits_delta, nbits_for(max_delta));
+}
+
+// The first delta is from the group's first node, with its sign in the
+// lowest bit; the rest are from the edge before.
+static void write_edges(Bit_Writer& out, const vector<Node_Id>& edges,
+        Node_Id id, const List_Widths& widths) {
+    out.write(edges.size(), widths.nbits_degree);
+    if (edges.empty()) {
+        return;
+    }
+    uint64_t first = edges[0] < id ? (id - edges[0]) * 2 + 1 :
+        (edges[0] - id) * 2;
+    out.write(first, widths.nbits_delta + 1);
+    for (size_t i = 1; i < edges.size(); ++i) {
+        out.write(edges[i] - edges[i - 1], widths.nbits_delta);
+    }
+}
+
+Graph_V2_Writer::Graph_V2_Writer(const vector<size_t>& group_sizes)
+    : group_sizes_(group_sizes), fwd_(group_sizes.size()),
+      back_(group_sizes.size()) {
+    assert(!group_sizes_.empty());
+    Node_Id id = 0;
+    for (size_t size : group_sizes_) {
+        assert(size > 0);
+        group_ids_.push_back(id);
+        id += size;
+    }
+}
+
+Graph_V2_Writer Graph_V2_Writer::from_graph(const Graph_V2& graph) {
+    vector<size_t> sizes;
+    for (size_t i = 0; i < graph.get_group_count(); ++i) {
+        sizes.push_back(graph.get_group_size(i));
+    }
+    Graph_V2_Writer writer(sizes);
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        writer.set_lists(i, graph.get_outgoing_edges_raw(i),
+                graph.get_incoming_edges_raw(i));
+    }
+    return writer;
+}
+
+void Graph_V2_Writer::set_lists(size_t group, vector<Node_Id> fwd,
+        vector<Node_Id> back) {
+    sort(fwd.begin(), fwd.end());
+    sort(back.begin(), back.end());
+    fwd_[group].swap(fwd);
+    back_[group].swap(back);
+}
+
+string Graph_V2_Writer::write() const {
+    // indexed by whether the group is collapsed
+    List_Widths fwd_widths[2], back_widths[2];
+    for (size_t i = 0; i < group_sizes_.size(); ++i) {
+        bool c = group_sizes_[i] > 1;
+        widen(fwd_widths[c], fwd_[i], group_ids_[i]);
+        widen(back_widths[c], back_[i], group_ids_[i]);
+    }
+
+    Bit_Writer nodes;
+    // the bit length of each group's lists, shifted down one group
+    vector<size_t> index = {0};
+    for (size_t i = 0; i < group_sizes_.size(); ++i) {
+        bool c = group_sizes_[i] > 1;
+        size_t start = nodes.size();
+        write_edges(nodes, fwd_[i], group_ids_[i], fwd_widths[c]);
+        write_edges(nodes, back_[i], group_ids_[i], back_widths[c]);
+        index.push_back(nodes.size() - start);
+    }
+    index.pop_back();
+
+    size_t nbits_size_entry = nbits_for(*max_element(group_sizes_.begin(),
+                group_sizes_.end()));
+    size_t nbits_index_entry = nbits_for(*max_element(index.begin(),
+                index.end()));
+    Bit_Writer header;
+    for (List_Widths* widths : {fwd_widths, back_widths}) {
+        for (bool c : {true, false}) {
+            header.write(widths[c].nbits_degree, 8);
+            header.write(widths[c].nbits_delta, 8);
+        }
+    }
+    header.write(nbits_size_entry, 8);
+    header.write(nbits_index_entry, 8);
+    header.write(index.size(), 32);
+    for (size_t i = 0; i < index.size(); ++i) {
+        header.write(index[i], nbits_index_entry);
+        header.write(group_sizes_[i], nbits_size_entry);
+    }
+    return header.finish() + nodes.finish();
+}
+
+void Graph_V2_Writer::write_to_file(const string& path) const {
+    ofstream out(path, ios::binary);
+    string bytes = write();
+    out.write(bytes.data(), bytes.size());
+    if (!out) {
+        cerr << path << ": " << strerror(errno) << endl;
+        exit(1);
+    }
+}
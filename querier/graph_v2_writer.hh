@@ -0,0 +1,46 @@
+#ifndef GRAPH_V2_WRITER_HH
+#define GRAPH_V2_WRITER_HH
+
+#include "graph_v2.hh"
+
+/*
+ * Writes graphs in the original Graph_V2 format, as
+ * compression/compress_graph_v2.py does: given the same groups and lists,
+ * the bytes are the same as the Python encoder's.
+ *
+ * Groups hold consecutive node ids, from 0, in order. A group's forward
+ * list holds the nodes its nodes have edges to, and its backward list the
+ * nodes with edges to them (version edges within a group are implied, not
+ * listed). Lists are written sorted; repeated nodes are kept.
+ */
+class Graph_V2_Writer {
+    public:
+        Graph_V2_Writer(const std::vector<size_t>& group_sizes);
+        // The groups and lists of a compressed graph, in any codec
+        static Graph_V2_Writer from_graph(const Graph_V2&);
+
+        size_t get_group_count() const { return group_sizes_.size(); }
+        Node_Id get_group_id(size_t group) const { return group_ids_[group]; }
+        size_t get_group_size(size_t group) const {
+            return group_sizes_[group];
+        }
+        const std::vector<Node_Id>& get_fwd(size_t group) const {
+            return fwd_[group];
+        }
+        const std::vector<Node_Id>& get_back(size_t group) const {
+            return back_[group];
+        }
+        void set_lists(size_t group, std::vector<Node_Id> fwd,
+                std::vector<Node_Id> back);
+        // The whole file
+        std::string write() const;
+        void write_to_file(const std::string& path) const;
+
+    private:
+        std::vector<size_t> group_sizes_;
+        std::vector<Node_Id> group_ids_;
+        std::vector<std::vector<Node_Id>> fwd_;
+        std::vector<std::vector<Node_Id>> back_;
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "helpers.hh"
 
+#include <mutex>
+
 // This assumes that a digit will be found and the line ends in " Kb".
 int parse_stats_line(char* line){
     int i = strlen(line);
@@ -11,13 +13,14 @@ int parse_stats_line(char* line){
 }
 
 // value is in KB
-int virtualmem_usage() { 
+static int status_usage(const char* field) {
     FILE* file = fopen("/proc/self/status", "r");
     int result = -1;
     char line[128];
+    size_t len = strlen(field);
 
     while (fgets(line, 128, file) != NULL){
-        if (strncmp(line, "VmSize:", 7) == 0){
+        if (strncmp(line, field, len) == 0){
             result = parse_stats_line(line);
             break;
         }
@@ -26,6 +29,86 @@ int virtualmem_usage() {
     return result;
 }
 
+int virtualmem_usage() { 
+    return status_usage("VmSize:");
+}
+
+int resident_usage() {
+    return status_usage("VmRSS:");
+}
+
+int peak_resident_usage() {
+    return status_usage("VmHWM:");
+}
+
+bool reset_peak_resident_usage() {
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (!file) {
+        return false;
+    }
+    bool ok = fputs("5", file) >= 0;
+    return fclose(file) == 0 && ok;
+}
+
+__thread Decode_Counters thread_decode_counters;
+
+// The counters of every thread that has joined, and what threads that have
+// since exited counted
+static mutex decode_counters_mutex;
+static vector<Decode_Counters*> decode_counters_threads;
+static Decode_Stats retired_decode_stats;
+
+static void add_decode_counters(Decode_Stats& sum, const Decode_Counters& c) {
+    sum.bits_read += c.bits_read;
+    sum.groups_decoded += c.groups_decoded;
+    sum.collapsed_expansions += c.collapsed_expansions;
+    sum.metadata_records += c.metadata_records;
+    sum.relative_records += c.relative_records;
+    sum.max_relative_depth = max<size_t>(sum.max_relative_depth,
+            c.max_relative_depth);
+}
+
+// Leaves the sum when its thread exits
+struct Decode_Counters_Exit {
+    ~Decode_Counters_Exit() {
+        lock_guard<mutex> lock(decode_counters_mutex);
+        add_decode_counters(retired_decode_stats, thread_decode_counters);
+        auto& threads = decode_counters_threads;
+        threads.erase(find(threads.begin(), threads.end(),
+                    &thread_decode_counters));
+    }
+};
+
+void register_decode_counters() {
+    static thread_local Decode_Counters_Exit on_exit;
+    (void) on_exit;
+    lock_guard<mutex> lock(decode_counters_mutex);
+    decode_counters_threads.push_back(&thread_decode_counters);
+    thread_decode_counters.registered = true;
+}
+
+Decode_Stats decoding_totals() {
+    lock_guard<mutex> lock(decode_counters_mutex);
+    Decode_Stats sum = retired_decode_stats;
+    for (auto c : decode_counters_threads) {
+        add_decode_counters(sum, *c);
+    }
+    return sum;
+}
+
+void reset_decoding_totals() {
+    lock_guard<mutex> lock(decode_counters_mutex);
+    retired_decode_stats = Decode_Stats();
+    for (auto c : decode_counters_threads) {
+        c->bits_read = 0;
+        c->groups_decoded = 0;
+        c->collapsed_expansions = 0;
+        c->metadata_records = 0;
+        c->relative_records = 0;
+        c->max_relative_depth = 0;
+    }
+}
+
 void print_str_vector(vector<string> v) {
     for (auto i = v.begin(); i != v.end(); ++i) {
         cout << *i << endl;
@@ -49,6 +132,30 @@ bool str_to_int(string s, int& i, int val_type_base) {
     }
 }
 
+// Days-from-civil conversion, so that dates are read as UTC regardless of
+// the local time zone.
+time_t civil_to_time(int year, int month, int day, int hour, int minute,
+        int sec) {
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yoe = year - era * 400;
+    int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    time_t days = (time_t)era * 146097 + doe - 719468;
+    return ((days * 24 + hour) * 60 + minute) * 60 + sec;
+}
+
+// cf:date values look like "2016:11:30T00:11:48".
+bool parse_cf_date(const string& date, time_t& t) {
+    int year, month, day, hour, minute, sec;
+    if (sscanf(date.c_str(), "%d:%d:%dT%d:%d:%d", &year, &month, &day,
+                &hour, &minute, &sec) != 6) {
+        return false;
+    }
+    t = civil_to_time(year, month, day, hour, minute, sec);
+    return true;
+}
+
 void remove_char(string& str, char ch) {
     str.erase(remove(str.begin(), str.end(), ch), str.end());
 }
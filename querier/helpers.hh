@@ -13,6 +13,10 @@
 #include<cassert>
 #include<cmath>
 #include<bitset>
+#include<ctime>
+#include<limits>
+#include<cstdint>
+#include <atomic>
 #include <chrono> 
 
 #define NUM_REPS 1
@@ -24,6 +28,14 @@ using namespace std;
 
 typedef size_t Node_Id;
 
+// Dense codes for cf:type values, assigned when metadata is loaded so that
+// traversals can test node and edge types without decoding metadata.
+typedef unsigned char Type_Code;
+typedef bitset<256> Type_Set;
+
+// cf:date values are kept as seconds since the epoch (UTC).
+const time_t NO_TIME = numeric_limits<time_t>::min();
+
 // Dictionaries for identifiers
 extern map<string, int> id2intid;
 extern map<int, string> intid2id;
@@ -36,6 +48,12 @@ struct exec_stats {
 };
 int parse_stats_line(char* line);
 int virtualmem_usage();
+// Resident set size and its peak so far, in KB
+int resident_usage();
+int peak_resident_usage();
+// Starts the peak over from the current resident set size; false if the
+// kernel does not support it
+bool reset_peak_resident_usage();
 
 template<typename TimeT = std::chrono::nanoseconds>
 struct measure
@@ -57,6 +75,11 @@ struct measure
 size_t nbits_for_int(int i);
 bool str_to_int(string s, int& i, int val_type_base);
 
+/* DATE HELPERS */
+time_t civil_to_time(int year, int month, int day, int hour, int minute,
+        int sec);
+bool parse_cf_date(const string& date, time_t& t);
+
 /* STRING HELPERS */
 vector<string> split(string& str, char delim);
 vector<string> split(string& str, string& delim);
@@ -71,6 +94,10 @@ void print_dict(map<K, V>& dict);
 void print_str_vector(vector<string> v);
 template <typename K>
 void set_dict_entries(map<K, string>& dict, string str, int val_type_base);
+// Value stored under key, or a default value; unlike operator[], never
+// inserts, so it is safe on maps shared between threads.
+template <typename K, typename V>
+V dict_get(const map<K, V>& dict, const typename map<K, V>::key_type& key);
 
 template <typename K, typename V>
 void print_dict(map<K, V>& dict) {
@@ -79,6 +106,12 @@ void print_dict(map<K, V>& dict) {
     }
 }
 
+template <typename K, typename V>
+V dict_get(const map<K, V>& dict, const typename map<K, V>::key_type& key) {
+    auto it = dict.find(key);
+    return it == dict.end() ? V() : it->second;
+}
+
 template <typename K>
 void set_dict_entries(map<K, string>& dict, string str, int val_type_base) {
     remove_char(str, DICT_BEGIN);
@@ -96,6 +129,105 @@ void set_dict_entries(map<K, string>& dict, string str, int val_type_base) {
     }
 }
 
+/*
+ * Unsigned integers of a fixed bit width, packed back to back into 64-bit
+ * words. Used for metadata columns that are read far more often than the
+ * full metadata entries they come from.
+ */
+class PackedArray {
+public:
+    PackedArray() : width_(0), length_(0) {}
+    PackedArray(size_t width, size_t length)
+        : width_(width), length_(length), words_((width * length >> 6) + 2) {
+        assert(width < 64);
+    }
+
+    size_t size() const { return length_; }
+    size_t width() const { return width_; }
+
+    void set(size_t i, uint64_t val) {
+        assert(i < length_ && (val >> width_) == 0);
+        size_t bit = i * width_;
+        size_t word = bit >> 6, offset = bit & 63;
+        words_[word] |= val << offset;
+        if (offset + width_ > 64) {
+            words_[word + 1] |= val >> (64 - offset);
+        }
+    }
+
+    uint64_t get(size_t i) const {
+        assert(i < length_);
+        size_t bit = i * width_;
+        size_t word = bit >> 6, offset = bit & 63;
+        uint64_t val = words_[word] >> offset;
+        if (offset + width_ > 64) {
+            val |= words_[word + 1] << (64 - offset);
+        }
+        return val & ((1ULL << width_) - 1);
+    }
+
+private:
+    size_t width_;
+    size_t length_;
+    vector<uint64_t> words_;
+};
+
+/*
+ * How much decoding has been done: bits read from BitSets, graph groups
+ * decoded, collapsed groups expanded into per-node lists, and metadata
+ * records decoded, with how many of those were the relatives other records
+ * were encoded against and the longest chain of them.
+ *
+ * Each thread counts into its own counters, through decode_counters() and
+ * add_count(), so the decoders pay an add each; decoding_totals() sums
+ * them over threads on demand. A thread joins the sum when it first
+ * decodes, and what it counted is kept when it exits. The sum is exact
+ * while no thread is decoding.
+ */
+struct Decode_Stats {
+    size_t bits_read;
+    size_t groups_decoded;
+    size_t collapsed_expansions;
+    size_t metadata_records;
+    size_t relative_records;
+    size_t max_relative_depth;
+};
+
+// One thread's counts. Other threads read them while it decodes, hence
+// the atomics.
+struct Decode_Counters {
+    std::atomic<size_t> bits_read;
+    std::atomic<size_t> groups_decoded;
+    std::atomic<size_t> collapsed_expansions;
+    std::atomic<size_t> metadata_records;
+    std::atomic<size_t> relative_records;
+    std::atomic<size_t> max_relative_depth;
+    // records being decoded on this thread now, nested by relatives; only
+    // this thread reads it
+    size_t metadata_depth;
+    bool registered;
+};
+
+extern __thread Decode_Counters thread_decode_counters;
+void register_decode_counters();
+
+// This thread's counters, which join the sum if they have not yet
+inline Decode_Counters& decode_counters() {
+    if (__builtin_expect(!thread_decode_counters.registered, 0)) {
+        register_decode_counters();
+    }
+    return thread_decode_counters;
+}
+
+// Only the owning thread adds, so a relaxed load and store is enough
+inline void add_count(std::atomic<size_t>& c, size_t n = 1) {
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// Summed over all threads, and zeroed; reset while no thread is decoding
+Decode_Stats decoding_totals();
+void reset_decoding_totals();
+
 /*
  * Given a string (std::string), returns an object that allows one to index
  * into arbitrary bit locations of the string and read x number of bits
@@ -105,50 +237,118 @@ class BitSet {
     static const int mask = (1<<3) - 1;
 
 public:
-    // constructor
-    BitSet(string& s) {
-        for (unsigned i = 0; i < s.length(); ++i) {
-            bitsets_.push_back(bitset<8>(s[i]));
-        }
+    // Bytes past the end that a read may touch
+    static const size_t PADDING = 16;
+
+    // Copies s
+    BitSet(const string& s) : bytes_(s.begin(), s.end()), size_(s.length()) {
+        bytes_.resize(s.length() + PADDING, 0);
+        data_ = bytes_.data();
     }
+    // Reads length bytes at data in place, without copying them. They must
+    // outlive the BitSet and be followed by PADDING readable bytes.
+    BitSet(const char* data, size_t length)
+        : data_(reinterpret_cast<const unsigned char*>(data)),
+          size_(length) {}
+    BitSet(const BitSet& bs) : bytes_(bs.bytes_),
+        data_(bs.owns_bytes() ? bytes_.data() : bs.data_), size_(bs.size_) {}
+    BitSet(BitSet&& bs) : bytes_(std::move(bs.bytes_)), data_(bs.data_),
+        size_(bs.size_) {}
+    BitSet& operator=(const BitSet&) = delete;
 
-    bool get_bit(size_t pos) {
+    bool get_bit(size_t pos) const {
+        add_count(decode_counters().bits_read);
         size_t char_pos = (pos >> 3);
         size_t offset = (pos & mask);
-        return bitsets_[char_pos][7-offset];
+        return (data_[char_pos] >> (7-offset)) & 1;
+    }
+
+    // Reads num_bits (at most 64) bits starting at pos, most significant
+    // bit first.
+    uint64_t read_bits(size_t num_bits, size_t pos) const {
+        add_count(decode_counters().bits_read, num_bits);
+        return peek_bits(num_bits, pos);
     }
 
     template <typename T>
-    size_t get_bits(T& val, size_t num_bits, size_t pos) {
+    size_t get_bits(T& val, size_t num_bits, size_t pos) const {
         assert(num_bits <= sizeof(T)*8);
+        val = (T) read_bits(num_bits, pos);
+        return num_bits;
+    }
 
-        val = 0;
-        for (size_t i = 0; i < num_bits; ++i) {
-            val |= get_bit(pos+i);
-            if (i != num_bits-1)
-                val <<= 1;
-        }
+    // Reads an Elias gamma code (zeros, one per bit after the leading one,
+    // then the value) starting at pos.
+    size_t get_gamma(uint64_t& val, size_t pos) const {
+        size_t length = peek_gamma(val, pos);
+        assert(length);
+        add_count(decode_counters().bits_read, length);
+        return length;
+    }
 
-        return num_bits;
+    // get_gamma without counting the bits read, for decoders that count a
+    // whole list's at once. Returns 0 if no code starts in the 64 bits at
+    // pos.
+    size_t peek_gamma(uint64_t& val, size_t pos) const {
+        // one load holds at least 57 bits from pos, enough for most codes
+        uint64_t word;
+        memcpy(&word, data_ + (pos >> 3), sizeof(word));
+        word = __builtin_bswap64(word) << (pos & mask);
+        size_t zeros = word ? __builtin_clzll(word) : 64;
+        if (2 * zeros + 1 <= 57) {
+            val = word >> (63 - 2 * zeros);
+            return 2 * zeros + 1;
+        }
+        word = peek_bits(64, pos);
+        if (!word) {
+            val = 0;
+            return 0;
+        }
+        zeros = __builtin_clzll(word);
+        val = peek_bits(zeros + 1, pos + zeros);
+        return 2 * zeros + 1;
     }
 
     // specialize for strings
-    void get_bits_as_str(string& str, size_t num_bits, size_t pos) {
+    void get_bits_as_str(string& str, size_t num_bits, size_t pos) const {
         assert((num_bits & mask) == 0); // must be a multiple of 8
 
         string s = "";
         for (size_t i = 0; i < (num_bits >> 3); ++i) {
-            bitset<8> b(0);
-            for (size_t j = 0; j < 1<<3; ++j) {
-                b[7-j] = get_bit(pos + (i << 3) + j);
-            }
-            s += static_cast<unsigned char>(b.to_ulong());
+            s += static_cast<unsigned char>(read_bits(8, pos + (i << 3)));
         }
         str = s;
     }
 
+    // The underlying bytes, followed by PADDING readable bytes
+    const unsigned char* data() const { return data_; }
+    // in bytes
+    size_t size() const { return size_; }
+
 private: 
-    std::vector<bitset<8>> bitsets_;
+    // empty if the bytes are someone else's
+    std::vector<unsigned char> bytes_;
+    const unsigned char* data_;
+    size_t size_;
+
+    bool owns_bytes() const { return data_ == bytes_.data(); }
+
+    // read_bits, without counting the bits as read
+    uint64_t peek_bits(size_t num_bits, size_t pos) const {
+        if (!num_bits) {
+            return 0;
+        }
+        const unsigned char* p = data_ + (pos >> 3);
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        word = __builtin_bswap64(word) << (pos & mask);
+        uint64_t val = word >> (64 - num_bits);
+        size_t avail = 64 - (pos & mask);
+        if (num_bits > avail) {
+            val |= p[8] >> (8 - (num_bits - avail));
+        }
+        return val;
+    }
 };
 
 #endif /*HELPERS_H*/
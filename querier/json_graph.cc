@@ -2,6 +2,19 @@
 #include "json/json.h"
 
 JsonGraph::JsonGraph(string& infile) {
+    vector<string> lines;
+    ifstream input(infile);
+    for (string line; getline(input, line);) {
+        lines.push_back(line);
+    }
+    read_lines(lines);
+}
+
+JsonGraph::JsonGraph(const vector<string>& lines) {
+    read_lines(lines);
+}
+
+void JsonGraph::read_lines(const vector<string>& lines) {
     Json::Reader reader;
     Json::FastWriter fastWriter;
     Json::Value root;
@@ -9,8 +22,7 @@ JsonGraph::JsonGraph(string& infile) {
     size_t pos;
     size_t ctr = 0;
 
-    ifstream input(infile);
-    for (string line; getline(input, line);) {
+    for (auto& line : lines) {
         string json;
         if ((pos = line.find(DICT_BEGIN)) == string::npos) {
             continue;
@@ -21,7 +33,7 @@ JsonGraph::JsonGraph(string& infile) {
             // report to the user the failure and their locations in the document.
             std::cout  << "Failed to parse configuration\n"
                        << reader.getFormattedErrorMessages();
-            return;
+            continue;
         }
         for (auto typ : typs) {
             if (typ == "prefix") {
@@ -50,29 +62,112 @@ JsonGraph::JsonGraph(string& infile) {
     construct_graph();
 }
 
-vector<Node_Id> JsonGraph::get_outgoing_edges(Node_Id node) {
-        return tgraph_[node];
+vector<Node_Id> JsonGraph::append(const JsonGraph& other) {
+    Node_Id next = nodeid2id.empty() ? 0 : nodeid2id.rbegin()->first + 1;
+    vector<Node_Id> ids(other.nodeid2id.empty() ? 0 :
+            other.nodeid2id.rbegin()->first + 1);
+    for (auto& entry : other.nodeid2id) {
+        auto it = id2nodeid.find(entry.second);
+        if (it == id2nodeid.end()) {
+            it = id2nodeid.insert(make_pair(entry.second, next++)).first;
+            nodeid2id[it->second] = entry.second;
+        }
+        ids[entry.first] = it->second;
+    }
+
+    for (auto& id : other.node_ids) {
+        if (!id2jsonstr.count(id)) {
+            node_ids.push_back(id);
+        }
+    }
+    for (auto& id : other.relation_ids) {
+        if (!id2jsonstr.count(id)) {
+            relation_ids.push_back(id);
+        }
+    }
+    id2jsonstr.insert(other.id2jsonstr.begin(), other.id2jsonstr.end());
+
+    for (auto& entry : other.graph_) {
+        auto& edges = graph_[ids[entry.first]];
+        for (Node_Id node : entry.second) {
+            edges.push_back(ids[node]);
+        }
+    }
+    for (auto& entry : other.tgraph_) {
+        auto& edges = tgraph_[ids[entry.first]];
+        for (Node_Id node : entry.second) {
+            edges.push_back(ids[node]);
+        }
+    }
+    // type codes are each graph's own
+    vector<Type_Code> types;
+    for (size_t code = 0; code < other.get_type_count(); ++code) {
+        types.push_back(intern_type(other.get_type_name(code)));
+    }
+    auto type_of = [&](Type_Code code) {
+        return code < types.size() ? types[code] : NO_TYPE;
+    };
+    for (auto& entry : other.node_types) {
+        node_types.insert(make_pair(ids[entry.first], type_of(entry.second)));
+    }
+    for (auto& entry : other.node_times) {
+        node_times.insert(make_pair(ids[entry.first], entry.second));
+    }
+    for (auto& entry : other.edge_types) {
+        edge_types.insert(make_pair(make_pair(ids[entry.first.first],
+                        ids[entry.first.second]), type_of(entry.second)));
+    }
+    for (auto& entry : other.edge_times) {
+        edge_times.insert(make_pair(make_pair(ids[entry.first.first],
+                        ids[entry.first.second]), entry.second));
+    }
+
+    for (auto& entry : other.pathname2file) {
+        pathname2file.insert(make_pair(ids[entry.first], entry.second));
+    }
+    for (auto& entry : other.file2pathname) {
+        file2pathname.insert(make_pair(entry.first, ids[entry.second]));
+    }
+    for (auto& file : other.file2tasks) {
+        for (auto& relation : file.second) {
+            file2tasks[file.first][relation.first].insert(
+                    relation.second.begin(), relation.second.end());
+        }
+    }
+    for (auto& task : other.task2files) {
+        for (auto& relation : task.second) {
+            task2files[task.first][relation.first].insert(
+                    relation.second.begin(), relation.second.end());
+        }
+    }
+    return ids;
 }
 
-vector<Node_Id> JsonGraph::get_incoming_edges(Node_Id node) {
-        return graph_[node];
+vector<Node_Id> JsonGraph::get_outgoing_edges(Node_Id node) const {
+        return dict_get(tgraph_, node);
 }
 
-size_t JsonGraph::get_node_count() {
+vector<Node_Id> JsonGraph::get_incoming_edges(Node_Id node) const {
+        return dict_get(graph_, node);
+}
+
+size_t JsonGraph::get_node_count() const {
         return graph_.size();
 }
 
 // Third parameter unused.
 map<string, vector<Node_Id>> JsonGraph::friends_of(Node_Id pathname, Node_Id task,
-        Metadata*) {
+        const Metadata*) const {
     map<string, vector<Node_Id>> friend_files;
 
-    File_Id file_id = pathname2file[pathname];
-    auto task_md = get_metadata(nodeid2id[task]);
+    File_Id file_id = dict_get(pathname2file, pathname);
+    string task_ident = dict_get(nodeid2id, task);
+    auto task_md = get_metadata(task_ident);
     Task_Id task_id = stol(task_md["cf:id"]);
     
     // get the tasks related to this file id
-    map<string, set<Task_Id>> relation_tasks = file2tasks[file_id];
+    map<string, set<Task_Id>> relation_tasks = dict_get(file2tasks, file_id);
+    map<string, set<File_Id>> task_relations = dict_get(task2files, task_id);
     for (auto pair : relation_tasks) {
         string relation = pair.first;
         set<Task_Id> task_ids = pair.second;
@@ -81,9 +176,10 @@ map<string, vector<Node_Id>> JsonGraph::friends_of(Node_Id pathname, Node_Id tas
         }
         // this file is related to the task!
         // get all other files related to the task in the same way as this file id
-        for (auto friend_file_id : task2files[task_id][relation]) {
+        for (auto friend_file_id : task_relations[relation]) {
             // we want to record the pathnames (not the file ids)
-            friend_files[relation].push_back(file2pathname[friend_file_id]);
+            friend_files[relation].push_back(
+                    dict_get(file2pathname, friend_file_id));
         }
     }
     /*
@@ -109,6 +205,9 @@ void JsonGraph::construct_graph() {
         tgraph_[ctr];
         assert(graph_.count(ctr));
         assert(tgraph_.count(ctr));
+        auto md = get_metadata(id);
+        node_types[ctr] = intern_type_of(md);
+        node_times[ctr] = time_of(md);
         nodeid2id[ctr] = id;
         id2nodeid[id] = ctr++;
     }
@@ -147,6 +246,10 @@ void JsonGraph::construct_graph() {
         }
         graph_[id2nodeid[head]].push_back(id2nodeid[tail]);
         tgraph_[id2nodeid[tail]].push_back(id2nodeid[head]);
+        edge_types[make_pair(id2nodeid[tail], id2nodeid[head])] =
+            intern_type_of(node_md);
+        edge_times[make_pair(id2nodeid[tail], id2nodeid[head])] =
+            time_of(node_md);
         nodeid2id[ctr] = id;
         id2nodeid[id] = ctr++;
 
@@ -198,17 +301,35 @@ void JsonGraph::construct_graph() {
 	}
 }
 
-map<string, string> JsonGraph::get_metadata(string& identifier) {
+Type_Code JsonGraph::intern_type_of(map<string, string>& md) {
+    auto typ = md.find("cf:type");
+    if (typ == md.end() || typ->second.empty()) {
+        return NO_TYPE;
+    }
+    return intern_type(typ->second);
+}
+
+time_t JsonGraph::time_of(map<string, string>& md) {
+    time_t t;
+    auto date = md.find("cf:date");
+    if (date == md.end() || !parse_cf_date(date->second, t)) {
+        return NO_TIME;
+    }
+    return t;
+}
+
+map<string, string> JsonGraph::get_metadata(string& identifier) const {
     map<string, string> m;
     Json::Reader reader;
     Json::FastWriter fastWriter;
     Json::Value root;
 
-    if(id2jsonstr.count(identifier) == 0) {
+    auto json = id2jsonstr.find(identifier);
+    if(json == id2jsonstr.end()) {
         return m;
     }
 
-    bool parsingSuccessful = reader.parse( id2jsonstr[identifier], root );
+    bool parsingSuccessful = reader.parse( json->second, root );
     if ( !parsingSuccessful ) {
         // report to the user the failure and their locations in the document.
         std::cout  << "Failed to parse configuration\n"
@@ -223,8 +344,31 @@ map<string, string> JsonGraph::get_metadata(string& identifier) {
     }
     return m;
 }
-Node_Id JsonGraph::get_node_id(string identifier) { return id2nodeid[identifier]; }
-string JsonGraph::get_identifier(Node_Id node) { return nodeid2id[node]; }
-vector<string> JsonGraph::get_node_ids() { return node_ids; }
+Node_Id JsonGraph::get_node_id(string identifier) const {
+    return dict_get(id2nodeid, identifier);
+}
+bool JsonGraph::has_identifier(const string& identifier) const {
+    return id2nodeid.count(identifier) > 0;
+}
+string JsonGraph::get_identifier(Node_Id node) const {
+    return dict_get(nodeid2id, node);
+}
+vector<string> JsonGraph::get_node_ids() const { return node_ids; }
+Type_Code JsonGraph::get_node_type(Node_Id node) const {
+    auto it = node_types.find(node);
+    return it == node_types.end() ? NO_TYPE : it->second;
+}
+Type_Code JsonGraph::get_edge_type(Node_Id src, Node_Id dest) const {
+    auto it = edge_types.find(make_pair(src, dest));
+    return it == edge_types.end() ? NO_TYPE : it->second;
+}
+time_t JsonGraph::get_node_time(Node_Id node) const {
+    auto it = node_times.find(node);
+    return it == node_times.end() ? NO_TIME : it->second;
+}
+time_t JsonGraph::get_edge_time(Node_Id src, Node_Id dest) const {
+    auto it = edge_times.find(make_pair(src, dest));
+    return it == edge_times.end() ? NO_TIME : it->second;
+}
 
 vector<string> JsonGraph::typs = {"prefix", "activity", "relation", "entity", "agent", "message", "used", "wasGeneratedBy", "wasInformedBy", "wasDerivedFrom","unknown"};
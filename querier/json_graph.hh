@@ -25,18 +25,38 @@ private:
     map<Path_Id, File_Id> pathname2file;
     map<File_Id, Path_Id> file2pathname;
 
+    map<Node_Id, Type_Code> node_types;
+    map<pair<Node_Id, Node_Id>, Type_Code> edge_types;
+    map<Node_Id, time_t> node_times;
+    map<pair<Node_Id, Node_Id>, time_t> edge_times;
+
+    void read_lines(const vector<string>& lines);
     void construct_graph();
+    Type_Code intern_type_of(map<string, string>& md);
+    static time_t time_of(map<string, string>& md);
 public:
     JsonGraph(string& infile);
-    map<string, string> get_metadata(string& identifier) override;
-    Node_Id get_node_id(string) override;
-    string get_identifier(Node_Id) override;
-    vector<string> get_node_ids() override;
+    // The records in the lines of a CamFlow log
+    JsonGraph(const vector<string>& lines);
+    // Adds the records of a later part of the same log without parsing
+    // them again. A record both hold keeps this one's metadata. Returns
+    // the other's node ids as ids of this.
+    vector<Node_Id> append(const JsonGraph& other);
+    map<string, string> get_metadata(string& identifier) const override;
+    Node_Id get_node_id(string) const override;
+    bool has_identifier(const string&) const override;
+    string get_identifier(Node_Id) const override;
+    vector<string> get_node_ids() const override;
+    Type_Code get_node_type(Node_Id) const override;
+    Type_Code get_edge_type(Node_Id src, Node_Id dest) const override;
+    time_t get_node_time(Node_Id) const override;
+    time_t get_edge_time(Node_Id src, Node_Id dest) const override;
     
-    map<string, vector<Node_Id>> friends_of(Node_Id, Node_Id, Metadata*) override;
-    std::vector<Node_Id> get_outgoing_edges(Node_Id) override;
-    std::vector<Node_Id> get_incoming_edges(Node_Id) override;
-    size_t get_node_count() override;
+    map<string, vector<Node_Id>> friends_of(Node_Id, Node_Id,
+            const Metadata*) const override;
+    std::vector<Node_Id> get_outgoing_edges(Node_Id) const override;
+    std::vector<Node_Id> get_incoming_edges(Node_Id) const override;
+    size_t get_node_count() const override;
 };
 
 #endif
@@ -0,0 +1,191 @@
+#include "live.hh"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+Live_Segment::Live_Segment(const vector<string>& lines)
+    : num_lines(lines.size()), json(lines) {
+    metadata = &json;
+    graph = &json;
+}
+
+// Parsing is what a batch costs, so merged segments take their records
+// from the segments rather than from the lines again; the older's nodes
+// keep their ids in the copy, and the newer's are numbered after them.
+Live_Segment::Live_Segment(const Live_Segment& older,
+        const Live_Segment& newer)
+    : num_lines(older.num_lines + newer.num_lines), json(older.json) {
+    metadata = &json;
+    graph = &json;
+    to_global = older.to_global;
+    to_local = older.to_local;
+    vector<Node_Id> ids = json.append(newer.json);
+    for (size_t local = 0; local < newer.to_global.size(); ++local) {
+        if (newer.to_global[local] != NO_NODE) {
+            add_node(ids[local], newer.to_global[local]);
+        }
+    }
+}
+
+Live_Base::Live_Base(string archivefile, size_t cache_bytes)
+    : CompressedQuerier(archivefile, cache_bytes) {}
+
+Live_Snapshot::Live_Snapshot(shared_ptr<const Live_Base> base,
+        const vector<shared_ptr<const Live_Segment>>& segments,
+        uint64_t epoch, size_t lines)
+    : base_(std::move(base)), segments_(segments), epoch_(epoch),
+      lines_(lines) {
+    metadata_ = base_->metadata();
+    graph_ = base_->graph();
+    if (segments_.empty()) {
+        return;
+    }
+    vector<const Segment*> views;
+    for (auto& segment : segments_) {
+        views.push_back(segment.get());
+    }
+    segmented_metadata_.reset(new Segmented_Metadata(metadata_, views));
+    segmented_graph_.reset(new Segmented_Graph(graph_, metadata_, views,
+                segmented_metadata_->num_nodes));
+    metadata_ = segmented_metadata_.get();
+    graph_ = segmented_graph_.get();
+}
+
+Live_Querier::Live_Querier(const string& archivefile, const string& logfile,
+        size_t cache_bytes)
+    : base_(make_shared<const Live_Base>(archivefile, cache_bytes)),
+      logfile_(logfile), fd_(-1), inode_(0), offset_(0), epoch_(0),
+      lines_(0), stopping_(false) {
+    current_ = make_shared<const Live_Snapshot>(base_, segments_, epoch_,
+            lines_);
+    ingest_thread_ = thread(&Live_Querier::ingest, this);
+}
+
+Live_Querier::~Live_Querier() {
+    stopping_ = true;
+    ingest_thread_.join();
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+shared_ptr<const Live_Snapshot> Live_Querier::snapshot() const {
+    return atomic_load(&current_);
+}
+
+Ingest_Stats Live_Querier::ingest_stats() const {
+    lock_guard<mutex> lock(stats_mutex_);
+    return stats_;
+}
+
+void Live_Querier::ingest() {
+    while (!stopping_) {
+        vector<string> lines;
+        auto start = chrono::steady_clock::now();
+        if (!read_lines(lines)) {
+            this_thread::sleep_for(chrono::milliseconds(POLL_MS));
+            continue;
+        }
+        publish(lines);
+        double lag = chrono::duration<double>(
+                chrono::steady_clock::now() - start).count();
+        lock_guard<mutex> lock(stats_mutex_);
+        stats_.last_lag = lag;
+        stats_.max_lag = max(stats_.max_lag, lag);
+    }
+}
+
+void Live_Querier::reopen() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    fd_ = open(logfile_.c_str(), O_RDONLY);
+    struct stat st;
+    inode_ = fd_ >= 0 && fstat(fd_, &st) == 0 ? st.st_ino : 0;
+    offset_ = 0;
+    partial_.clear();
+}
+
+// The complete lines written to the log since the last call, if any. A
+// line still being written is kept until it is finished.
+bool Live_Querier::read_lines(vector<string>& lines) {
+    if (fd_ < 0) {
+        reopen();
+        if (fd_ < 0) {
+            return false;
+        }
+    }
+    struct stat st;
+    if (fstat(fd_, &st) == 0 && st.st_size < offset_) {
+        offset_ = 0;
+        partial_.clear();
+    }
+    buffer_.resize(MAX_BATCH_BYTES);
+    ssize_t n = pread(fd_, buffer_.data(), buffer_.size(), offset_);
+    if (n <= 0) {
+        // the rest of a log that was replaced is read before the new one
+        struct stat path_st;
+        if (stat(logfile_.c_str(), &path_st) == 0 &&
+                path_st.st_ino != inode_) {
+            reopen();
+        }
+        return false;
+    }
+    offset_ += n;
+    {
+        lock_guard<mutex> lock(stats_mutex_);
+        stats_.bytes_behind = st.st_size > offset_ ? st.st_size - offset_ : 0;
+    }
+
+    partial_.append(buffer_.data(), n);
+    size_t start = 0;
+    for (size_t end; (end = partial_.find('\n', start)) != string::npos;
+            start = end + 1) {
+        lines.push_back(partial_.substr(start, end - start));
+    }
+    partial_.erase(0, start);
+    return !lines.empty();
+}
+
+shared_ptr<const Live_Segment> Live_Querier::make_segment(
+        const vector<string>& lines) {
+    auto segment = make_shared<Live_Segment>(lines);
+    const Metadata* base = base_->metadata();
+    for (auto& node : segment->json.graph_) {
+        string identifier = segment->json.get_identifier(node.first);
+        if (base->has_identifier(identifier)) {
+            segment->add_node(node.first, base->get_node_id(identifier));
+            continue;
+        }
+        auto it = new_ids_.find(identifier);
+        if (it == new_ids_.end()) {
+            it = new_ids_.insert(make_pair(identifier,
+                        base->num_nodes + new_ids_.size())).first;
+        }
+        segment->add_node(node.first, it->second);
+    }
+    return segment;
+}
+
+void Live_Querier::publish(const vector<string>& lines) {
+    lines_ += lines.size();
+    segments_.push_back(make_segment(lines));
+    size_t n;
+    while ((n = segments_.size()) > 1 &&
+            segments_[n - 2]->num_lines <= segments_[n - 1]->num_lines) {
+        auto merged = make_shared<const Live_Segment>(*segments_[n - 2],
+                *segments_[n - 1]);
+        segments_.resize(n - 2);
+        segments_.push_back(merged);
+    }
+    atomic_store(&current_, make_shared<const Live_Snapshot>(base_,
+                segments_, ++epoch_, lines_));
+
+    lock_guard<mutex> lock(stats_mutex_);
+    stats_.lines = lines_;
+    stats_.epochs = epoch_;
+    stats_.segments = segments_.size();
+}
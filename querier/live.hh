@@ -0,0 +1,132 @@
+#ifndef LIVE_HH
+#define LIVE_HH
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <sys/types.h>
+#include <thread>
+#include <unordered_map>
+
+#include "json_graph.hh"
+#include "queriers.hh"
+#include "segments.hh"
+
+/*
+ * Lines of a live log, parsed into memory.
+ */
+struct Live_Segment : public Segment {
+    // lines of the log it holds
+    size_t num_lines;
+    JsonGraph json;
+
+    Live_Segment(const std::vector<string>& lines);
+    // Two neighbouring segments as one, from the records they hold
+    Live_Segment(const Live_Segment& older, const Live_Segment& newer);
+};
+
+/*
+ * The compressed trace a live log is read over. The Live_Querier and each
+ * of its snapshots share it, so that it lasts as long as any of them.
+ */
+class Live_Base : public CompressedQuerier {
+public:
+    Live_Base(string archivefile, size_t cache_bytes);
+    const Metadata* metadata() const { return metadata_; }
+    const Graph* graph() const { return graph_; }
+};
+
+/*
+ * The trace as of one point in ingest: the base and the lines of the log
+ * read before that point. A snapshot never changes, and stays valid for as
+ * long as it is held however far ingest has moved on, even past the end of
+ * its Live_Querier, so every query run against one sees the same trace.
+ */
+class Live_Snapshot : public Querier {
+public:
+    Live_Snapshot(std::shared_ptr<const Live_Base> base,
+            const std::vector<std::shared_ptr<const Live_Segment>>& segments,
+            uint64_t epoch, size_t lines);
+    uint64_t epoch() const { return epoch_; }
+    // Lines of the log it holds
+    size_t lines() const { return lines_; }
+
+private:
+    std::shared_ptr<const Live_Base> base_;
+    std::vector<std::shared_ptr<const Live_Segment>> segments_;
+    std::unique_ptr<const Segmented_Metadata> segmented_metadata_;
+    std::unique_ptr<const Segmented_Graph> segmented_graph_;
+    uint64_t epoch_;
+    size_t lines_;
+};
+
+struct Ingest_Stats {
+    size_t lines;
+    uint64_t epochs;
+    size_t segments;
+    // bytes of the log not yet read, as of the last read
+    size_t bytes_behind;
+    // seconds from reading a batch of lines to publishing the snapshot
+    // that holds them, for the last batch and the slowest one
+    double last_lag;
+    double max_lag;
+
+    Ingest_Stats() : lines(0), epochs(0), segments(0), bytes_behind(0),
+        last_lag(0), max_lag(0) {}
+};
+
+/*
+ * Follows a CamFlow log as it is written, like tail -F: lines appended to
+ * it are parsed into memory, over a compressed base trace, and published
+ * in a new snapshot after each batch. If the log is replaced or truncated
+ * it is read again from the start of the new one.
+ *
+ * Queries go to a snapshot() rather than to this, and may run on any
+ * number of threads while ingest goes on. Each batch is a segment of its
+ * own until it is merged with its neighbours: the newest segment is merged
+ * into the one before it while that one holds no more lines, which keeps
+ * the number of segments logarithmic in the lines read. Nodes keep their
+ * ids across merges and snapshots.
+ */
+class Live_Querier {
+public:
+    Live_Querier(const string& archivefile, const string& logfile,
+            size_t cache_bytes = 0);
+    ~Live_Querier();
+    std::shared_ptr<const Live_Snapshot> snapshot() const;
+    Ingest_Stats ingest_stats() const;
+
+    // how long to wait for the log to grow before looking again
+    static const size_t POLL_MS = 10;
+    // most bytes read into one batch
+    static const size_t MAX_BATCH_BYTES = 4 << 20;
+
+private:
+    std::shared_ptr<const Live_Base> base_;
+    string logfile_;
+    int fd_;
+    ino_t inode_;
+    off_t offset_;
+    string partial_;
+    std::vector<char> buffer_;
+
+    std::vector<std::shared_ptr<const Live_Segment>> segments_;
+    std::unordered_map<string, Node_Id> new_ids_;
+    std::shared_ptr<const Live_Snapshot> current_;
+    uint64_t epoch_;
+    size_t lines_;
+
+    mutable std::mutex stats_mutex_;
+    Ingest_Stats stats_;
+    std::atomic<bool> stopping_;
+    std::thread ingest_thread_;
+
+    void ingest();
+    bool read_lines(std::vector<string>& lines);
+    void reopen();
+    std::shared_ptr<const Live_Segment> make_segment(
+            const std::vector<string>& lines);
+    void publish(const std::vector<string>& lines);
+};
+
+#endif
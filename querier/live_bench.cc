@@ -0,0 +1,199 @@
+#include <fcntl.h>
+#include <random>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "json/json.h"
+#include "live.hh"
+
+/*
+ * Measures a Live_Querier under load. A child process stands in for
+ * CamFlow, writing the lines of a log to a fresh file at a fixed rate (each
+ * in two pieces, so lines are caught half-written), while query threads
+ * run traversals against snapshots and the main thread times how long each
+ * new record takes to become visible after its line is written.
+ *
+ * Usage: ./live_bench archive log [--out=FILE] [--rate=LINES_PER_SEC]
+ *            [--threads=N]
+ */
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double percentile(vector<double> v, double p) {
+    if (v.empty()) {
+        return 0;
+    }
+    sort(v.begin(), v.end());
+    return v[min(v.size() - 1, (size_t) (p * v.size()))];
+}
+
+// An identifier defined or used by a line of the log, or "" if none
+static string identifier_of(const string& line) {
+    size_t pos = line.find(DICT_BEGIN);
+    Json::Value root;
+    Json::Reader reader;
+    if (pos == string::npos || !reader.parse(line.substr(pos), root)) {
+        return "";
+    }
+    for (auto& typ : root.getMemberNames()) {
+        if (typ != "prefix" && root[typ].isObject() && root[typ].size()) {
+            return root[typ].getMemberNames()[0];
+        }
+    }
+    return "";
+}
+
+// Writes lines to out at rate lines a second, recording when each is done
+static void write_log(const vector<string>& lines, const string& out,
+        double rate, volatile int64_t* written) {
+    int fd = open(out.c_str(), O_WRONLY | O_APPEND);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        string line = lines[i] + "\n";
+        size_t half = line.size() / 2;
+        if (write(fd, line.data(), half) < 0 ||
+                write(fd, line.data() + half, line.size() - half) < 0) {
+            _exit(1);
+        }
+        written[i] = now_ns();
+        usleep(1e6 / rate);
+    }
+    close(fd);
+}
+
+int main(int argc, char* argv[]) {
+    string out = "/tmp/live_audit.log";
+    double rate = 200;
+    size_t nthreads = 4;
+    vector<string> files;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.find("--out=") == 0) {
+            out = arg.substr(6);
+        } else if (arg.find("--rate=") == 0) {
+            rate = atof(arg.substr(7).c_str());
+        } else if (arg.find("--threads=") == 0) {
+            nthreads = atoi(arg.substr(10).c_str());
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.size() != 2 || rate <= 0) {
+        cerr << "Usage: ./live_bench archive log [--out=FILE] "
+            "[--rate=LINES_PER_SEC] [--threads=N]" << endl;
+        return 1;
+    }
+
+    vector<string> lines;
+    ifstream input(files[1]);
+    for (string line; getline(input, line);) {
+        lines.push_back(line);
+    }
+    ofstream(out, ios::trunc);
+
+    // filled in by the writer, which starts once the querier is up
+    auto written = static_cast<volatile int64_t*>(mmap(nullptr,
+                (lines.size() + 1) * sizeof(int64_t), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    int go[2];
+    if (written == MAP_FAILED || pipe(go) < 0) {
+        perror("live_bench");
+        return 1;
+    }
+    pid_t writer = fork();
+    if (writer == 0) {
+        char c;
+        close(go[1]);
+        if (read(go[0], &c, 1) == 1) {
+            write_log(lines, out, rate, written);
+        }
+        _exit(0);
+    }
+    close(go[0]);
+
+    Live_Querier live(files[0], out);
+    auto base = live.snapshot();
+    vector<string> ids = base->get_node_ids();
+    // the lines that bring in a record the base does not have
+    vector<size_t> fresh;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        string id = identifier_of(lines[i]);
+        if (!id.empty() && !base->has_node(id)) {
+            fresh.push_back(i);
+            ids.push_back(id);
+        }
+    }
+
+    std::atomic<bool> done(false);
+    vector<vector<double>> latencies(nthreads);
+    vector<std::thread> threads;
+    auto start = now_ns();
+    for (size_t t = 0; t < nthreads; ++t) {
+        threads.push_back(std::thread([&, t] {
+            std::mt19937_64 rng(t);
+            while (!done) {
+                auto snapshot = live.snapshot();
+                string id = ids[rng() % ids.size()];
+                if (!snapshot->has_node(id)) {
+                    continue;
+                }
+                int64_t begin = now_ns();
+                size_t n = rng() & 1 ? snapshot->get_all_ancestors(id).size()
+                    : snapshot->get_all_descendants(id).size();
+                latencies[t].push_back((now_ns() - begin) / 1e3);
+                (void) n;
+            }
+        }));
+    }
+    if (write(go[1], "x", 1) != 1) {
+        perror("live_bench");
+    }
+
+    vector<double> lags;
+    for (size_t i : fresh) {
+        string id = identifier_of(lines[i]);
+        bool visible;
+        while (!(visible = live.snapshot()->has_node(id)) &&
+                live.snapshot()->lines() < lines.size()) {
+            usleep(50);
+        }
+        if (!visible && !live.snapshot()->has_node(id)) {
+            continue;
+        }
+        int64_t seen = now_ns();
+        while (!written[i]) {
+            usleep(50);
+        }
+        lags.push_back(max<int64_t>(0, seen - written[i]) / 1e6);
+    }
+    waitpid(writer, nullptr, 0);
+    while (live.snapshot()->lines() < lines.size()) {
+        usleep(1000);
+    }
+    done = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    vector<double> all;
+    for (auto& l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    Ingest_Stats stats = live.ingest_stats();
+    printf("lines %zu epochs %llu segments %zu nodes %zu\n", stats.lines,
+            (unsigned long long) stats.epochs, stats.segments,
+            live.snapshot()->get_node_ids().size());
+    printf("ingest lag ms: p50 %.2f p99 %.2f max %.2f (records %zu, "
+            "batch max %.2f)\n", percentile(lags, 0.5),
+            percentile(lags, 0.99), percentile(lags, 1.0), lags.size(),
+            stats.max_lag * 1e3);
+    printf("queries %zu (%.0f/s, %zu threads) latency us: p50 %.1f p99 %.1f "
+            "max %.1f\n", all.size(), all.size() / seconds, nthreads,
+            percentile(all, 0.5), percentile(all, 0.99),
+            percentile(all, 1.0));
+    return 0;
+}
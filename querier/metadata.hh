@@ -1,19 +1,70 @@
 #ifndef META_H
 #define META_H
 
+#include <memory>
+
+#include "archive.hh"
 #include "helpers.hh"
 #include "graph.hh"
 
+/*
+ * Identifiers for a batch of nodes, stored back to back in one string.
+ */
+struct Identifier_Arena {
+    string data;
+    vector<size_t> offsets;
+
+    Identifier_Arena() : offsets({0}) {}
+    size_t size() const { return offsets.size() - 1; }
+    string get(size_t i) const {
+        return data.substr(offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    void clear() {
+        data.clear();
+        offsets.assign(1, 0);
+    }
+    void push_back(const string& identifier) {
+        data += identifier;
+        offsets.push_back(data.size());
+    }
+};
+
 class Metadata {
 public:
     static const set<string> RELATION_TYPS;
+    static const Type_Code NO_TYPE = 255;
     size_t num_nodes;
 
     vector<string> identifiers;
-    virtual map<string, string> get_metadata(string& identifier) = 0;
-    virtual Node_Id get_node_id(string) = 0;
-    virtual string get_identifier(Node_Id) = 0;
-    virtual vector<string> get_node_ids() = 0;
+    virtual ~Metadata() {}
+    virtual map<string, string> get_metadata(string& identifier) const = 0;
+    virtual Node_Id get_node_id(string) const = 0;
+    virtual bool has_identifier(const string&) const = 0;
+    virtual string get_identifier(Node_Id) const = 0;
+    virtual void get_identifiers(const Node_Id* nodes, size_t count,
+            Identifier_Arena& arena) const;
+    virtual vector<string> get_node_ids() const = 0;
+
+    // cf:type of a node, or of the edge from src to dest
+    virtual Type_Code get_node_type(Node_Id) const = 0;
+    virtual Type_Code get_edge_type(Node_Id src, Node_Id dest) const = 0;
+    // cf:date of a node, or of the edge from src to dest, or NO_TIME
+    virtual time_t get_node_time(Node_Id) const = 0;
+    virtual time_t get_edge_time(Node_Id src, Node_Id dest) const = 0;
+    // get_node_time of each node, with one virtual call for a whole list
+    virtual void get_node_times(const vector<Node_Id>& nodes,
+            vector<time_t>& times) const;
+    Type_Code get_type_code(const string& typ) const;
+    Type_Set get_type_set(const vector<string>& typs) const;
+    string get_type_name(Type_Code) const;
+    size_t get_type_count() const { return type_names.size(); }
+
+protected:
+    Type_Code intern_type(const string& typ);
+
+private:
+    map<string, Type_Code> type_codes;
+    vector<string> type_names;
 };
 
 class CompressedMetadata : public Metadata {
@@ -40,6 +91,8 @@ private:
     map<string, string>default_node_data;
     map<string, string>default_relation_data;
     vector<size_t>default_date;
+    unsigned char type_key;
+    unsigned char relative_key;
 
     size_t typ_bits;
     size_t key_bits;
@@ -52,21 +105,54 @@ private:
     map<Node_Id, string>nodeid2id;
     
     map<Node_Id, size_t>nodeid2dataindex;
-    BitSet* metadata_bs;
+    std::unique_ptr<BitSet> metadata_bs;
+
+    // cf:type codes, indexed by node id and by position in edge_ids
+    vector<Type_Code> node_types;
+    vector<Node_Id> edge_ids;
+    vector<Type_Code> edge_types;
+    // cf:date as one plus seconds after time_base (zero if undated), nodes
+    // first and then edges in the order of edge_ids
+    time_t time_base;
+    PackedArray times;
+
+    // what find_next_entry learns about an entry as it skips over it
+    struct entry_summary_t {
+        string cf_type;
+        bool type_equal;
+        string relative;
+        vector<size_t> date;
+        bool undated;
+    };
 
 public:
     CompressedMetadata(string& infile);
-    map<string, string> get_metadata(string& identifier) override;
-    Node_Id get_node_id(string) override;
-    string get_identifier(Node_Id) override;
+    CompressedMetadata(const Archive& archive);
+    CompressedMetadata(const Archive& archive, const Archive& dictionaries);
+    map<string, string> get_metadata(string& identifier) const override;
+    Node_Id get_node_id(string) const override;
+    bool has_identifier(const string&) const override;
+    string get_identifier(Node_Id) const override;
+    void get_identifiers(const Node_Id* nodes, size_t count,
+            Identifier_Arena& arena) const override;
+    Type_Code get_node_type(Node_Id) const override;
+    Type_Code get_edge_type(Node_Id src, Node_Id dest) const override;
+    time_t get_node_time(Node_Id) const override;
+    time_t get_edge_time(Node_Id src, Node_Id dest) const override;
+    void get_node_times(const vector<Node_Id>& nodes,
+            vector<time_t>& times) const override;
 
 private: // helper functions
-    void construct_identifiers_dict();
-    void construct_prov_dicts();
-    void construct_commonstr_dict();
-    size_t find_next_entry(size_t cur_pos);
-    void construct_metadata_dict(string& infile);
-    vector<string> get_node_ids() override;
+    void construct_identifiers_dict(string buffer);
+    void construct_prov_dicts(string buffer);
+    void construct_commonstr_dict(string bin_buffer,
+            string str_buffer);
+    size_t find_next_entry(size_t cur_pos, entry_summary_t& summary);
+    void construct_metadata_dict(BitSet* bs);
+    void construct_columns(vector<entry_summary_t>& summaries);
+    ssize_t find_edge(Node_Id src, Node_Id dest) const;
+    time_t time_at(size_t i) const;
+    vector<string> get_node_ids() const override;
 };
 
 /*
@@ -1,20 +1,92 @@
 #include "metadata.hh"
+#include "perf_counters.hh"
 
 const set<string> Metadata::RELATION_TYPS = {"wasGeneratedBy", "wasInformedBy", "wasDerivedFrom", "used", "relation"};
 
+void Metadata::get_identifiers(const Node_Id* nodes, size_t count,
+        Identifier_Arena& arena) const {
+    for (size_t i = 0; i < count; ++i) {
+        arena.push_back(get_identifier(nodes[i]));
+    }
+}
+
+void Metadata::get_node_times(const vector<Node_Id>& nodes,
+        vector<time_t>& times) const {
+    times.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        times[i] = get_node_time(nodes[i]);
+    }
+}
+
+Type_Code Metadata::get_type_code(const string& typ) const {
+    auto it = type_codes.find(typ);
+    return it == type_codes.end() ? NO_TYPE : it->second;
+}
+
+// Types that do not occur in the trace are dropped. If none of the named
+// types occur, the set holds only a code that is never assigned, so that it
+// matches nothing rather than everything.
+Type_Set Metadata::get_type_set(const vector<string>& typs) const {
+    Type_Set types;
+    for (auto typ : typs) {
+        Type_Code code = get_type_code(typ);
+        if (code != NO_TYPE) {
+            types.set(code);
+        }
+    }
+    if (!typs.empty() && types.none()) {
+        types.set(NO_TYPE - 1);
+    }
+    return types;
+}
+
+string Metadata::get_type_name(Type_Code code) const {
+    return code < type_names.size() ? type_names[code] : "";
+}
+
+Type_Code Metadata::intern_type(const string& typ) {
+    auto it = type_codes.find(typ);
+    if (it != type_codes.end()) {
+        return it->second;
+    }
+    assert(type_names.size() < NO_TYPE - 1);
+    Type_Code code = type_names.size();
+    type_codes[typ] = code;
+    type_names.push_back(typ);
+    return code;
+}
+
 CompressedMetadata::CompressedMetadata(string& infile) {
-    construct_identifiers_dict();
-    construct_prov_dicts();
-    construct_commonstr_dict();
-    construct_metadata_dict(infile);
+    string identifiers_buffer, prov_buffer, bin_buffer, str_buffer, buffer;
+    read_file(IDENTIFIERS_FILE, identifiers_buffer);
+    read_file(PROV_DICTS_FILE, prov_buffer);
+    read_file(COMMONSTR_FILE+".bin", bin_buffer);
+    read_file(COMMONSTR_FILE+".txt", str_buffer);
+    read_file(infile, buffer);
+    construct_identifiers_dict(identifiers_buffer);
+    construct_prov_dicts(prov_buffer);
+    construct_commonstr_dict(bin_buffer, str_buffer);
+    construct_metadata_dict(new BitSet(buffer));
 }
 
-void CompressedMetadata::construct_identifiers_dict() {
-    string buffer, default_id, id;
-    vector<string> encoded_ids;
+// The metadata is read in place from the archive, which must outlive this.
+CompressedMetadata::CompressedMetadata(const Archive& archive)
+    : CompressedMetadata(archive, archive) {}
+
+// A segment (compression/append.py) is encoded with the dictionaries of
+// the archive it was appended to.
+CompressedMetadata::CompressedMetadata(const Archive& archive,
+        const Archive& dictionaries) {
+    construct_identifiers_dict(archive.read_section(SECTION_IDENTIFIERS));
+    construct_prov_dicts(dictionaries.read_section(SECTION_PROV_DICTS));
+    construct_commonstr_dict(
+            dictionaries.read_section(SECTION_COMMON_STRS_BIN),
+            dictionaries.read_section(SECTION_COMMON_STRS_TXT));
+    construct_metadata_dict(
+            new BitSet(archive.map_section(SECTION_METADATA)));
+}
 
-    read_file(IDENTIFIERS_FILE, buffer);
-    
+void CompressedMetadata::construct_identifiers_dict(string buffer) {
 	string substr = buffer.substr(0, 4);
     string rest = buffer.substr(4);
     BitSet bs(substr);
@@ -29,16 +101,12 @@ void CompressedMetadata::construct_identifiers_dict() {
 	}
 }
 
-void CompressedMetadata::construct_commonstr_dict() {
-    string bin_buffer;
-    string str_buffer;
+void CompressedMetadata::construct_commonstr_dict(string bin_buffer,
+        string str_buffer) {
     vector<string> strs;
     int encoding;
     size_t pos = 0;
 
-    read_file(COMMONSTR_FILE+".bin", bin_buffer);
-    read_file(COMMONSTR_FILE+".txt", str_buffer);
-
     strs = split(str_buffer, ',');
     
     BitSet bs(bin_buffer);
@@ -49,11 +117,9 @@ void CompressedMetadata::construct_commonstr_dict() {
     }
 }
 
-void CompressedMetadata::construct_prov_dicts() {
-    string buffer;
+void CompressedMetadata::construct_prov_dicts(string buffer) {
     vector<string> data;
 
-    read_file(PROV_DICTS_FILE, buffer);
     data = split(buffer, DICT_END);
     assert(data.size() == 4);
 
@@ -69,9 +135,22 @@ void CompressedMetadata::construct_prov_dicts() {
         *bits[i] = nbits_for_int(dicts[i]->size());
     }
     label_bits = 8; // we replace labels with one-byte chars
+
+    bool found_type = false, found_relative = false;
+    for (auto kv : key_dict) {
+        if (kv.second == "cf:type") {
+            type_key = kv.first;
+            found_type = true;
+        } else if (kv.second == RELATIVE_NODE) {
+            relative_key = kv.first;
+            found_relative = true;
+        }
+    }
+    assert(found_type && found_relative);
 }
 
-size_t CompressedMetadata::find_next_entry(size_t cur_pos) {
+size_t CompressedMetadata::find_next_entry(size_t cur_pos,
+        entry_summary_t& summary) {
     size_t num_equal_keys, num_encoded_keys, num_common_keys, num_other_keys, num_diff_dates;
     vector<size_t*> num_key_types = {
         &num_equal_keys, 
@@ -80,41 +159,77 @@ size_t CompressedMetadata::find_next_entry(size_t cur_pos) {
         &num_other_keys, 
         &num_diff_dates
     };
+    summary.cf_type = "";
+    summary.type_equal = false;
+    summary.relative = "";
+    summary.date = default_date;
 
     size_t date_index, val_size;
+    unsigned char key, encoded_val;
+    int common_val;
+    unsigned char typ;
+    metadata_bs->get_bits<unsigned char>(typ, typ_bits, cur_pos);
+    // Placeholders for nodes that only appear as relation endpoints have no
+    // date, but would otherwise decode as the default date.
+    auto typ_name = typ_dict.find(typ);
+    summary.undated = typ_name != typ_dict.end() && typ_name->second == "unknown";
     cur_pos += typ_bits;
     for (size_t* key : num_key_types) {
         metadata_bs->get_bits<size_t>(*key, key_bits, cur_pos);
         cur_pos += key_bits;
     }
-    cur_pos += key_bits*num_equal_keys;
-    cur_pos += (key_bits+val_bits)*num_encoded_keys;
-    cur_pos += (key_bits+COMMONSTR_BITS)*num_common_keys;
+    for (size_t i = 0; i < num_equal_keys; ++i) {
+        metadata_bs->get_bits<unsigned char>(key, key_bits, cur_pos);
+        cur_pos += key_bits;
+        if (key == type_key) {
+            summary.type_equal = true;
+        }
+    }
+    for (size_t i = 0; i < num_encoded_keys; ++i) {
+        metadata_bs->get_bits<unsigned char>(key, key_bits, cur_pos);
+        cur_pos += key_bits;
+        if (key == type_key) {
+            metadata_bs->get_bits<unsigned char>(encoded_val, val_bits, cur_pos);
+            summary.cf_type = val_dict[encoded_val];
+        }
+        cur_pos += val_bits;
+    }
+    for (size_t i = 0; i < num_common_keys; ++i) {
+        metadata_bs->get_bits<unsigned char>(key, key_bits, cur_pos);
+        cur_pos += key_bits;
+        if (key == type_key || key == relative_key) {
+            metadata_bs->get_bits<int>(common_val, COMMONSTR_BITS, cur_pos);
+            string& val = (key == type_key) ? summary.cf_type : summary.relative;
+            val = commonstr_dict[common_val];
+        }
+        cur_pos += COMMONSTR_BITS;
+    }
 
     for (size_t i = 0; i < num_other_keys; ++i) {
-        unsigned char key;
         metadata_bs->get_bits<unsigned char>(key, key_bits, cur_pos);
         cur_pos += key_bits;
         metadata_bs->get_bits<size_t>(val_size, MAX_STRING_SIZE_BITS, cur_pos);
         cur_pos += MAX_STRING_SIZE_BITS;
         
-        string str_val;
-        metadata_bs->get_bits_as_str(str_val, val_size, cur_pos);
+        if (key == type_key || key == relative_key) {
+            string& val = (key == type_key) ? summary.cf_type : summary.relative;
+            metadata_bs->get_bits_as_str(val, val_size, cur_pos);
+        }
         cur_pos += val_size;
     }
 
     for (size_t i = 0; i < num_diff_dates; ++i) {
         metadata_bs->get_bits<size_t>(date_index, DATE_TYPE_BITS, cur_pos);
         cur_pos += DATE_TYPE_BITS;
+        metadata_bs->get_bits<size_t>(summary.date[date_index],
+                DATE_BITS[date_index], cur_pos);
         cur_pos += DATE_BITS[date_index];
     }
     return cur_pos;
 }
 
-void CompressedMetadata::construct_metadata_dict(string& infile) {
-    string buffer;
-    read_file(infile, buffer);
-    metadata_bs = new BitSet(buffer); 
+void CompressedMetadata::construct_metadata_dict(BitSet* bs) {
+    metadata_bs.reset(bs);
     size_t total_size, cur_pos, val_size;
     unsigned char key, encoded_val;
     int common_val;
@@ -195,9 +310,10 @@ void CompressedMetadata::construct_metadata_dict(string& infile) {
     }
 
     // go through all node data, creating a map from nodeid to index of string 
+    vector<entry_summary_t> summaries(num_nodes);
     for (size_t i = 0; i < num_nodes; ++i) {
         nodeid2dataindex[i] = cur_pos;
-        cur_pos = find_next_entry(cur_pos);
+        cur_pos = find_next_entry(cur_pos, summaries[i]);
     }
     // go through all relation data, creating a map from nodeid to index of string 
     int relation_id;
@@ -208,16 +324,108 @@ void CompressedMetadata::construct_metadata_dict(string& infile) {
 
         nodeid2dataindex[relation_id] = cur_pos;
 
-        cur_pos = find_next_entry(cur_pos);
+        summaries.push_back({});
+        cur_pos = find_next_entry(cur_pos, summaries.back());
+        edge_ids.push_back(relation_id);
 
         id2nodeid[identifiers[num_nodes + num_relations]] = relation_id;
         nodeid2id[relation_id] = identifiers[num_nodes + num_relations];
         num_relations++;
     }
     assert(cur_pos == total_size);
+    construct_columns(summaries);
+}
+
+void CompressedMetadata::construct_columns(
+        vector<entry_summary_t>& summaries) {
+    // Relations are written in order of increasing id.
+    assert(is_sorted(edge_ids.begin(), edge_ids.end()));
+    string default_relation_type = default_relation_data["cf:type"];
+    edge_types.reserve(edge_ids.size());
+    for (size_t i = num_nodes; i < summaries.size(); ++i) {
+        entry_summary_t& summary = summaries[i];
+        string& typ = summary.type_equal ? default_relation_type : summary.cf_type;
+        edge_types.push_back(typ.empty() ? NO_TYPE : intern_type(typ));
+    }
+
+    // A node that shares its cf:type with another version of itself takes
+    // the type of the node it was encoded relative to (or of the default).
+    string default_node_type = default_node_data["cf:type"];
+    node_types.reserve(num_nodes);
+    for (size_t i = 0; i < num_nodes; ++i) {
+        entry_summary_t* summary = &summaries[i];
+        string* typ = &summary->cf_type;
+        for (size_t depth = 0; summary->type_equal; ++depth) {
+            assert(depth < num_nodes);
+            int relative;
+            if (str_to_int(summary->relative, relative, 10)
+                    && relative != (int)i && (size_t)relative < num_nodes) {
+                summary = &summaries[relative];
+                typ = &summary->cf_type;
+            } else {
+                typ = &default_node_type;
+                break;
+            }
+        }
+        node_types.push_back(typ->empty() ? NO_TYPE : intern_type(*typ));
+    }
+
+    // Dates are stored relative to the earliest one in the trace, using
+    // just enough bits for the latest.
+    vector<time_t> entry_times;
+    entry_times.reserve(summaries.size());
+    time_base = numeric_limits<time_t>::max();
+    time_t time_max = 0;
+    for (auto& summary : summaries) {
+        vector<size_t>& d = summary.date;
+        time_t t = summary.undated ? NO_TIME :
+            civil_to_time(d[0], d[1], d[2], d[3], d[4], d[5]);
+        entry_times.push_back(t);
+        if (t != NO_TIME) {
+            time_base = min(time_base, t);
+            time_max = max(time_max, t);
+        }
+    }
+    if (time_max < time_base) {
+        time_base = time_max;
+    }
+    times = PackedArray(nbits_for_int(time_max - time_base + 1),
+            entry_times.size());
+    for (size_t i = 0; i < entry_times.size(); ++i) {
+        if (entry_times[i] != NO_TIME) {
+            times.set(i, entry_times[i] - time_base + 1);
+        }
+    }
+}
+
+time_t CompressedMetadata::time_at(size_t i) const {
+    uint64_t t = times.get(i);
+    return t ? time_base + t - 1 : NO_TIME;
 }
 
-map<string, string> CompressedMetadata::get_metadata(string& identifier) {
+// Counts a record as decoded, and how deep in a chain of relatives it is,
+// for as long as it is being decoded
+struct Record_Count {
+    Decode_Counters& stats;
+
+    Record_Count() : stats(decode_counters()) {
+        add_count(stats.metadata_records);
+        if (stats.metadata_depth) {
+            add_count(stats.relative_records);
+            if (stats.metadata_depth > stats.max_relative_depth.load(
+                        std::memory_order_relaxed)) {
+                stats.max_relative_depth.store(stats.metadata_depth,
+                        std::memory_order_relaxed);
+            }
+        }
+        ++stats.metadata_depth;
+    }
+    ~Record_Count() { --stats.metadata_depth; }
+};
+
+map<string, string> CompressedMetadata::get_metadata(string& identifier) const {
+    PERF_SCOPE(PERF_GET_METADATA);
+    Record_Count count;
     map<string, string> metadata;
     size_t cur_pos, val_size, date_index;
     unsigned char key, encoded_val, typ;
@@ -238,36 +446,36 @@ map<string, string> CompressedMetadata::get_metadata(string& identifier) {
     if (my_nodeid == id2nodeid.end()) {
         return metadata;
     }
-    cur_pos = nodeid2dataindex[my_nodeid->second];
+    cur_pos = nodeid2dataindex.at(my_nodeid->second);
 
     // get type
     metadata_bs->get_bits<unsigned char>(typ, typ_bits, cur_pos);
     cur_pos += typ_bits;
-    metadata["typ"] = typ_dict[typ];
-    bool is_relation = (RELATION_TYPS.count(typ_dict[typ]));
+    metadata["typ"] = dict_get(typ_dict, typ);
+    bool is_relation = (RELATION_TYPS.count(dict_get(typ_dict, typ)));
 
     // get sender/receiver if a relation
     if (is_relation) {
         nodeid = my_nodeid->second - num_nodes;
         if (metadata["typ"] == "used") {
-            metadata["prov:entity"] = nodeid2id[nodeid >> id_bits];
-            metadata["prov:activity"] = nodeid2id[nodeid & ((1 << id_bits) - 1)]; 
+            metadata["prov:entity"] = dict_get(nodeid2id, nodeid >> id_bits);
+            metadata["prov:activity"] = dict_get(nodeid2id, nodeid & ((1 << id_bits) - 1)); 
         }
         else if (metadata["typ"] == "wasGeneratedBy") {
-            metadata["prov:activity"] = nodeid2id[nodeid >> id_bits];
-            metadata["prov:entity"] = nodeid2id[nodeid & ((1 << id_bits) - 1)]; 
+            metadata["prov:activity"] = dict_get(nodeid2id, nodeid >> id_bits);
+            metadata["prov:entity"] = dict_get(nodeid2id, nodeid & ((1 << id_bits) - 1)); 
         }
         else if (metadata["typ"] == "wasDerivedFrom") {
-            metadata["prov:usedEntity"] = nodeid2id[nodeid >> id_bits];
-            metadata["prov:generatedEntity"] = nodeid2id[nodeid & ((1 << id_bits) - 1)]; 
+            metadata["prov:usedEntity"] = dict_get(nodeid2id, nodeid >> id_bits);
+            metadata["prov:generatedEntity"] = dict_get(nodeid2id, nodeid & ((1 << id_bits) - 1)); 
         }
         else if (metadata["typ"] == "wasInformedBy") {
-            metadata["prov:informant"]= nodeid2id[nodeid >> id_bits];
-            metadata["prov:informed"] = nodeid2id[nodeid & ((1 << id_bits) - 1)]; 
+            metadata["prov:informant"]= dict_get(nodeid2id, nodeid >> id_bits);
+            metadata["prov:informed"] = dict_get(nodeid2id, nodeid & ((1 << id_bits) - 1)); 
         }
         else if (metadata["typ"] == "relation") {
-            metadata["cf:sender"] = nodeid2id[nodeid >> id_bits];
-            metadata["cf:receiver"] = nodeid2id[nodeid & ((1 << id_bits) - 1)]; 
+            metadata["cf:sender"] = dict_get(nodeid2id, nodeid >> id_bits);
+            metadata["cf:receiver"] = dict_get(nodeid2id, nodeid & ((1 << id_bits) - 1)); 
         }
     }
 
@@ -282,10 +490,10 @@ map<string, string> CompressedMetadata::get_metadata(string& identifier) {
         metadata_bs->get_bits<unsigned char>(key, key_bits, cur_pos);
         cur_pos += key_bits;
         if (is_relation) {
-            metadata[key_dict[key]] = default_relation_data[key_dict[key]];
+            metadata[dict_get(key_dict, key)] = dict_get(default_relation_data, dict_get(key_dict, key));
         } else {
             // we can't decode because we don't know if this node is relative or not
-            metadata[key_dict[key]] = "=";
+            metadata[dict_get(key_dict, key)] = "=";
         }
     }
 
@@ -295,7 +503,7 @@ map<string, string> CompressedMetadata::get_metadata(string& identifier) {
         cur_pos += key_bits;
         metadata_bs->get_bits<unsigned char>(encoded_val, val_bits, cur_pos);
         cur_pos += val_bits;
-        metadata[key_dict[key]] = val_dict[encoded_val];
+        metadata[dict_get(key_dict, key)] = dict_get(val_dict, encoded_val);
     }
     
     // decode common values
@@ -304,7 +512,7 @@ map<string, string> CompressedMetadata::get_metadata(string& identifier) {
         cur_pos += key_bits;
         metadata_bs->get_bits<int>(common_val, COMMONSTR_BITS, cur_pos);
         cur_pos += COMMONSTR_BITS;
-        metadata[key_dict[key]] = commonstr_dict[common_val];
+        metadata[dict_get(key_dict, key)] = dict_get(commonstr_dict, common_val);
     }
 
     // nonencoded values
@@ -317,12 +525,12 @@ map<string, string> CompressedMetadata::get_metadata(string& identifier) {
         metadata_bs->get_bits_as_str(str_val, val_size, cur_pos);
         cur_pos += val_size;
 
-        if (key_dict[key] == "prov:label") {
+        if (dict_get(key_dict, key) == "prov:label") {
             label_key = str_val[0];
-            str_val = prov_label_dict[label_key] + str_val.substr(1) ;
+            str_val = dict_get(prov_label_dict, label_key) + str_val.substr(1) ;
         }
             
-        metadata[key_dict[key]] = str_val; 
+        metadata[dict_get(key_dict, key)] = str_val; 
     }
 
     // get date
@@ -357,21 +565,71 @@ map<string, string> CompressedMetadata::get_metadata(string& identifier) {
     map<string, string> relative_metadata;
     if (relative != metadata.end() && relative->second != "=" && stoi(relative->second) != (int)my_nodeid->second) {
         // the node was encoded in relation to another node
-        relative_metadata = get_metadata(nodeid2id[stoi(relative->second)]);
+        string relative_id = dict_get(nodeid2id, stoi(relative->second));
+        relative_metadata = get_metadata(relative_id);
     } else {
         // the node was encoded in relation to the default data
         relative_metadata = default_node_data; 
     }
     for (auto kv: metadata) {
         if (kv.second == "=") {
-            metadata[kv.first] = relative_metadata[kv.first];
+            metadata[kv.first] = dict_get(relative_metadata, kv.first);
         }
     }
     return metadata;
 }
-Node_Id CompressedMetadata::get_node_id(string identifer) { return id2nodeid[identifer]; }
-string CompressedMetadata::get_identifier(Node_Id node) { return nodeid2id[node]; }
-vector<string> CompressedMetadata::get_node_ids() {
+Node_Id CompressedMetadata::get_node_id(string identifer) const {
+    return dict_get(id2nodeid, identifer);
+}
+bool CompressedMetadata::has_identifier(const string& identifier) const {
+    return id2nodeid.count(identifier) > 0;
+}
+Type_Code CompressedMetadata::get_node_type(Node_Id node) const {
+    return node < node_types.size() ? node_types[node] : NO_TYPE;
+}
+ssize_t CompressedMetadata::find_edge(Node_Id src, Node_Id dest) const {
+    Node_Id edge = (dest << id_bits) + src + num_nodes;
+    auto it = lower_bound(edge_ids.begin(), edge_ids.end(), edge);
+    if (it == edge_ids.end() || *it != edge) {
+        return -1;
+    }
+    return it - edge_ids.begin();
+}
+Type_Code CompressedMetadata::get_edge_type(Node_Id src, Node_Id dest) const {
+    ssize_t edge = find_edge(src, dest);
+    return edge < 0 ? NO_TYPE : edge_types[edge];
+}
+time_t CompressedMetadata::get_node_time(Node_Id node) const {
+    return node < num_nodes ? time_at(node) : NO_TIME;
+}
+time_t CompressedMetadata::get_edge_time(Node_Id src, Node_Id dest) const {
+    ssize_t edge = find_edge(src, dest);
+    return edge < 0 ? NO_TIME : time_at(num_nodes + edge);
+}
+void CompressedMetadata::get_node_times(const vector<Node_Id>& nodes,
+        vector<time_t>& out) const {
+    out.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        out[i] = nodes[i] < num_nodes ? time_at(nodes[i]) : NO_TIME;
+    }
+}
+// Node identifiers are stored in node order; only relations need the map.
+string CompressedMetadata::get_identifier(Node_Id node) const {
+    return node < num_nodes ? identifiers[node] : dict_get(nodeid2id, node);
+}
+void CompressedMetadata::get_identifiers(const Node_Id* nodes, size_t count,
+        Identifier_Arena& arena) const {
+    arena.offsets.reserve(arena.offsets.size() + count);
+    for (size_t i = 0; i < count; ++i) {
+        Node_Id n = nodes[i];
+        if (n < num_nodes) {
+            arena.push_back(identifiers[n]);
+        } else {
+            arena.push_back(get_identifier(n));
+        }
+    }
+}
+vector<string> CompressedMetadata::get_node_ids() const {
     vector<string> v(identifiers.begin(), identifiers.begin()+num_nodes);
     return v;
 }
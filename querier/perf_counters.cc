@@ -0,0 +1,225 @@
+#include "perf_counters.hh"
+
+static const char* REGION_NAMES[] = {"query", "get_edges", "get_metadata"};
+static const char* EVENT_NAMES[] = {"task_clock", "cycles", "instructions",
+    "llc_misses", "branch_misses"};
+
+const char* perf_region_name(Perf_Region region) {
+    return REGION_NAMES[region];
+}
+
+const char* perf_event_name(Perf_Event event) {
+    return EVENT_NAMES[event];
+}
+
+#ifdef PERF_COUNTERS
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct Event_Config {
+    uint32_t type;
+    uint64_t config;
+};
+
+static const Event_Config EVENT_CONFIGS[] = {
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+typedef atomic<uint64_t> Counter;
+
+struct Perf_Thread;
+
+// Every thread's counters, and the totals of threads that have exited
+static mutex threads_mutex;
+static vector<Perf_Thread*> threads;
+static Counter retired_calls[NUM_PERF_REGIONS];
+static Counter retired_counts[NUM_PERF_REGIONS][NUM_PERF_EVENTS];
+static atomic<bool> available[NUM_PERF_EVENTS];
+
+// Only the owning thread adds, so a relaxed load and store is enough
+static inline void add(Counter& c, uint64_t n) {
+    c.store(c.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+struct Perf_Thread {
+    int fds[NUM_PERF_EVENTS];
+    // for reading hardware counters with rdpmc rather than a system call
+    perf_event_mmap_page* pages[NUM_PERF_EVENTS];
+    unsigned depth[NUM_PERF_REGIONS];
+    Counter calls[NUM_PERF_REGIONS];
+    Counter counts[NUM_PERF_REGIONS][NUM_PERF_EVENTS];
+
+    Perf_Thread() {
+        memset(depth, 0, sizeof(depth));
+        for (size_t r = 0; r < NUM_PERF_REGIONS; ++r) {
+            calls[r] = 0;
+            for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+                counts[r][e] = 0;
+            }
+        }
+        for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = EVENT_CONFIGS[e].type;
+            attr.config = EVENT_CONFIGS[e].config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            pages[e] = nullptr;
+            if (fds[e] < 0) {
+                continue;
+            }
+            available[e] = true;
+            void* page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ,
+                    MAP_SHARED, fds[e], 0);
+            if (page != MAP_FAILED) {
+                pages[e] = (perf_event_mmap_page*) page;
+            }
+        }
+        lock_guard<mutex> lock(threads_mutex);
+        threads.push_back(this);
+    }
+
+    ~Perf_Thread() {
+        lock_guard<mutex> lock(threads_mutex);
+        for (size_t r = 0; r < NUM_PERF_REGIONS; ++r) {
+            retired_calls[r] += calls[r];
+            for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+                retired_counts[r][e] += counts[r][e];
+            }
+        }
+        threads.erase(find(threads.begin(), threads.end(), this));
+        for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+            if (pages[e]) {
+                munmap(pages[e], sysconf(_SC_PAGESIZE));
+            }
+            if (fds[e] >= 0) {
+                close(fds[e]);
+            }
+        }
+    }
+
+    uint64_t read_event(size_t e) const {
+        if (fds[e] < 0) {
+            return 0;
+        }
+#if defined(__x86_64__)
+        // The kernel's seqlock protocol for self-monitoring (see
+        // perf_event_mmap_page in linux/perf_event.h)
+        volatile perf_event_mmap_page* pc = pages[e];
+        if (pc && pc->cap_user_rdpmc) {
+            uint32_t seq, idx;
+            uint64_t count;
+            do {
+                seq = pc->lock;
+                asm volatile("" ::: "memory");
+                idx = pc->index;
+                count = pc->offset;
+                if (idx) {
+                    uint32_t lo, hi;
+                    asm volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(idx - 1));
+                    int shift = 64 - pc->pmc_width;
+                    count += (int64_t) (((uint64_t) hi << 32 | lo) << shift)
+                        >> shift;
+                }
+                asm volatile("" ::: "memory");
+            } while (pc->lock != seq);
+            if (idx) {
+                return count;
+            }
+        }
+#endif
+        uint64_t count = 0;
+        if (read(fds[e], &count, sizeof(count)) != sizeof(count)) {
+            return 0;
+        }
+        return count;
+    }
+
+    void read_all(uint64_t* values) const {
+        for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+            values[e] = read_event(e);
+        }
+    }
+};
+
+static Perf_Thread& this_thread_counters() {
+    static thread_local Perf_Thread counters;
+    return counters;
+}
+
+Perf_Scope::Perf_Scope(Perf_Region region) : region_(region) {
+    Perf_Thread& t = this_thread_counters();
+    outer_ = t.depth[region]++ == 0;
+    if (outer_) {
+        t.read_all(start_);
+    }
+}
+
+Perf_Scope::~Perf_Scope() {
+    Perf_Thread& t = this_thread_counters();
+    --t.depth[region_];
+    if (outer_) {
+        uint64_t end[NUM_PERF_EVENTS];
+        t.read_all(end);
+        for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+            add(t.counts[region_][e], end[e] - start_[e]);
+        }
+        add(t.calls[region_], 1);
+    }
+}
+
+Perf_Totals perf_totals() {
+    Perf_Totals totals;
+    lock_guard<mutex> lock(threads_mutex);
+    for (size_t r = 0; r < NUM_PERF_REGIONS; ++r) {
+        totals.calls[r] = retired_calls[r];
+        for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+            totals.counts[r][e] = retired_counts[r][e];
+        }
+        for (auto t : threads) {
+            totals.calls[r] += t->calls[r];
+            for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+                totals.counts[r][e] += t->counts[r][e];
+            }
+        }
+    }
+    for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+        totals.available[e] = available[e];
+    }
+    return totals;
+}
+
+void perf_reset() {
+    lock_guard<mutex> lock(threads_mutex);
+    for (size_t r = 0; r < NUM_PERF_REGIONS; ++r) {
+        retired_calls[r] = 0;
+        for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+            retired_counts[r][e] = 0;
+        }
+        for (auto t : threads) {
+            t->calls[r] = 0;
+            for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+                t->counts[r][e] = 0;
+            }
+        }
+    }
+}
+
+#endif
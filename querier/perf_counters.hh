@@ -0,0 +1,80 @@
+#ifndef PERF_COUNTERS_HH
+#define PERF_COUNTERS_HH
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Hardware counters (from perf_event_open) around the query paths, for
+ * telling whether queries are bound by decoding, cache misses or branches.
+ * They are only built with PERF_COUNTERS defined (make PERFCOUNT=1);
+ * otherwise PERF_SCOPE expands to nothing, and the hot paths are as if it
+ * were not there.
+ *
+ * Each thread opens its own counters, which count that thread in user
+ * space only, the first time it enters a scope. A scope adds what the
+ * counters moved while it ran to its region's totals. A scope inside
+ * another of the same region (a Querier method calling another,
+ * get_metadata following a relative chain) adds nothing, so each region
+ * counts everything under it once. Counters that the kernel or CPU does
+ * not offer, as in most VMs, are marked unavailable and read as 0.
+ *
+ * Hardware counters are read with rdpmc where the kernel allows it, and
+ * otherwise with a system call each, which the enclosing regions count;
+ * compare regions by their share of instructions and misses rather than
+ * by absolute time.
+ */
+
+enum Perf_Region {
+    PERF_QUERY,
+    PERF_GET_EDGES,
+    PERF_GET_METADATA,
+    NUM_PERF_REGIONS,
+};
+
+enum Perf_Event {
+    PERF_TASK_CLOCK,
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    NUM_PERF_EVENTS,
+};
+
+struct Perf_Totals {
+    uint64_t calls[NUM_PERF_REGIONS];
+    uint64_t counts[NUM_PERF_REGIONS][NUM_PERF_EVENTS];
+    bool available[NUM_PERF_EVENTS];
+};
+
+const char* perf_region_name(Perf_Region region);
+// task_clock is in nanoseconds
+const char* perf_event_name(Perf_Event event);
+
+#ifdef PERF_COUNTERS
+
+class Perf_Scope {
+    public:
+        explicit Perf_Scope(Perf_Region region);
+        ~Perf_Scope();
+
+    private:
+        Perf_Region region_;
+        bool outer_;
+        uint64_t start_[NUM_PERF_EVENTS];
+};
+
+#define PERF_SCOPE(region) Perf_Scope perf_scope_(region)
+
+// Totals summed over all threads, including ones that have exited. Reset
+// while no scopes are running.
+Perf_Totals perf_totals();
+void perf_reset();
+
+#else
+
+#define PERF_SCOPE(region)
+
+#endif
+
+#endif
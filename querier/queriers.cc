@@ -1,21 +1,95 @@
-#include "graph_v2.hh"
+#include "graph_loader.hh"
 #include "json_graph.hh"
+#include "perf_counters.hh"
 #include "queriers.hh"
+#include "segments.hh"
 
-DummyQuerier::DummyQuerier(string& auditfile) {
-    auto json_graph = new JsonGraph(auditfile);
-    metadata_ = json_graph; 
-    graph_ = json_graph;
+DummyQuerier::DummyQuerier(string& auditfile, size_t cache_bytes)
+    : json_(new JsonGraph(auditfile)) {
+    metadata_ = json_.get();
+    graph_ = json_.get();
+    add_cache(cache_bytes);
 }
 
-CompressedQuerier::CompressedQuerier(string& metafile, string& graphfile) {
-    metadata_ = new CompressedMetadata(metafile);
+DummyQuerier::~DummyQuerier() {}
+
+CompressedQuerier::CompressedQuerier(string& metafile, string& graphfile,
+        size_t cache_bytes, Resident_Mode mode)
+    : compressed_metadata_(new CompressedMetadata(metafile)) {
+    metadata_ = compressed_metadata_.get();
     string buffer;
     read_file(graphfile, buffer);
-    graph_ = new Graph_V2(buffer);
+    init_graph(load_compressed_graph(buffer), mode);
+    add_cache(cache_bytes);
+}
+
+CompressedQuerier::CompressedQuerier(string& archivefile, size_t cache_bytes,
+        Resident_Mode mode, bool validate)
+    : archive_(new Archive(archivefile)) {
+    if (validate) {
+        validate_stats_ = archive_->validate();
+    }
+    compressed_metadata_.reset(new CompressedMetadata(*archive_));
+    metadata_ = compressed_metadata_.get();
+    // Left unchecked, so that only the parts of the graph that are
+    // traversed are read in
+    init_graph(load_compressed_graph(
+                archive_->map_section(SECTION_GRAPH, 0, false)), mode);
+    if (archive_->has_section(SECTION_SEGMENT)) {
+        add_segments();
+    }
+    add_cache(cache_bytes);
+}
+
+CompressedQuerier::~CompressedQuerier() {}
+
+void CompressedQuerier::init_graph(Graph_V2* graph, Resident_Mode mode) {
+    compressed_graph_.reset(graph);
+    graph_ = graph;
+    if (mode == DECODED_RESIDENT) {
+        csr_.reset(graph->materialize_csr());
+        graph_ = csr_.get();
+    }
+}
+
+// Puts the segments appended to the archive (compression/append.py) in
+// front of the base trace. Only the base is decoded up front.
+void CompressedQuerier::add_segments() {
+    vector<const Segment*> segments;
+    for (size_t i = 0; i < archive_->count(SECTION_SEGMENT); ++i) {
+        segments_.emplace_back(new Archive_Segment(*archive_, i));
+        segments.push_back(segments_.back().get());
+    }
+    const Metadata* base = metadata_;
+    segmented_metadata_.reset(new Segmented_Metadata(base, segments));
+    segmented_graph_.reset(new Segmented_Graph(graph_, base, segments,
+                segmented_metadata_->num_nodes));
+    metadata_ = segmented_metadata_.get();
+    graph_ = segmented_graph_.get();
 }
 
-map<string, vector<string>> Querier::friends_of(string& file_id, string& task_id) {
+Csr_Stats CompressedQuerier::decode_stats() const {
+    return csr_ ? csr_->decode_stats() : Csr_Stats();
+}
+
+void Querier::add_cache(size_t budget_bytes) {
+    if (budget_bytes) {
+        cache_.reset(new CachedGraph(graph_, budget_bytes));
+        graph_ = cache_.get();
+    }
+}
+Cache_Stats Querier::cache_stats() const {
+    return cache_ ? cache_->stats() : Cache_Stats();
+}
+Decode_Stats Querier::stats() const {
+    return decoding_totals();
+}
+void Querier::reset_stats() const {
+    reset_decoding_totals();
+}
+
+map<string, vector<string>> Querier::friends_of(string& file_id, string& task_id) const {
+    PERF_SCOPE(PERF_QUERY);
     Node_Id file_node = metadata_->get_node_id(file_id);
     Node_Id task_node = metadata_->get_node_id(task_id);
     auto relation2nodeids = graph_->friends_of(file_node, task_node, metadata_);
@@ -29,64 +103,296 @@ map<string, vector<string>> Querier::friends_of(string& file_id, string& task_id
     }
     return relation2ids;
 }
-map<string, string> Querier::get_metadata(string& identifier) {
+map<string, string> Querier::get_metadata(string& identifier) const {
+    PERF_SCOPE(PERF_QUERY);
     return metadata_->get_metadata(identifier);
 }
-vector<string> Querier::get_all_ancestors(string& identifier) {
+vector<string> Querier::get_all_ancestors(string& identifier) const {
+    PERF_SCOPE(PERF_QUERY);
+    return to_identifiers(get_all_ancestor_ids(resolve_node(identifier)));
+}
+vector<string> Querier::get_direct_ancestors(string& identifier) const {
+    PERF_SCOPE(PERF_QUERY);
+    return to_identifiers(get_direct_ancestor_ids(resolve_node(identifier)));
+}
+vector<string> Querier::get_all_descendants(string& identifier) const {
+    PERF_SCOPE(PERF_QUERY);
+    return to_identifiers(get_all_descendant_ids(resolve_node(identifier)));
+}
+vector<string> Querier::get_direct_descendants(string& identifier) const {
+    PERF_SCOPE(PERF_QUERY);
+    return to_identifiers(get_direct_descendant_ids(resolve_node(identifier)));
+}
+vector<string> Querier::get_filtered_ancestors(string& identifier,
+        const Traversal_Filter& filter) const {
+    PERF_SCOPE(PERF_QUERY);
+    return to_identifiers(get_filtered_ancestor_ids(resolve_node(identifier),
+                filter));
+}
+vector<string> Querier::get_filtered_descendants(string& identifier,
+        const Traversal_Filter& filter) const {
+    PERF_SCOPE(PERF_QUERY);
+    return to_identifiers(get_filtered_descendant_ids(resolve_node(identifier),
+                filter));
+}
+vector<string> Querier::get_ancestors_between(string& identifier,
+        time_t t_from, time_t t_to) const {
+    PERF_SCOPE(PERF_QUERY);
+    Traversal_Filter filter;
+    filter.t_from = t_from;
+    filter.t_to = t_to;
+    return get_filtered_ancestors(identifier, filter);
+}
+vector<string> Querier::get_descendants_between(string& identifier,
+        time_t t_from, time_t t_to) const {
+    PERF_SCOPE(PERF_QUERY);
+    Traversal_Filter filter;
+    filter.t_from = t_from;
+    filter.t_to = t_to;
+    return get_filtered_descendants(identifier, filter);
+}
+vector<string> Querier::get_k_hop_ancestors(string& identifier, size_t k) const {
+    PERF_SCOPE(PERF_QUERY);
+    Traversal_Filter filter;
+    filter.max_depth = k;
+    return get_filtered_ancestors(identifier, filter);
+}
+vector<string> Querier::get_k_hop_descendants(string& identifier, size_t k) const {
+    PERF_SCOPE(PERF_QUERY);
+    Traversal_Filter filter;
+    filter.max_depth = k;
+    return get_filtered_descendants(identifier, filter);
+}
+size_t Querier::count_k_hop_ancestors(string& identifier, size_t k) const {
+    PERF_SCOPE(PERF_QUERY);
+    Traversal_Filter filter;
+    filter.max_depth = k;
+    return count_ancestors(identifier, filter);
+}
+size_t Querier::count_k_hop_descendants(string& identifier, size_t k) const {
+    PERF_SCOPE(PERF_QUERY);
+    Traversal_Filter filter;
+    filter.max_depth = k;
+    return count_descendants(identifier, filter);
+}
+Neighborhood Querier::get_neighborhood(string& identifier, size_t k) const {
+    PERF_SCOPE(PERF_QUERY);
     Node_Id node = metadata_->get_node_id(identifier);
-    auto node_ids = graph_->get_all_ancestors(node);
+    vector<Node_Id> node_ids;
+    vector<pair<Node_Id, Node_Id>> edge_ids;
+    graph_->get_neighborhood(node, k, node_ids, edge_ids);
 
-    vector<string> ids;
+    Neighborhood result;
     for (auto n : node_ids) {
-        ids.push_back(metadata_->get_identifier(n));
+        result.nodes.push_back(metadata_->get_identifier(n));
     }
-    return ids;
+    for (auto e : edge_ids) {
+        result.edges.push_back(make_pair(metadata_->get_identifier(e.first),
+                    metadata_->get_identifier(e.second)));
+    }
+    return result;
 }
-vector<string> Querier::get_direct_ancestors(string& identifier) {
+pair<size_t, size_t> Querier::get_neighborhood_size(string& identifier,
+        size_t k) const {
+    PERF_SCOPE(PERF_QUERY);
     Node_Id node = metadata_->get_node_id(identifier);
-    auto node_ids = graph_->get_incoming_edges(node);
-
-    vector<string> ids;
-    for (auto n : node_ids) {
-        ids.push_back(metadata_->get_identifier(n));
-    }
-    return ids;
+    vector<Node_Id> node_ids;
+    vector<pair<Node_Id, Node_Id>> edge_ids;
+    graph_->get_neighborhood(node, k, node_ids, edge_ids);
+    return make_pair(node_ids.size(), edge_ids.size());
 }
-vector<string> Querier::get_all_descendants(string& identifier) {
+size_t Querier::count_ancestors(string& identifier,
+        const Traversal_Filter& filter) const {
+    PERF_SCOPE(PERF_QUERY);
     Node_Id node = metadata_->get_node_id(identifier);
-    auto node_ids = graph_->get_all_descendants(node);
-
-    vector<string> ids;
-    for (auto n : node_ids) {
-        ids.push_back(metadata_->get_identifier(n));
-    }
-    return ids;
+    size_t count = 0;
+    graph_->traverse(node, false, filter, metadata_, [&](Node_Id) {
+        ++count;
+        return true;
+    });
+    return count;
 }
-vector<string> Querier::get_direct_descendants(string& identifier) {
+size_t Querier::count_descendants(string& identifier,
+        const Traversal_Filter& filter) const {
+    PERF_SCOPE(PERF_QUERY);
     Node_Id node = metadata_->get_node_id(identifier);
-    auto node_ids = graph_->get_outgoing_edges(node);
-    
-    vector<string> ids;
-    for (auto n : node_ids) {
-        ids.push_back(metadata_->get_identifier(n));
-    }
-    return ids;
+    size_t count = 0;
+    graph_->traverse(node, true, filter, metadata_, [&](Node_Id) {
+        ++count;
+        return true;
+    });
+    return count;
 }
-vector<vector<string>> Querier::all_paths(string& sourceid, string& sinkid) {
+size_t Querier::count_paths(string& sourceid, string& sinkid) const {
+    PERF_SCOPE(PERF_QUERY);
     Node_Id source = metadata_->get_node_id(sourceid);
     Node_Id sink = metadata_->get_node_id(sinkid);
-    vector<vector<Node_Id>> node_id_paths = graph_->get_all_paths(source, sink);
-    
+    return graph_->count_paths(source, sink);
+}
+bool Querier::ancestor_exists(string& identifier,
+        const Traversal_Filter& filter) const {
+    PERF_SCOPE(PERF_QUERY);
+    Node_Id node = metadata_->get_node_id(identifier);
+    bool found = false;
+    graph_->traverse(node, false, filter, metadata_, [&](Node_Id) {
+        found = true;
+        return false;
+    });
+    return found;
+}
+bool Querier::descendant_exists(string& identifier,
+        const Traversal_Filter& filter) const {
+    PERF_SCOPE(PERF_QUERY);
+    Node_Id node = metadata_->get_node_id(identifier);
+    bool found = false;
+    graph_->traverse(node, true, filter, metadata_, [&](Node_Id) {
+        found = true;
+        return false;
+    });
+    return found;
+}
+bool Querier::path_exists(string& sourceid, string& sinkid) const {
+    PERF_SCOPE(PERF_QUERY);
+    Node_Id source = metadata_->get_node_id(sourceid);
+    Node_Id sink = metadata_->get_node_id(sinkid);
+    return graph_->path_exists(source, sink);
+}
+vector<vector<string>> Querier::all_paths(string& sourceid, string& sinkid) const {
+    PERF_SCOPE(PERF_QUERY);
+    vector<vector<Node_Id>> node_id_paths = all_path_ids(
+            resolve_node(sourceid), resolve_node(sinkid));
+
     vector<vector<string>> result;
-    for (auto node_ids  : node_id_paths) {
-        vector<string> ids;
-        for (auto n : node_ids) {
-            ids.push_back(metadata_->get_identifier(n));
-        }
-        result.push_back(ids);
+    for (auto& node_ids : node_id_paths) {
+        result.push_back(to_identifiers(node_ids));
     }
     return result;
 }
-vector<string> Querier::get_node_ids() {
+vector<string> Querier::get_node_ids() const {
     return metadata_->get_node_ids();
 }
+Traversal_Filter Querier::make_type_filter(const vector<string>& edge_types,
+        const vector<string>& node_types, const vector<string>& via_types) const {
+    Traversal_Filter filter;
+    filter.edge_types = metadata_->get_type_set(edge_types);
+    filter.node_types = metadata_->get_type_set(node_types);
+    filter.via_types = metadata_->get_type_set(via_types);
+    return filter;
+}
+
+bool Querier::has_node(const string& identifier) const {
+    return metadata_->has_identifier(identifier);
+}
+Node_Id Querier::resolve_node(string& identifier) const {
+    return metadata_->get_node_id(identifier);
+}
+void Querier::resolve_identifiers(const Node_Id* nodes, size_t count,
+        Identifier_Arena& arena) const {
+    metadata_->get_identifiers(nodes, count, arena);
+}
+vector<string> Querier::to_identifiers(const vector<Node_Id>& nodes) const {
+    vector<string> ids;
+    ids.reserve(nodes.size());
+    for (Node_Id n : nodes) {
+        ids.push_back(metadata_->get_identifier(n));
+    }
+    return ids;
+}
+vector<Node_Id> Querier::get_all_ancestor_ids(Node_Id node) const {
+    PERF_SCOPE(PERF_QUERY);
+    return graph_->get_all_ancestors(node);
+}
+vector<Node_Id> Querier::get_direct_ancestor_ids(Node_Id node) const {
+    PERF_SCOPE(PERF_QUERY);
+    return graph_->get_incoming_edges(node);
+}
+vector<Node_Id> Querier::get_all_descendant_ids(Node_Id node) const {
+    PERF_SCOPE(PERF_QUERY);
+    return graph_->get_all_descendants(node);
+}
+vector<Node_Id> Querier::get_direct_descendant_ids(Node_Id node) const {
+    PERF_SCOPE(PERF_QUERY);
+    return graph_->get_outgoing_edges(node);
+}
+vector<Node_Id> Querier::get_filtered_ancestor_ids(Node_Id node,
+        const Traversal_Filter& filter) const {
+    PERF_SCOPE(PERF_QUERY);
+    return graph_->get_all_ancestors(node, filter, metadata_);
+}
+vector<Node_Id> Querier::get_filtered_descendant_ids(Node_Id node,
+        const Traversal_Filter& filter) const {
+    PERF_SCOPE(PERF_QUERY);
+    return graph_->get_all_descendants(node, filter, metadata_);
+}
+vector<vector<Node_Id>> Querier::all_path_ids(Node_Id source, Node_Id sink) const {
+    PERF_SCOPE(PERF_QUERY);
+    return graph_->get_all_paths(source, sink);
+}
+
+vector<Batch_Result> Querier::run_batch(const vector<Batch_Request>& requests) const {
+    PERF_SCOPE(PERF_QUERY);
+    vector<Batch_Result> results(requests.size());
+    map<pair<Query_Type, Node_Id>, size_t> first_seen;
+    vector<size_t> duplicate_of(requests.size());
+    // closures still to compute, by direction
+    vector<size_t> pending[2];
+    vector<Node_Id> nodes(requests.size());
+    static thread_local Bfs_Scratch scratch;
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+        Node_Id node = nodes[i] = metadata_->get_node_id(requests[i].identifier);
+        auto key = make_pair(requests[i].type, node);
+        auto first = first_seen.find(key);
+        if (first != first_seen.end()) {
+            duplicate_of[i] = first->second;
+            continue;
+        }
+        first_seen[key] = i;
+        duplicate_of[i] = i;
+        switch (requests[i].type) {
+        case DIRECT_ANCESTORS:
+            results[i].nodes = graph_->get_incoming_edges(node);
+            break;
+        case DIRECT_DESCENDANTS:
+            results[i].nodes = graph_->get_outgoing_edges(node);
+            break;
+        case ALL_ANCESTORS:
+        case COUNT_ANCESTORS:
+            pending[0].push_back(i);
+            break;
+        case ALL_DESCENDANTS:
+        case COUNT_DESCENDANTS:
+            pending[1].push_back(i);
+            break;
+        }
+        results[i].count = results[i].nodes.size();
+    }
+
+    for (int is_fwd = 0; is_fwd < 2; ++is_fwd) {
+        vector<size_t>& todo = pending[is_fwd];
+        for (size_t begin = 0; begin < todo.size(); begin += Graph::BFS_LANES) {
+            size_t end = min(todo.size(), begin + Graph::BFS_LANES);
+            vector<Node_Id> sources;
+            for (size_t j = begin; j < end; ++j) {
+                sources.push_back(nodes[todo[j]]);
+            }
+            auto closures = graph_->multi_source_bfs(sources, is_fwd,
+                    scratch);
+            for (size_t j = begin; j < end; ++j) {
+                Batch_Result& result = results[todo[j]];
+                result.count = closures[j - begin].size();
+                Query_Type type = requests[todo[j]].type;
+                if (type == ALL_ANCESTORS || type == ALL_DESCENDANTS) {
+                    result.nodes.swap(closures[j - begin]);
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (duplicate_of[i] != i) {
+            results[i] = results[duplicate_of[i]];
+        }
+    }
+    return results;
+}
@@ -1,45 +1,202 @@
 #ifndef QUERY_H
 #define QUERY_H
 
+#include <memory>
+
 #include "helpers.hh"
 #include "metadata.hh"
 #include "graph.hh"
+#include "cached_graph.hh"
+#include "csr_graph.hh"
 
 /*
     SUPPORTED QUERIES:
     direct_ancestor(identifier) => return identifier
     all_ancestors(identifier) => return list of identifiers
     all_descendants(identifier) => return list of identifiers
+    filtered_ancestors(identifier, filter) => return list of identifiers
+    filtered_descendants(identifier, filter) => return list of identifiers
+    ancestors_between(identifier, t_from, t_to) => return list of identifiers
+    descendants_between(identifier, t_from, t_to) => return list of identifiers
+    k_hop_ancestors(identifier, k) => return list of identifiers
+    k_hop_descendants(identifier, k) => return list of identifiers
+    neighborhood(identifier, k) => return identifiers and edges within k hops
+    count_ancestors(identifier[, filter]) => return number of ancestors
+    count_descendants(identifier[, filter]) => return number of descendants
+    count_paths(source, sink) => return number of paths
+    ancestor_exists(identifier, filter) => return whether any ancestor matches
+    descendant_exists(identifier, filter) => return whether any descendant matches
+    path_exists(source, sink) => return whether sink is reachable from source
     all_paths(source, sink) => return list of list of identifiers
     friends(identifier) => return list of identifiers (is this a useful query to support?)
     metadata(identifier) => return (JSON output?) of identifier
+
+    Most traversals also have a *_ids form that takes and returns Node_Ids,
+    so that chained queries can stay in integer space; resolve_node and
+    resolve_identifiers convert at the edges.
  */
 
+// Nodes and (src, dest) edges within some number of hops of a node
+struct Neighborhood {
+    vector<string> nodes;
+    vector<pair<string, string>> edges;
+};
+
+enum Query_Type {
+    ALL_ANCESTORS,
+    DIRECT_ANCESTORS,
+    ALL_DESCENDANTS,
+    DIRECT_DESCENDANTS,
+    COUNT_ANCESTORS,
+    COUNT_DESCENDANTS,
+};
+
+struct Batch_Request {
+    Query_Type type;
+    string identifier;
+};
+
+// Result nodes for the listing queries, and their number for all queries
+struct Batch_Result {
+    vector<Node_Id> nodes;
+    size_t count;
+};
+
+/*
+ * Nothing a Querier reads changes after construction, so one instance may
+ * answer queries from any number of threads at once.
+ */
 class Querier {
 public:
-    Querier() {};
-    map<string, string> get_metadata(string& identifier);
-    vector<string> get_all_ancestors(string& identifier);
-    vector<string> get_direct_ancestors(string& identifier);
-    vector<string> get_all_descendants(string& identifier);
-    vector<string> get_direct_descendants(string& identifier);
-    vector<vector<string>> all_paths(string& sourceid, string& sinkid);
-    map<string, vector<string>> friends_of(string&, string&);
-    vector<string> get_node_ids();
+    Querier() : metadata_(nullptr), graph_(nullptr) {};
+    virtual ~Querier() {}
+    map<string, string> get_metadata(string& identifier) const;
+    vector<string> get_all_ancestors(string& identifier) const;
+    vector<string> get_direct_ancestors(string& identifier) const;
+    vector<string> get_all_descendants(string& identifier) const;
+    vector<string> get_direct_descendants(string& identifier) const;
+    vector<string> get_filtered_ancestors(string& identifier,
+            const Traversal_Filter& filter) const;
+    vector<string> get_filtered_descendants(string& identifier,
+            const Traversal_Filter& filter) const;
+    vector<string> get_ancestors_between(string& identifier, time_t t_from,
+            time_t t_to) const;
+    vector<string> get_descendants_between(string& identifier, time_t t_from,
+            time_t t_to) const;
+    vector<string> get_k_hop_ancestors(string& identifier, size_t k) const;
+    vector<string> get_k_hop_descendants(string& identifier, size_t k) const;
+    size_t count_k_hop_ancestors(string& identifier, size_t k) const;
+    size_t count_k_hop_descendants(string& identifier, size_t k) const;
+    Neighborhood get_neighborhood(string& identifier, size_t k) const;
+    pair<size_t, size_t> get_neighborhood_size(string& identifier,
+            size_t k) const;
+    size_t count_ancestors(string& identifier,
+            const Traversal_Filter& filter = Traversal_Filter()) const;
+    size_t count_descendants(string& identifier,
+            const Traversal_Filter& filter = Traversal_Filter()) const;
+    size_t count_paths(string& sourceid, string& sinkid) const;
+    bool ancestor_exists(string& identifier,
+            const Traversal_Filter& filter) const;
+    bool descendant_exists(string& identifier,
+            const Traversal_Filter& filter) const;
+    bool path_exists(string& sourceid, string& sinkid) const;
+    vector<vector<string>> all_paths(string& sourceid, string& sinkid) const;
+    map<string, vector<string>> friends_of(string&, string&) const;
+    vector<string> get_node_ids() const;
+    Traversal_Filter make_type_filter(const vector<string>& edge_types,
+            const vector<string>& node_types,
+            const vector<string>& via_types = {}) const;
+
+    bool has_node(const string& identifier) const;
+    Node_Id resolve_node(string& identifier) const;
+    void resolve_identifiers(const Node_Id* nodes, size_t count,
+            Identifier_Arena& arena) const;
+    vector<Node_Id> get_all_ancestor_ids(Node_Id node) const;
+    vector<Node_Id> get_direct_ancestor_ids(Node_Id node) const;
+    vector<Node_Id> get_all_descendant_ids(Node_Id node) const;
+    vector<Node_Id> get_direct_descendant_ids(Node_Id node) const;
+    vector<Node_Id> get_filtered_ancestor_ids(Node_Id node,
+            const Traversal_Filter& filter) const;
+    vector<Node_Id> get_filtered_descendant_ids(Node_Id node,
+            const Traversal_Filter& filter) const;
+    vector<vector<Node_Id>> all_path_ids(Node_Id source, Node_Id sink) const;
+
+    // Answers many requests together. Repeated requests are answered once,
+    // and closures are computed BFS_LANES sources at a time.
+    vector<Batch_Result> run_batch(const vector<Batch_Request>& requests) const;
+
+    // Counters for the adjacency cache, if the querier has one
+    Cache_Stats cache_stats() const;
+    // Decoding done since the last reset_stats(), on all threads. The
+    // counters are the process's, so they cover every querier in it.
+    Decode_Stats stats() const;
+    void reset_stats() const;
     
 protected:
-    Metadata* metadata_;
-    Graph* graph_;
+    // What queries read, each perhaps a layer over others; a subclass owns
+    // the layers it builds
+    const Metadata* metadata_;
+    const Graph* graph_;
+    std::unique_ptr<const CachedGraph> cache_;
+
+    // Puts a cache of decoded neighbor lists in front of graph_.
+    void add_cache(size_t budget_bytes);
+    vector<string> to_identifiers(const vector<Node_Id>& nodes) const;
 };
 
+class JsonGraph;
+
 class DummyQuerier : public Querier {
 public:
-    DummyQuerier(string& auditfile);
+    DummyQuerier(string& auditfile, size_t cache_bytes = 0);
+    ~DummyQuerier();
+
+private:
+    std::unique_ptr<const JsonGraph> json_;
+};
+
+/*
+ * Whether a CompressedQuerier decodes neighbor lists from the compressed
+ * graph on every lookup, or decodes the whole graph up front.
+ */
+enum Resident_Mode {
+    COMPRESSED_RESIDENT,
+    DECODED_RESIDENT,
 };
 
+class Graph_V2;
+struct Segment;
+class Segmented_Metadata;
+class Segmented_Graph;
+
 class CompressedQuerier: public Querier {
 public:
-    CompressedQuerier(string& metafile, string& graphfile);
+    CompressedQuerier(string& metafile, string& graphfile,
+            size_t cache_bytes = 0, Resident_Mode mode = COMPRESSED_RESIDENT);
+    // Reads everything from one archive (compression/archive.py), which
+    // stays mapped for the life of the querier. If validate is set, every
+    // section's checksum is checked before anything is read.
+    CompressedQuerier(string& archivefile, size_t cache_bytes = 0,
+            Resident_Mode mode = COMPRESSED_RESIDENT, bool validate = false);
+    ~CompressedQuerier();
+    // Decode throughput, if the graph was decoded up front
+    Csr_Stats decode_stats() const;
+    // Checksum throughput, if the archive was validated
+    Validate_Stats validate_stats() const { return validate_stats_; }
+
+private:
+    // declared so that each is freed before what it reads from
+    std::unique_ptr<const Archive> archive_;
+    std::unique_ptr<const CompressedMetadata> compressed_metadata_;
+    std::unique_ptr<const Graph_V2> compressed_graph_;
+    std::unique_ptr<const CsrGraph> csr_;
+    std::vector<std::unique_ptr<const Segment>> segments_;
+    std::unique_ptr<const Segmented_Metadata> segmented_metadata_;
+    std::unique_ptr<const Segmented_Graph> segmented_graph_;
+    Validate_Stats validate_stats_;
+
+    void init_graph(Graph_V2* graph, Resident_Mode mode);
+    void add_segments();
 };
 
 #endif /* QUERY_H */
@@ -1,16 +1,28 @@
+#include <memory>
+#include <unistd.h>
+
 #include "helpers.hh"
 #include "queriers.hh"
+#include "server.hh"
 #include "clp.h"
 
 string metafile = "../compression/compressed_metadata.txt";
 string graphfile = "../compression/graph.cpg";
 string auditfile = "/tmp/audit.log";
+string archivefile;
 
 enum {
     opt_metafile = 1,
     opt_query,
     opt_graphfile,
     opt_auditfile,
+    opt_server,
+    opt_socket,
+    opt_threads,
+    opt_cache,
+    opt_decoded,
+    opt_archive,
+    opt_validate,
     opt_help,
 };
 static const Clp_Option options[] = {
@@ -19,6 +31,15 @@ static const Clp_Option options[] = {
   { "cmetafile", 0, opt_metafile, Clp_ValString, Clp_Optional },
   { "cgraphfile", 0, opt_graphfile, Clp_ValString, Clp_Optional },
   { "auditfile", 0, opt_auditfile, Clp_ValString, Clp_Optional },
+  { "server", 0, opt_server, 0, 0 },
+  { "socket", 0, opt_socket, Clp_ValString, Clp_Optional },
+  { "threads", 0, opt_threads, Clp_ValInt, Clp_Optional },
+  { "cache", 0, opt_cache, Clp_ValInt, Clp_Optional },
+#if COMPRESSED
+  { "decoded", 0, opt_decoded, 0, 0 },
+  { "archive", 0, opt_archive, Clp_ValString, Clp_Optional },
+  { "validate", 0, opt_validate, 0, 0 },
+#endif
 };
 
 static void help() {
@@ -26,16 +47,40 @@ static void help() {
 Options:\n\
  -h, --help\n\
  -c, --compressed\n\
- --query=[0-6] (default: 0)\n\
+ --query=[0-15] (default: 0)\n\
  --cmetafile=metafile (default: %s)\n\
  --cgraphfile=graphfile (default: %s)\n\
- --auditfile=auditfile(default: %s)\n",
+ --auditfile=auditfile(default: %s)\n\
+ --server (answer JSON requests on stdin, one per line)\n\
+ --socket=path (answer JSON requests on a Unix socket)\n\
+ --threads=N (server worker threads, default: 4)\n\
+ --cache=MB (cache decoded neighbor lists, default: 0)\n",
     metafile.c_str(), graphfile.c_str(), auditfile.c_str());
+#if COMPRESSED
+  printf("\
+ --decoded (decode the whole compressed graph at startup)\n\
+ --archive=archive (read the compressed trace from one archive instead)\n\
+ --validate (check every section of the archive at startup)\n");
+#endif
   exit(1);
 }
 
+static void print_cache_stats(const Cache_Stats& stats) {
+    fprintf(stderr, "Cache: %zu hits, %zu misses, %zu evictions, "
+            "%zu entries, %zu bytes\n", stats.hits, stats.misses,
+            stats.evictions, stats.entries, stats.bytes);
+}
+
 int main(int argc, char *argv[]) {
     int query = 0;
+    bool server = false;
+    string socket_path;
+    int nthreads = 4;
+    size_t cache_bytes = 0;
+#if COMPRESSED
+    Resident_Mode mode = COMPRESSED_RESIDENT;
+    bool validate = false;
+#endif
 
     Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
 
@@ -57,6 +102,30 @@ int main(int argc, char *argv[]) {
     case opt_auditfile:
         auditfile = clp->val.s;
         break;
+    case opt_server:
+        server = true;
+        break;
+    case opt_socket:
+        server = true;
+        socket_path = clp->val.s;
+        break;
+    case opt_threads:
+        nthreads = clp->val.i;
+        break;
+    case opt_cache:
+        cache_bytes = (size_t)clp->val.i << 20;
+        break;
+#if COMPRESSED
+    case opt_decoded:
+        mode = DECODED_RESIDENT;
+        break;
+    case opt_archive:
+        archivefile = clp->val.s;
+        break;
+    case opt_validate:
+        validate = true;
+        break;
+#endif
     default:
         help();
     }
@@ -64,21 +133,64 @@ int main(int argc, char *argv[]) {
     Clp_DeleteParser(clp);
    
 #if COMPRESSED
-    fprintf(stderr,"\
+    unique_ptr<CompressedQuerier> qp;
+    if (archivefile.empty()) {
+        fprintf(stderr,"\
         Using Compressed Metadata %s\n\
         Using Compressed Graph %s\n\
         %d reps\n",
-        metafile.c_str(), graphfile.c_str(), NUM_REPS);
-    cout << "Query " << query << endl;
-    CompressedQuerier q(metafile, graphfile);
+            metafile.c_str(), graphfile.c_str(), NUM_REPS);
+    } else {
+        fprintf(stderr,"\
+        Using Archive %s\n\
+        %d reps\n",
+            archivefile.c_str(), NUM_REPS);
+    }
+    try {
+        if (archivefile.empty()) {
+            qp.reset(new CompressedQuerier(metafile, graphfile, cache_bytes,
+                        mode));
+        } else {
+            qp.reset(new CompressedQuerier(archivefile, cache_bytes, mode,
+                        validate));
+        }
+    } catch (const std::exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    CompressedQuerier& q = *qp;
+    if (validate && !archivefile.empty()) {
+        Validate_Stats stats = q.validate_stats();
+        fprintf(stderr, "Validated %zu sections, %zu bytes in %.4f s "
+                "(%.2f GB/s, %s)\n", stats.sections, stats.bytes,
+                stats.seconds, stats.bytes_per_sec() / 1e9, stats.checksum);
+    }
+    if (mode == DECODED_RESIDENT) {
+        Csr_Stats stats = q.decode_stats();
+        fprintf(stderr, "Decoded %zu edges with %zu threads in %.3f s "
+                "(%.0f edges/sec)\n", stats.edges, stats.threads,
+                stats.seconds, stats.edges_per_sec());
+    }
 #else
     fprintf(stderr,"\
         Using Auditfile %s\n\
         %d reps\n",
         auditfile.c_str(), NUM_REPS);
-    cout << "Query " << query << endl;
-    DummyQuerier q(auditfile);
+    DummyQuerier q(auditfile, cache_bytes);
 #endif
+
+    if (server) {
+        Query_Server s(q, nthreads);
+        if (!socket_path.empty()) {
+            return s.serve_socket(socket_path) < 0;
+        }
+        s.serve(STDIN_FILENO, STDOUT_FILENO);
+        if (cache_bytes) {
+            print_cache_stats(q.cache_stats());
+        }
+        return 0;
+    }
+    cout << "Query " << query << endl;
     
     vector<std::chrono::nanoseconds::rep> times;
     int vm_usage = 0;
@@ -118,6 +230,73 @@ int main(int argc, char *argv[]) {
             }
         }
     }
+    // filtered ancestors (via write/exec edges) and descendants (file nodes)
+    else if (query == 7 || query == 8) {
+        Traversal_Filter filter = (query == 7) ?
+            q.make_type_filter({"write", "exec"}, {}) :
+            q.make_type_filter({}, {"file"});
+        for (unsigned i = 0; i < ids.size(); i+= ids.size()/10) {
+            if (query == 7) {
+                times.push_back(measure<>::execution(q, &Querier::get_filtered_ancestors, ids[i], filter));
+            } else {
+                times.push_back(measure<>::execution(q, &Querier::get_filtered_descendants, ids[i], filter));
+            }
+            vm_usage = max(vm_usage, virtualmem_usage());
+        }
+    }
+    // ancestors dated within the hour before the node itself
+    else if (query == 9) {
+        for (unsigned i = 0; i < ids.size(); i+= ids.size()/10) {
+            time_t t = 0;
+            parse_cf_date(q.get_metadata(ids[i])["cf:date"], t);
+            times.push_back(measure<>::execution(q, &Querier::get_ancestors_between, ids[i], t - 3600, t));
+            vm_usage = max(vm_usage, virtualmem_usage());
+        }
+    }
+    // 2-hop ancestors and 2-hop neighborhoods
+    else if (query == 10 || query == 11) {
+        for (unsigned i = 0; i < ids.size(); i+= ids.size()/10) {
+            if (query == 10) {
+                times.push_back(measure<>::execution(q, &Querier::get_k_hop_ancestors, ids[i], 2));
+            } else {
+                times.push_back(measure<>::execution(q, &Querier::get_neighborhood, ids[i], 2));
+            }
+            vm_usage = max(vm_usage, virtualmem_usage());
+        }
+    }
+    // counted ancestors and descendants, and whether a task is an ancestor
+    else if (query == 12 || query == 13) {
+        Traversal_Filter filter;
+        if (query == 13) {
+            filter = q.make_type_filter({}, {"task"});
+        }
+        for (unsigned i = 0; i < ids.size(); i+= ids.size()/10) {
+            if (query == 12) {
+                times.push_back(measure<>::execution(q, &Querier::count_descendants, ids[i], filter));
+            } else {
+                times.push_back(measure<>::execution(q, &Querier::ancestor_exists, ids[i], filter));
+            }
+            vm_usage = max(vm_usage, virtualmem_usage());
+        }
+    }
+    // counted paths
+    else if (query == 14) {
+        for (unsigned i = 0; i < ids.size(); i+=ids.size()/10) {
+            for (unsigned j = 10; j < ids.size(); j+=ids.size()/10) {
+                times.push_back(measure<>::execution(q, &Querier::count_paths, ids[i], ids[j]));
+                vm_usage = max(vm_usage, virtualmem_usage());
+            }
+        }
+    }
+    // one batch of ancestor queries over every node
+    else if (query == 15) {
+        vector<Batch_Request> requests;
+        for (auto id : ids) {
+            requests.push_back({ALL_ANCESTORS, id});
+        }
+        times.push_back(measure<>::execution(q, &Querier::run_batch, requests));
+        vm_usage = max(vm_usage, virtualmem_usage());
+    }
     // all other queries
     else {
         cerr << "RUNNING QUERY " << query << endl;
@@ -153,5 +332,8 @@ int main(int argc, char *argv[]) {
         cout << t <<  ", ";
     }
     cout << endl<< "VM:" << vm_usage << endl;
+    if (cache_bytes) {
+        print_cache_stats(q.cache_stats());
+    }
     return 0;
 }
@@ -0,0 +1,444 @@
+#include <functional>
+
+#include "json/json.h"
+#include "perf_counters.hh"
+#include "queriers.hh"
+
+/*
+ * Times queries against a compressed trace and against the JSON log it was
+ * compressed from, side by side in one process: both backends are loaded,
+ * and each query runs on the same sample of nodes on each in turn, after
+ * warmup rounds that are not timed. Each call is timed on its own; for each
+ * backend and query this reports p50, p90, p99 and max latency, throughput,
+ * and the number of results (which should agree between backends). Also
+ * reported are each backend's load time and the resident memory it took,
+ * the peak resident memory while its queries ran, and the peak for the
+ * whole run. --json writes all of it to a file as well.
+ *
+ * Decoder counters (Querier::stats) are reported per query as well: bits
+ * read, graph groups decoded, collapsed groups expanded and metadata
+ * records decoded, per call.
+ *
+ * Built with PERFCOUNT=1, it also reports hardware counters per query, for
+ * the Querier call as a whole and for the get_edges and get_metadata calls
+ * under it (see perf_counters.hh).
+ *
+ * Queries are numbered as for query --query. Either backend may be left
+ * out.
+ *
+ * Usage: ./query_bench [--archive=FILE | --cmetafile=FILE --cgraphfile=FILE]
+ *            [--auditfile=FILE] [--queries=N,N,...] [--samples=N]
+ *            [--reps=N] [--warmup=N] [--cache=MB] [--decoded] [--json=FILE]
+ */
+
+static const char* QUERY_NAMES[] = {
+    "metadata", "all_ancestors", "direct_ancestors", "all_descendants",
+    "direct_descendants", "friends_of", "all_paths", "filtered_ancestors",
+    "filtered_descendants", "ancestors_between", "k_hop_ancestors",
+    "neighborhood", "count_descendants", "ancestor_exists", "count_paths",
+    "batch_ancestors",
+};
+static const int NUM_QUERIES = sizeof(QUERY_NAMES) / sizeof(QUERY_NAMES[0]);
+
+struct Backend {
+    string name;
+    string source;
+    Querier* querier;
+    double load_seconds;
+    int load_rss_kb;
+    // for queries 7, 8 and 13, whose type codes are each backend's own
+    Traversal_Filter write_exec;
+    Traversal_Filter to_file;
+    Traversal_Filter task;
+    Json::Value results;
+};
+
+struct Call {
+    string a;
+    string b;
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+// Decoding per call, as a table row and as JSON
+static void report_decoding(const Decode_Stats& s, size_t calls,
+        const string& backend, int query, vector<string>& rows,
+        Json::Value& result) {
+    double n = max<size_t>(calls, 1);
+    char row[256];
+    snprintf(row, sizeof(row), "%-10s %-3d %-20s %12.1f %10.1f %10.1f %10.1f "
+            "%10.1f %9zu", backend.c_str(), query, QUERY_NAMES[query],
+            s.bits_read / n, s.groups_decoded / n, s.collapsed_expansions / n,
+            s.metadata_records / n, s.relative_records / n,
+            s.max_relative_depth);
+    rows.push_back(row);
+    Json::Value decoding;
+    decoding["bits_read"] = (Json::UInt64) s.bits_read;
+    decoding["groups_decoded"] = (Json::UInt64) s.groups_decoded;
+    decoding["collapsed_expansions"] = (Json::UInt64) s.collapsed_expansions;
+    decoding["metadata_records"] = (Json::UInt64) s.metadata_records;
+    decoding["relative_records"] = (Json::UInt64) s.relative_records;
+    decoding["max_relative_depth"] = (Json::UInt64) s.max_relative_depth;
+    result["decoding"] = decoding;
+}
+
+#ifdef PERF_COUNTERS
+// Counts per call for each region, as table rows and as JSON
+static void report_counters(const Perf_Totals& totals, const string& backend,
+        int query, vector<string>& rows, Json::Value& result) {
+    for (int r = 0; r < NUM_PERF_REGIONS; ++r) {
+        uint64_t calls = totals.calls[r];
+        char row[256];
+        int len = snprintf(row, sizeof(row), "%-10s %-3d %-20s %-12s %9llu",
+                backend.c_str(), query, QUERY_NAMES[query],
+                perf_region_name((Perf_Region) r),
+                (unsigned long long) calls);
+        Json::Value region;
+        region["calls"] = (Json::UInt64) calls;
+        for (int e = 0; e < NUM_PERF_EVENTS; ++e) {
+            uint64_t count = totals.counts[r][e];
+            if (!totals.available[e]) {
+                len += snprintf(row + len, sizeof(row) - len, " %12s", "-");
+                region[perf_event_name((Perf_Event) e)] = Json::Value();
+                continue;
+            }
+            double per_call = calls ? (double) count / calls : 0;
+            if (e == PERF_TASK_CLOCK) {
+                per_call /= 1000;
+            }
+            len += snprintf(row + len, sizeof(row) - len, " %12.1f",
+                    per_call);
+            region[perf_event_name((Perf_Event) e)] = (Json::UInt64) count;
+        }
+        uint64_t cycles = totals.counts[r][PERF_CYCLES];
+        if (totals.available[PERF_CYCLES] &&
+                totals.available[PERF_INSTRUCTIONS] && cycles) {
+            snprintf(row + len, sizeof(row) - len, " %6.2f",
+                    (double) totals.counts[r][PERF_INSTRUCTIONS] / cycles);
+        } else {
+            snprintf(row + len, sizeof(row) - len, " %6s", "-");
+        }
+        if (calls) {
+            rows.push_back(row);
+        }
+        result["perf"][perf_region_name((Perf_Region) r)] = region;
+    }
+}
+#endif
+
+static double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[min(sorted.size() - 1, (size_t) (p * sorted.size()))];
+}
+
+// The node's cf:date, or 0
+static time_t node_time(const Querier& q, string& id) {
+    time_t t = 0;
+    parse_cf_date(dict_get(q.get_metadata(id), string("cf:date")), t);
+    return t;
+}
+
+// Runs one query, returning the number of results
+static size_t run_query(const Backend& b, int query, Call& call,
+        const vector<Batch_Request>& batch) {
+    const Querier& q = *b.querier;
+    switch (query) {
+        case 0:
+            return q.get_metadata(call.a).size();
+        case 1:
+            return q.get_all_ancestors(call.a).size();
+        case 2:
+            return q.get_direct_ancestors(call.a).size();
+        case 3:
+            return q.get_all_descendants(call.a).size();
+        case 4:
+            return q.get_direct_descendants(call.a).size();
+        case 5:
+            return q.friends_of(call.a, call.b).size();
+        case 6:
+            return q.all_paths(call.a, call.b).size();
+        case 7:
+            return q.get_filtered_ancestors(call.a, b.write_exec).size();
+        case 8:
+            return q.get_filtered_descendants(call.a, b.to_file).size();
+        case 9: {
+            time_t t = atol(call.b.c_str());
+            return q.get_ancestors_between(call.a, t - 3600, t).size();
+        }
+        case 10:
+            return q.get_k_hop_ancestors(call.a, 2).size();
+        case 11:
+            return q.get_neighborhood(call.a, 2).nodes.size();
+        case 12:
+            return q.count_descendants(call.a);
+        case 13:
+            return q.ancestor_exists(call.a, b.task);
+        case 14:
+            return q.count_paths(call.a, call.b);
+        case 15:
+            return q.run_batch(batch).size();
+        default:
+            assert(0);
+            return 0;
+    }
+}
+
+static vector<Call> make_calls(const Backend& b, int query,
+        vector<string>& nodes, const vector<string>& files,
+        const vector<string>& tasks) {
+    vector<Call> calls;
+    if (query == 5) {
+        for (size_t i = 0; i < nodes.size() && !files.empty() &&
+                !tasks.empty(); ++i) {
+            calls.push_back({files[i % files.size()],
+                    tasks[i % tasks.size()]});
+        }
+    } else if (query == 15) {
+        calls.push_back({"", ""});
+    } else {
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            Call call = {nodes[i],
+                nodes[(i + nodes.size() / 2) % nodes.size()]};
+            if (query == 9) {
+                call.b = to_string(node_time(*b.querier, nodes[i]));
+            }
+            calls.push_back(call);
+        }
+    }
+    return calls;
+}
+
+static void add_backend(vector<Backend>& backends, const string& name,
+        const string& source, std::function<Querier*()> load) {
+    Backend b;
+    b.name = name;
+    b.source = source;
+    int rss = resident_usage();
+    auto start = std::chrono::steady_clock::now();
+    b.querier = load();
+    b.load_seconds = seconds_since(start);
+    b.load_rss_kb = resident_usage() - rss;
+    b.write_exec = b.querier->make_type_filter({"write", "exec"}, {});
+    b.to_file = b.querier->make_type_filter({}, {"file"});
+    b.task = b.querier->make_type_filter({}, {"task"});
+    backends.push_back(b);
+}
+
+int main(int argc, char* argv[]) {
+    string archivefile, metafile, graphfile, auditfile, jsonfile;
+    vector<int> queries = {0, 1, 2, 3, 4};
+    size_t samples = 100, reps = 10, warmup = 2, cache_bytes = 0;
+    Resident_Mode mode = COMPRESSED_RESIDENT;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        string val = arg.substr(arg.find('=') + 1);
+        if (arg.find("--archive=") == 0) {
+            archivefile = val;
+        } else if (arg.find("--cmetafile=") == 0) {
+            metafile = val;
+        } else if (arg.find("--cgraphfile=") == 0) {
+            graphfile = val;
+        } else if (arg.find("--auditfile=") == 0) {
+            auditfile = val;
+        } else if (arg.find("--queries=") == 0) {
+            queries.clear();
+            for (auto& q : split(val, ',')) {
+                queries.push_back(atoi(q.c_str()));
+            }
+        } else if (arg.find("--samples=") == 0) {
+            samples = max(1, atoi(val.c_str()));
+        } else if (arg.find("--reps=") == 0) {
+            reps = max(1, atoi(val.c_str()));
+        } else if (arg.find("--warmup=") == 0) {
+            warmup = atoi(val.c_str());
+        } else if (arg.find("--cache=") == 0) {
+            cache_bytes = (size_t) atoi(val.c_str()) << 20;
+        } else if (arg == "--decoded") {
+            mode = DECODED_RESIDENT;
+        } else if (arg.find("--json=") == 0) {
+            jsonfile = val;
+        } else {
+            queries.clear();
+            break;
+        }
+    }
+    bool compressed = !archivefile.empty() ||
+        (!metafile.empty() && !graphfile.empty());
+    bool bad_query = false;
+    for (int q : queries) {
+        bad_query = bad_query || q < 0 || q >= NUM_QUERIES;
+    }
+    if ((!compressed && auditfile.empty()) || queries.empty() || bad_query) {
+        cerr << "Usage: ./query_bench [--archive=FILE | --cmetafile=FILE "
+            "--cgraphfile=FILE] [--auditfile=FILE] [--queries=N,N,...] "
+            "[--samples=N] [--reps=N] [--warmup=N] [--cache=MB] [--decoded] "
+            "[--json=FILE]" << endl;
+        return 1;
+    }
+
+    vector<Backend> backends;
+    if (!archivefile.empty()) {
+        add_backend(backends, "compressed", archivefile, [&] {
+            return new CompressedQuerier(archivefile, cache_bytes, mode);
+        });
+    } else if (compressed) {
+        add_backend(backends, "compressed", graphfile, [&] {
+            return new CompressedQuerier(metafile, graphfile, cache_bytes,
+                    mode);
+        });
+    }
+    if (!auditfile.empty()) {
+        add_backend(backends, "json", auditfile, [&] {
+            return new DummyQuerier(auditfile, cache_bytes);
+        });
+    }
+
+    // nodes spread over the first backend's, that every backend has
+    vector<string> ids = backends[0].querier->get_node_ids();
+    sort(ids.begin(), ids.end());
+    vector<string> nodes, files, tasks;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        bool everywhere = true;
+        for (auto& b : backends) {
+            everywhere = everywhere && b.querier->has_node(ids[i]);
+        }
+        if (!everywhere) {
+            continue;
+        }
+        if (i * samples / ids.size() != (i + 1) * samples / ids.size()) {
+            nodes.push_back(ids[i]);
+        }
+        string type = dict_get(backends[0].querier->get_metadata(ids[i]),
+                string("cf:type"));
+        if (type == "file_name") {
+            files.push_back(ids[i]);
+        } else if (type == "task") {
+            tasks.push_back(ids[i]);
+        }
+    }
+    vector<Batch_Request> batch;
+    for (auto& id : nodes) {
+        batch.push_back({ALL_ANCESTORS, id});
+    }
+
+    // the peak is reset for each query, so the peak of the whole run is
+    // the highest of the peaks before each reset
+    int peak = 0;
+    // decoder and hardware counter rows, printed after the latencies
+    vector<string> decode_rows, counter_rows;
+    printf("%-10s %-3s %-20s %7s %10s %10s %10s %10s %12s %10s\n", "backend",
+            "q", "query", "calls", "p50 us", "p90 us", "p99 us", "max us",
+            "queries/s", "results");
+    for (int query : queries) {
+        for (auto& b : backends) {
+            vector<Call> calls = make_calls(b, query, nodes, files, tasks);
+            size_t results = 0;
+            for (size_t r = 0; r < warmup; ++r) {
+                for (auto& call : calls) {
+                    run_query(b, query, call, batch);
+                }
+            }
+            int rss = resident_usage();
+            peak = max(peak, peak_resident_usage());
+            reset_peak_resident_usage();
+            vector<double> latencies;
+            double total = 0;
+            b.querier->reset_stats();
+#ifdef PERF_COUNTERS
+            perf_reset();
+#endif
+            for (size_t r = 0; r < reps; ++r) {
+                for (auto& call : calls) {
+                    auto start = std::chrono::steady_clock::now();
+                    size_t n = run_query(b, query, call, batch);
+                    double seconds = seconds_since(start);
+                    latencies.push_back(seconds * 1e6);
+                    total += seconds;
+                    if (r == 0) {
+                        results += n;
+                    }
+                }
+            }
+            int run_rss = peak_resident_usage() - rss;
+            Decode_Stats decoded = b.querier->stats();
+#ifdef PERF_COUNTERS
+            Perf_Totals counters = perf_totals();
+#endif
+            sort(latencies.begin(), latencies.end());
+            double qps = total ? latencies.size() / total : 0;
+
+            printf("%-10s %-3d %-20s %7zu %10.2f %10.2f %10.2f %10.2f "
+                    "%12.0f %10zu\n", b.name.c_str(), query,
+                    QUERY_NAMES[query], latencies.size(),
+                    percentile(latencies, 0.5), percentile(latencies, 0.9),
+                    percentile(latencies, 0.99), percentile(latencies, 1.0),
+                    qps, results);
+            Json::Value result;
+            result["query"] = query;
+            result["name"] = QUERY_NAMES[query];
+            result["calls"] = (Json::UInt64) latencies.size();
+            result["p50_us"] = percentile(latencies, 0.5);
+            result["p90_us"] = percentile(latencies, 0.9);
+            result["p99_us"] = percentile(latencies, 0.99);
+            result["max_us"] = percentile(latencies, 1.0);
+            result["queries_per_sec"] = qps;
+            result["results"] = (Json::UInt64) results;
+            result["run_peak_rss_kb"] = run_rss;
+            report_decoding(decoded, latencies.size(), b.name, query,
+                    decode_rows, result);
+#ifdef PERF_COUNTERS
+            report_counters(counters, b.name, query, counter_rows, result);
+#endif
+            b.results.append(result);
+        }
+    }
+    printf("\n%-10s %-3s %-20s %12s %10s %10s %10s %10s %9s\n", "backend", "q",
+            "query", "bits", "groups", "expanded", "records", "relatives",
+            "max depth");
+    for (auto& row : decode_rows) {
+        printf("%s\n", row.c_str());
+    }
+    if (!counter_rows.empty()) {
+        printf("\n%-10s %-3s %-20s %-12s %9s %12s %12s %12s %12s %12s %6s\n",
+                "backend", "q", "query", "region", "calls", "clock us",
+                "cycles", "instrs", "llc misses", "br misses", "ipc");
+        for (auto& row : counter_rows) {
+            printf("%s\n", row.c_str());
+        }
+    }
+
+    Json::Value root;
+    root["reps"] = (Json::UInt64) reps;
+    root["warmup"] = (Json::UInt64) warmup;
+    root["samples"] = (Json::UInt64) nodes.size();
+    root["decoded"] = mode == DECODED_RESIDENT;
+    root["cache_bytes"] = (Json::UInt64) cache_bytes;
+    for (auto& b : backends) {
+        printf("%-10s loaded %s in %.3f s, %d KB resident\n", b.name.c_str(),
+                b.source.c_str(), b.load_seconds, b.load_rss_kb);
+        Json::Value backend;
+        backend["name"] = b.name;
+        backend["source"] = b.source;
+        backend["load_seconds"] = b.load_seconds;
+        backend["load_rss_kb"] = b.load_rss_kb;
+        backend["queries"] = b.results;
+        root["backends"].append(backend);
+    }
+    peak = max(peak, peak_resident_usage());
+    printf("peak resident %d KB\n", peak);
+    root["peak_rss_kb"] = peak;
+    if (!jsonfile.empty()) {
+        ofstream out(jsonfile);
+        out << Json::StyledWriter().write(root);
+        if (!out) {
+            cerr << jsonfile << ": " << strerror(errno) << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include <unistd.h>
+
+#include "queriers.hh"
+
+/*
+ * Checks the typed, timed, k-hop, counting and existence queries against
+ * answers worked out by hand for a small trace:
+ *
+ *   t1 -read-> f1 -write-> t2 -read-> f2 -exec-> t3
+ *    |                      |
+ *    +-read-> f3            +-send-> s1
+ *
+ * t* are tasks, f* files and s1 a socket. Edges are dated 10, 20, 30, 40,
+ * 50 and 60 seconds in, in the order read off left to right and top to
+ * bottom (t1 -> f3 is 60); each node is dated as its incoming edge, except
+ * that t1 is dated 0, f3 is dated 1000 and s1 is undated.
+ *
+ * Usage: ./query_test
+ */
+
+string tracefile = "/tmp/provquery_query_test.log";
+
+static size_t failures = 0;
+static size_t next_cf_id = 0;
+
+static string date(int sec) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "2016:11:30T00:%02d:%02d", sec / 60, sec % 60);
+    return buf;
+}
+
+static string node(const string& id, const string& typ, int sec) {
+    string record = "\"" + id + "\":{\"cf:id\":\"" + to_string(next_cf_id++) +
+        "\",\"cf:type\":\"" + typ + "\"";
+    if (sec >= 0) {
+        record += ",\"cf:date\":\"" + date(sec) + "\"";
+    }
+    return record + "}";
+}
+
+// used runs from the activity to the entity, wasGeneratedBy the other way
+static string edge(const string& id, const string& entity,
+        const string& activity, const string& typ, int sec) {
+    return "\"" + id + "\":{\"prov:entity\":\"" + entity +
+        "\",\"prov:activity\":\"" + activity + "\",\"cf:type\":\"" + typ +
+        "\",\"cf:date\":\"" + date(sec) + "\"}";
+}
+
+static void write_trace() {
+    ofstream out(tracefile);
+    out << "{\"activity\":{" << node("t1", "task", 0) << ","
+        << node("t2", "task", 20) << "," << node("t3", "task", 50) << "},"
+        << "\"entity\":{" << node("f1", "file", 10) << ","
+        << node("f2", "file", 30) << "," << node("f3", "file", 1000) << ","
+        << node("s1", "socket", -1) << "},"
+        << "\"used\":{" << edge("e1", "f1", "t1", "read", 10) << ","
+        << edge("e3", "f2", "t2", "read", 30) << ","
+        << edge("e4", "s1", "t2", "send", 40) << ","
+        << edge("e6", "f3", "t1", "read", 60) << "},"
+        << "\"wasGeneratedBy\":{" << edge("e2", "f1", "t2", "write", 20) << ","
+        << edge("e5", "f2", "t3", "exec", 50) << "}}" << endl;
+}
+
+static void check(const vector<string>& got, vector<string> expected,
+        const string& what) {
+    vector<string> sorted_got(got);
+    sort(sorted_got.begin(), sorted_got.end());
+    sort(expected.begin(), expected.end());
+    if (sorted_got != expected) {
+        cout << "FAILED: " << what << ":";
+        for (auto& id : sorted_got) {
+            cout << " " << id;
+        }
+        cout << endl;
+        ++failures;
+    }
+}
+
+static void check(size_t got, size_t expected, const string& what) {
+    if (got != expected) {
+        cout << "FAILED: " << what << ": " << got << endl;
+        ++failures;
+    }
+}
+
+int main() {
+    write_trace();
+    DummyQuerier q(tracefile);
+    unlink(tracefile.c_str());
+    string t1 = "t1", t3 = "t3", f1 = "f1", f2 = "f2", s1 = "s1";
+    time_t t0 = civil_to_time(2016, 11, 30, 0, 0, 0);
+
+    check(q.get_all_descendants(t1), {"f1", "t2", "f2", "t3", "s1", "f3"},
+            "descendants");
+    check(q.get_all_ancestors(t3), {"f2", "t2", "f1", "t1"}, "ancestors");
+
+    // type filters
+    check(q.get_filtered_descendants(t1, q.make_type_filter({"read"}, {})),
+            {"f1", "f3"}, "edge types");
+    check(q.get_filtered_descendants(t1, q.make_type_filter({}, {"task"})),
+            {"t2", "t3"}, "node types");
+    check(q.get_filtered_descendants(t1, q.make_type_filter({}, {}, {"file"})),
+            {"f1", "f3", "t2"}, "via types");
+    check(q.get_filtered_descendants(t1,
+                q.make_type_filter({"read", "write"}, {"file"})),
+            {"f1", "f2", "f3"}, "edge and node types");
+    check(q.get_filtered_ancestors(t3, q.make_type_filter({}, {"file"})),
+            {"f2", "f1"}, "ancestor node types");
+    check(q.get_filtered_descendants(t1, q.make_type_filter({"nosuch"}, {})),
+            vector<string>(), "unknown type");
+
+    // time windows: dated edges and nodes outside are neither reported nor
+    // followed, undated ones always pass
+    check(q.get_descendants_between(t1, t0, t0 + 35), {"f1", "t2", "f2"},
+            "descendants between");
+    check(q.get_descendants_between(f1, t0 + 15, t0 + 100),
+            {"t2", "f2", "s1", "t3"}, "undated node in window");
+    check(q.get_descendants_between(t1, t0, t0 + 100),
+            {"f1", "t2", "f2", "t3", "s1"}, "node dated outside window");
+    check(q.get_ancestors_between(t3, t0 + 25, t0 + 100), {"f2"},
+            "ancestors between");
+
+    // k hops
+    check(q.get_k_hop_descendants(t1, 1), {"f1", "f3"}, "1 hop descendants");
+    check(q.get_k_hop_descendants(t1, 2), {"f1", "f3", "t2"},
+            "2 hop descendants");
+    check(q.get_k_hop_descendants(t1, 3), {"f1", "f3", "t2", "f2", "s1"},
+            "3 hop descendants");
+    check(q.get_k_hop_ancestors(t3, 2), {"f2", "t2"}, "2 hop ancestors");
+    check(q.get_k_hop_ancestors(t3, 0), vector<string>(), "0 hop ancestors");
+    check(q.count_k_hop_descendants(t1, 2), 3, "count 2 hop descendants");
+    check(q.count_k_hop_ancestors(t3, 3), 3, "count 3 hop ancestors");
+
+    // counts and existence
+    check(q.count_descendants(t1), 6, "count descendants");
+    check(q.count_ancestors(s1), 3, "count ancestors");
+    check(q.count_descendants(t1, q.make_type_filter({}, {"task"})), 2,
+            "count typed descendants");
+    check(q.count_descendants(t3), 0, "count descendants of a sink");
+    check(q.descendant_exists(t1, q.make_type_filter({}, {"socket"})), true,
+            "socket descendant");
+    check(q.descendant_exists(f2, q.make_type_filter({}, {"socket"})), false,
+            "no socket descendant");
+    check(q.ancestor_exists(t3, q.make_type_filter({}, {"task"})), true,
+            "task ancestor");
+    check(q.ancestor_exists(t3, q.make_type_filter({"send"}, {})), false,
+            "no send ancestor");
+    Traversal_Filter early = q.make_type_filter({}, {"socket"});
+    early.t_from = t0;
+    early.t_to = t0 + 35;
+    check(q.descendant_exists(t1, early), false, "no early socket");
+
+    cout << (failures ? "FAIL" : "PASS") << endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,250 @@
+#include "segments.hh"
+
+#include "graph_loader.hh"
+
+using namespace std;
+
+const Node_Id Segment::NO_NODE;
+
+bool Segment::find_local(Node_Id node, Node_Id& local) const {
+    auto it = to_local.find(node);
+    if (it == to_local.end()) {
+        return false;
+    }
+    local = it->second;
+    return true;
+}
+
+bool Segment::find_global(Node_Id local, Node_Id& node) const {
+    if (local >= to_global.size() || to_global[local] == NO_NODE) {
+        return false;
+    }
+    node = to_global[local];
+    return true;
+}
+
+void Segment::add_node(Node_Id local, Node_Id node) {
+    if (local >= to_global.size()) {
+        to_global.resize(local + 1, NO_NODE);
+    }
+    to_global[local] = node;
+    to_local[node] = local;
+}
+
+Archive_Segment::Archive_Segment(const Archive& parent, size_t i)
+    : bytes(parent.map_section(SECTION_SEGMENT, i)),
+      archive("segment " + to_string(i), bytes),
+      compressed(archive, parent) {
+    metadata = &compressed;
+    compressed_graph.reset(load_compressed_graph(
+                archive.map_section(SECTION_GRAPH, 0, false)));
+    graph = compressed_graph.get();
+    BitSet node_map = archive.map_section(SECTION_NODE_MAP);
+    for (Node_Id local = 0; local < compressed.num_nodes; ++local) {
+        Node_Id node;
+        node_map.get_bits(node, 32, local * 32);
+        add_node(local, node);
+    }
+}
+
+Segmented_Metadata::Segmented_Metadata(const Metadata* base,
+        const vector<const Segment*>& segments)
+    : base_(base), segments_(segments) {
+    // interned in the base's order, so that its codes stay the same
+    for (size_t code = 0; code < base->get_type_count(); ++code) {
+        intern_type(base->get_type_name(code));
+    }
+    for (size_t s = 0; s < segments_.size(); ++s) {
+        const Metadata& metadata = *segments_[s]->metadata;
+        types_.emplace_back();
+        for (size_t code = 0; code < metadata.get_type_count(); ++code) {
+            types_.back().push_back(
+                    intern_type(metadata.get_type_name(code)));
+        }
+        for (auto& node : segments_[s]->to_local) {
+            if (node.first < base_->num_nodes) {
+                continue;
+            }
+            size_t i = node.first - base_->num_nodes;
+            if (i >= homes_.size()) {
+                homes_.resize(i + 1, make_pair(segments_.size(), 0));
+            }
+            if (homes_[i].first == segments_.size()) {
+                homes_[i] = make_pair(s, node.second);
+            }
+        }
+    }
+    num_nodes = base_->num_nodes + homes_.size();
+}
+
+Type_Code Segmented_Metadata::translate(size_t segment, Type_Code code) const {
+    return code < types_[segment].size() ? types_[segment][code] : NO_TYPE;
+}
+
+const Metadata* Segmented_Metadata::find(const string& identifier) const {
+    if (base_->has_identifier(identifier)) {
+        return base_;
+    }
+    for (auto segment : segments_) {
+        if (segment->metadata->has_identifier(identifier)) {
+            return segment->metadata;
+        }
+    }
+    return base_;
+}
+
+map<string, string> Segmented_Metadata::get_metadata(
+        string& identifier) const {
+    return find(identifier)->get_metadata(identifier);
+}
+
+Node_Id Segmented_Metadata::get_node_id(string identifier) const {
+    if (!base_->has_identifier(identifier)) {
+        for (auto segment : segments_) {
+            Node_Id node;
+            if (segment->metadata->has_identifier(identifier) &&
+                    segment->find_global(
+                        segment->metadata->get_node_id(identifier), node)) {
+                return node;
+            }
+        }
+    }
+    return base_->get_node_id(identifier);
+}
+
+bool Segmented_Metadata::has_identifier(const string& identifier) const {
+    return find(identifier)->has_identifier(identifier);
+}
+
+// Ids past the nodes are the base's relations.
+string Segmented_Metadata::get_identifier(Node_Id node) const {
+    if (node < base_->num_nodes || node >= num_nodes) {
+        return base_->get_identifier(node);
+    }
+    auto& home = homes_[node - base_->num_nodes];
+    return segments_[home.first]->metadata->get_identifier(home.second);
+}
+
+vector<string> Segmented_Metadata::get_node_ids() const {
+    vector<string> ids = base_->get_node_ids();
+    for (auto& home : homes_) {
+        ids.push_back(segments_[home.first]->metadata->get_identifier(
+                    home.second));
+    }
+    return ids;
+}
+
+Type_Code Segmented_Metadata::get_node_type(Node_Id node) const {
+    if (node < base_->num_nodes) {
+        return base_->get_node_type(node);
+    }
+    if (node >= num_nodes) {
+        return NO_TYPE;
+    }
+    auto& home = homes_[node - base_->num_nodes];
+    return translate(home.first,
+            segments_[home.first]->metadata->get_node_type(home.second));
+}
+
+Type_Code Segmented_Metadata::get_edge_type(Node_Id src,
+        Node_Id dest) const {
+    if (src < base_->num_nodes && dest < base_->num_nodes) {
+        Type_Code code = base_->get_edge_type(src, dest);
+        if (code != NO_TYPE) {
+            return code;
+        }
+    }
+    Node_Id local_src, local_dest;
+    for (size_t s = 0; s < segments_.size(); ++s) {
+        if (segments_[s]->find_local(src, local_src) &&
+                segments_[s]->find_local(dest, local_dest)) {
+            Type_Code code = segments_[s]->metadata->get_edge_type(local_src,
+                    local_dest);
+            if (code != NO_TYPE) {
+                return translate(s, code);
+            }
+        }
+    }
+    return NO_TYPE;
+}
+
+time_t Segmented_Metadata::get_node_time(Node_Id node) const {
+    if (node < base_->num_nodes) {
+        return base_->get_node_time(node);
+    }
+    if (node >= num_nodes) {
+        return NO_TIME;
+    }
+    auto& home = homes_[node - base_->num_nodes];
+    return segments_[home.first]->metadata->get_node_time(home.second);
+}
+
+time_t Segmented_Metadata::get_edge_time(Node_Id src, Node_Id dest) const {
+    if (src < base_->num_nodes && dest < base_->num_nodes) {
+        time_t t = base_->get_edge_time(src, dest);
+        if (t != NO_TIME) {
+            return t;
+        }
+    }
+    Node_Id local_src, local_dest;
+    for (auto segment : segments_) {
+        if (segment->find_local(src, local_src) &&
+                segment->find_local(dest, local_dest)) {
+            time_t t = segment->metadata->get_edge_time(local_src, local_dest);
+            if (t != NO_TIME) {
+                return t;
+            }
+        }
+    }
+    return NO_TIME;
+}
+
+Segmented_Graph::Segmented_Graph(const Graph* base,
+        const Metadata* base_metadata, const vector<const Segment*>& segments,
+        size_t num_nodes)
+    : base_(base), base_metadata_(base_metadata), segments_(segments),
+      num_nodes_(num_nodes) {}
+
+vector<Node_Id> Segmented_Graph::merge_edges(Node_Id node,
+        vector<Node_Id> (Graph::*get_edges)(Node_Id) const) const {
+    assert(node < num_nodes_);
+    vector<Node_Id> edges;
+    if (node < base_->get_node_count()) {
+        edges = (base_->*get_edges)(node);
+    }
+    bool merged = false;
+    Node_Id local;
+    for (auto segment : segments_) {
+        if (!segment->find_local(node, local)) {
+            continue;
+        }
+        for (Node_Id n : (segment->graph->*get_edges)(local)) {
+            edges.push_back(segment->to_global[n]);
+            merged = true;
+        }
+    }
+    if (merged) {
+        sort(edges.begin(), edges.end());
+        edges.erase(unique(edges.begin(), edges.end()), edges.end());
+    }
+    return edges;
+}
+
+vector<Node_Id> Segmented_Graph::get_outgoing_edges(Node_Id node) const {
+    return merge_edges(node, &Graph::get_outgoing_edges);
+}
+
+vector<Node_Id> Segmented_Graph::get_incoming_edges(Node_Id node) const {
+    return merge_edges(node, &Graph::get_incoming_edges);
+}
+
+// Relations are numbered after the base's nodes, so the base's metadata,
+// rather than the merged view's, names them.
+map<string, vector<Node_Id>> Segmented_Graph::friends_of(Node_Id pathname,
+        Node_Id task, const Metadata*) const {
+    if (pathname >= base_->get_node_count() ||
+            task >= base_->get_node_count()) {
+        return map<string, vector<Node_Id>>();
+    }
+    return base_->friends_of(pathname, task, base_metadata_);
+}
@@ -0,0 +1,104 @@
+#ifndef SEGMENTS_HH
+#define SEGMENTS_HH
+
+#include <memory>
+#include <unordered_map>
+
+#include "archive.hh"
+#include "graph_v2.hh"
+#include "metadata.hh"
+
+/*
+ * A batch of records added to a trace after it was compressed: a trace of
+ * its own, numbered on its own, and the trace-wide id of each of its
+ * nodes.
+ */
+struct Segment {
+    static const Node_Id NO_NODE = numeric_limits<Node_Id>::max();
+
+    const Metadata* metadata;
+    const Graph* graph;
+    // NO_NODE for ids that are not nodes
+    vector<Node_Id> to_global;
+    unordered_map<Node_Id, Node_Id> to_local;
+
+    Segment() : metadata(nullptr), graph(nullptr) {}
+    virtual ~Segment() {}
+    bool find_local(Node_Id node, Node_Id& local) const;
+    bool find_global(Node_Id local, Node_Id& node) const;
+    void add_node(Node_Id local, Node_Id node);
+};
+
+/*
+ * A segment appended to an archive (compression/append.py), encoded with
+ * the archive's dictionaries. It is read in place from the archive, which
+ * must outlive it.
+ */
+struct Archive_Segment : public Segment {
+    BitSet bytes;
+    Archive archive;
+    CompressedMetadata compressed;
+    std::unique_ptr<const Graph_V2> compressed_graph;
+
+    Archive_Segment(const Archive& parent, size_t i);
+};
+
+/*
+ * The metadata of a base trace and the segments appended to it. A node's
+ * metadata comes from the base if it has the node, and otherwise from the
+ * first segment that does; an edge's from the first of them that has the
+ * edge. Type codes are the base's, with those only segments use numbered
+ * after them.
+ */
+class Segmented_Metadata : public Metadata {
+    public:
+        Segmented_Metadata(const Metadata* base,
+                const vector<const Segment*>& segments);
+        map<string, string> get_metadata(string& identifier) const override;
+        Node_Id get_node_id(string) const override;
+        bool has_identifier(const string&) const override;
+        string get_identifier(Node_Id) const override;
+        vector<string> get_node_ids() const override;
+        Type_Code get_node_type(Node_Id) const override;
+        Type_Code get_edge_type(Node_Id src, Node_Id dest) const override;
+        time_t get_node_time(Node_Id) const override;
+        time_t get_edge_time(Node_Id src, Node_Id dest) const override;
+
+    private:
+        const Metadata* base_;
+        vector<const Segment*> segments_;
+        // each segment's type codes, as codes of this
+        vector<vector<Type_Code>> types_;
+        // for nodes past the base's, the segment that added them and their
+        // id there
+        vector<pair<size_t, Node_Id>> homes_;
+
+        const Metadata* find(const string& identifier) const;
+        Type_Code translate(size_t segment, Type_Code) const;
+};
+
+/*
+ * The edges of a base graph and of the segments appended to it. friends_of
+ * only sees the base graph.
+ */
+class Segmented_Graph : public Graph {
+    public:
+        Segmented_Graph(const Graph* base, const Metadata* base_metadata,
+                const vector<const Segment*>& segments, size_t num_nodes);
+        vector<Node_Id> get_outgoing_edges(Node_Id) const override;
+        vector<Node_Id> get_incoming_edges(Node_Id) const override;
+        map<string, vector<Node_Id>> friends_of(Node_Id, Node_Id,
+                const Metadata*) const override;
+        size_t get_node_count() const override { return num_nodes_; }
+
+    private:
+        const Graph* base_;
+        const Metadata* base_metadata_;
+        vector<const Segment*> segments_;
+        size_t num_nodes_;
+
+        vector<Node_Id> merge_edges(Node_Id,
+                vector<Node_Id> (Graph::*)(Node_Id) const) const;
+};
+
+#endif
@@ -0,0 +1,355 @@
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.hh"
+
+Thread_Pool::Thread_Pool(size_t nthreads) : stopping_(false) {
+    if (nthreads == 0) {
+        nthreads = 1;
+    }
+    for (size_t i = 0; i < nthreads; ++i) {
+        threads_.push_back(std::thread(&Thread_Pool::work, this));
+    }
+}
+
+Thread_Pool::~Thread_Pool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : threads_) {
+        t.join();
+    }
+}
+
+void Thread_Pool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push(job);
+    }
+    cv_.notify_one();
+}
+
+void Thread_Pool::work() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) {
+                return;
+            }
+            job = jobs_.front();
+            jobs_.pop();
+        }
+        job();
+    }
+}
+
+Query_Server::Query_Server(const Querier& querier, size_t nthreads)
+    : querier_(querier), pool_(nthreads) {}
+
+// Writes to a socket whose peer has gone fail with EPIPE rather than
+// raising SIGPIPE, which would end the whole server.
+static bool write_all(int fd, const string& s) {
+    size_t off = 0;
+    bool is_socket = true;
+    while (off < s.size()) {
+        ssize_t n;
+        if (is_socket) {
+            n = send(fd, s.data() + off, s.size() - off, MSG_NOSIGNAL);
+            if (n < 0 && errno == ENOTSOCK) {
+                is_socket = false;
+                continue;
+            }
+        } else {
+            n = write(fd, s.data() + off, s.size() - off);
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        off += n;
+    }
+    return true;
+}
+
+void Query_Server::serve(int in_fd, int out_fd) {
+    // Responses from the workers share out_fd; the reader waits for all of
+    // its outstanding requests before returning. Once a response cannot be
+    // written, the requests still queued are dropped rather than run.
+    std::mutex out_mutex;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    size_t outstanding = 0;
+    std::atomic<bool> closed(false);
+
+    string buf;
+    char chunk[1 << 16];
+    bool eof = false;
+    while (!eof && !closed) {
+        ssize_t n = read(in_fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            eof = true;
+            if (buf.empty()) {
+                break;
+            }
+            buf.push_back('\n');
+        } else {
+            buf.append(chunk, n);
+        }
+
+        size_t start = 0, end;
+        while ((end = buf.find('\n', start)) != string::npos) {
+            string line = buf.substr(start, end - start);
+            start = end + 1;
+            if (line.find_first_not_of(" \t\r") == string::npos) {
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(done_mutex);
+                ++outstanding;
+            }
+            pool_.submit([this, line, out_fd, &out_mutex, &done_mutex,
+                    &done_cv, &outstanding, &closed] {
+                if (!closed) {
+                    string response = handle(line);
+                    std::lock_guard<std::mutex> lock(out_mutex);
+                    if (!closed && !write_all(out_fd, response)) {
+                        closed = true;
+                    }
+                }
+                std::lock_guard<std::mutex> lock(done_mutex);
+                if (--outstanding == 0) {
+                    done_cv.notify_all();
+                }
+            });
+        }
+        buf.erase(0, start);
+    }
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&outstanding] { return outstanding == 0; });
+}
+
+int Query_Server::serve_socket(const string& path) {
+    sockaddr_un addr;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        cerr << "socket path too long: " << path << endl;
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    unlink(path.c_str());
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        perror(path.c_str());
+        close(fd);
+        return -1;
+    }
+    cerr << "listening on " << path << endl;
+
+    while (true) {
+        int conn = accept(fd, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("accept");
+            break;
+        }
+        std::thread([this, conn] {
+            serve(conn, conn);
+            close(conn);
+        }).detach();
+    }
+    close(fd);
+    return -1;
+}
+
+static Json::Value to_json(const vector<string>& ids) {
+    Json::Value result(Json::arrayValue);
+    for (auto& id : ids) {
+        result.append(id);
+    }
+    return result;
+}
+
+static Json::Value to_json(size_t n) {
+    return Json::Value((Json::UInt64)n);
+}
+
+static bool parse_time(const Json::Value& v, time_t& t) {
+    if (v.isIntegral()) {
+        t = (time_t)v.asInt64();
+        return true;
+    }
+    return v.isString() && parse_cf_date(v.asString(), t);
+}
+
+static vector<string> parse_types(const Json::Value& v) {
+    vector<string> typs;
+    if (v.isString()) {
+        typs.push_back(v.asString());
+    } else if (v.isArray()) {
+        for (auto& typ : v) {
+            typs.push_back(typ.asString());
+        }
+    }
+    return typs;
+}
+
+Traversal_Filter Query_Server::parse_filter(const Json::Value& request) {
+    Traversal_Filter filter = querier_.make_type_filter(
+            parse_types(request["edge_types"]),
+            parse_types(request["node_types"]),
+            parse_types(request["via_types"]));
+    if (request.isMember("t_from") && !parse_time(request["t_from"], filter.t_from)) {
+        throw std::invalid_argument("bad t_from");
+    }
+    if (request.isMember("t_to") && !parse_time(request["t_to"], filter.t_to)) {
+        throw std::invalid_argument("bad t_to");
+    }
+    if (request.isMember("max_depth")) {
+        filter.max_depth = request["max_depth"].asUInt64();
+    }
+    return filter;
+}
+
+// Looks up a node-valued field, which must name a known node.
+static string node_field(const Querier& q, const Json::Value& request,
+        const char* field) {
+    const Json::Value& v = request[field];
+    if (!v.isString()) {
+        throw std::invalid_argument(string("missing ") + field);
+    }
+    string id = v.asString();
+    if (!q.has_node(id)) {
+        throw std::invalid_argument(string("unknown ") + field + " " + id);
+    }
+    return id;
+}
+
+Json::Value Query_Server::run_query(const Json::Value& request) {
+    string query = request["query"].asString();
+    const Querier& q = querier_;
+
+    if (query == "count_paths" || query == "path_exists" || query == "all_paths") {
+        string source = node_field(q, request, "identifier");
+        string sink = node_field(q, request, "sink");
+        if (query == "count_paths") {
+            return to_json(q.count_paths(source, sink));
+        } else if (query == "path_exists") {
+            return Json::Value(q.path_exists(source, sink));
+        }
+        Json::Value result(Json::arrayValue);
+        for (auto& path : q.all_paths(source, sink)) {
+            result.append(to_json(path));
+        }
+        return result;
+    }
+
+    string id = node_field(q, request, "identifier");
+    size_t k = request.get("k", 1).asUInt64();
+    if (query == "metadata") {
+        Json::Value result(Json::objectValue);
+        for (auto& kv : q.get_metadata(id)) {
+            result[kv.first] = kv.second;
+        }
+        return result;
+    } else if (query == "all_ancestors") {
+        return to_json(q.get_all_ancestors(id));
+    } else if (query == "direct_ancestors") {
+        return to_json(q.get_direct_ancestors(id));
+    } else if (query == "all_descendants") {
+        return to_json(q.get_all_descendants(id));
+    } else if (query == "direct_descendants") {
+        return to_json(q.get_direct_descendants(id));
+    } else if (query == "filtered_ancestors") {
+        return to_json(q.get_filtered_ancestors(id, parse_filter(request)));
+    } else if (query == "filtered_descendants") {
+        return to_json(q.get_filtered_descendants(id, parse_filter(request)));
+    } else if (query == "k_hop_ancestors") {
+        return to_json(q.get_k_hop_ancestors(id, k));
+    } else if (query == "k_hop_descendants") {
+        return to_json(q.get_k_hop_descendants(id, k));
+    } else if (query == "count_k_hop_ancestors") {
+        return to_json(q.count_k_hop_ancestors(id, k));
+    } else if (query == "count_k_hop_descendants") {
+        return to_json(q.count_k_hop_descendants(id, k));
+    } else if (query == "neighborhood") {
+        Neighborhood n = q.get_neighborhood(id, k);
+        Json::Value result(Json::objectValue);
+        result["nodes"] = to_json(n.nodes);
+        result["edges"] = Json::Value(Json::arrayValue);
+        for (auto& e : n.edges) {
+            Json::Value edge(Json::arrayValue);
+            edge.append(e.first);
+            edge.append(e.second);
+            result["edges"].append(edge);
+        }
+        return result;
+    } else if (query == "neighborhood_size") {
+        auto size = q.get_neighborhood_size(id, k);
+        Json::Value result(Json::objectValue);
+        result["nodes"] = to_json(size.first);
+        result["edges"] = to_json(size.second);
+        return result;
+    } else if (query == "count_ancestors") {
+        return to_json(q.count_ancestors(id, parse_filter(request)));
+    } else if (query == "count_descendants") {
+        return to_json(q.count_descendants(id, parse_filter(request)));
+    } else if (query == "ancestor_exists") {
+        return Json::Value(q.ancestor_exists(id, parse_filter(request)));
+    } else if (query == "descendant_exists") {
+        return Json::Value(q.descendant_exists(id, parse_filter(request)));
+    } else if (query == "friends") {
+        string task = node_field(q, request, "task");
+        Json::Value result(Json::objectValue);
+        for (auto& kv : q.friends_of(id, task)) {
+            result[kv.first] = to_json(kv.second);
+        }
+        return result;
+    }
+    throw std::invalid_argument("unknown query " + query);
+}
+
+string Query_Server::handle(const string& line) {
+    auto start = std::chrono::steady_clock::now();
+    Json::Reader reader;
+    Json::FastWriter writer;
+    Json::Value request;
+    Json::Value response(Json::objectValue);
+
+    if (!reader.parse(line, request, false) || !request.isObject()) {
+        response["error"] = "malformed request";
+    } else {
+        response["id"] = request["id"];
+        try {
+            response["result"] = run_query(request);
+        } catch (const std::exception& e) {
+            response["error"] = e.what();
+        }
+    }
+    auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+    response["latency_ns"] = (Json::Int64)latency.count();
+    return writer.write(response);
+}
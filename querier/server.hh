@@ -0,0 +1,62 @@
+#ifndef SERVER_HH
+#define SERVER_HH
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+#include "queriers.hh"
+#include "json/json.h"
+
+/*
+ * Fixed set of threads running jobs off a shared queue.
+ */
+class Thread_Pool {
+public:
+    Thread_Pool(size_t nthreads);
+    ~Thread_Pool();
+    void submit(std::function<void()> job);
+
+private:
+    std::vector<std::thread> threads_;
+    std::queue<std::function<void()>> jobs_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_;
+
+    void work();
+};
+
+/*
+ * Answers newline-delimited JSON requests against one loaded querier.
+ *
+ * A request is an object such as
+ *   {"id": 7, "query": "all_ancestors", "identifier": "..."}
+ * with optional "sink" (paths), "task" (friends), "k", "edge_types",
+ * "node_types", "via_types", "t_from" and "t_to" fields, depending on the
+ * query. Each response is one line holding the request's "id", either a
+ * "result" or an "error", and the request's "latency_ns". Requests on one
+ * stream are pipelined across the worker threads, so responses may come
+ * back out of order.
+ */
+class Query_Server {
+public:
+    Query_Server(const Querier& querier, size_t nthreads);
+    // Serves one stream until end of input and all responses are written.
+    void serve(int in_fd, int out_fd);
+    // Serves each connection to a Unix domain socket at path; never returns
+    // unless the socket cannot be set up.
+    int serve_socket(const string& path);
+
+private:
+    const Querier& querier_;
+    Thread_Pool pool_;
+
+    string handle(const string& line);
+    Json::Value run_query(const Json::Value& request);
+    Traversal_Filter parse_filter(const Json::Value& request);
+};
+
+#endif
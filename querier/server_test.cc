@@ -0,0 +1,206 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "server.hh"
+
+/*
+ * Runs a Query_Server over a socketpair and over a Unix domain socket, and
+ * checks its responses against the querier it serves. Also checks that a
+ * client that hangs up with requests outstanding neither stalls serve()
+ * nor takes the socket server down with it.
+ *
+ * Usage: ./server_test (from the querier directory)
+ */
+
+string auditfile = "../copythrice.log";
+string socketfile = "/tmp/provquery_server_test.sock";
+
+static size_t failures = 0;
+
+static void check(bool ok, const string& what) {
+    if (!ok) {
+        cout << "FAILED: " << what << endl;
+        ++failures;
+    }
+}
+
+static string request(size_t id, const string& query, const string& node,
+        size_t k = 0) {
+    Json::Value r(Json::objectValue);
+    r["id"] = (Json::UInt64) id;
+    r["query"] = query;
+    r["identifier"] = node;
+    if (k) {
+        r["k"] = (Json::UInt64) k;
+    }
+    return Json::FastWriter().write(r);
+}
+
+static bool write_all(int fd, const string& s) {
+    for (size_t off = 0; off < s.size(); ) {
+        ssize_t n = write(fd, s.data() + off, s.size() - off);
+        if (n <= 0) {
+            return false;
+        }
+        off += n;
+    }
+    return true;
+}
+
+// Reads responses until count have come or the stream ends, by id
+static map<size_t, Json::Value> read_responses(int fd, size_t count) {
+    map<size_t, Json::Value> responses;
+    string buf;
+    char chunk[4096];
+    while (responses.size() < count) {
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n <= 0) {
+            break;
+        }
+        buf.append(chunk, n);
+        size_t start = 0, end;
+        while ((end = buf.find('\n', start)) != string::npos) {
+            Json::Value response;
+            Json::Reader().parse(buf.substr(start, end - start), response);
+            responses[response["id"].asUInt64()] = response;
+            start = end + 1;
+        }
+        buf.erase(0, start);
+    }
+    return responses;
+}
+
+static vector<string> sorted(const Json::Value& v) {
+    vector<string> out;
+    for (auto& x : v) {
+        out.push_back(x.asString());
+    }
+    sort(out.begin(), out.end());
+    return out;
+}
+
+static vector<string> sorted(vector<string> v) {
+    sort(v.begin(), v.end());
+    return v;
+}
+
+// Requests for each node's ancestors and descendants, then one with no
+// identifier, answered over one stream
+static void check_stream(const Querier& q, Query_Server& server,
+        vector<string>& ids) {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    std::thread serving([&] {
+        server.serve(fds[1], fds[1]);
+        close(fds[1]);
+    });
+    std::thread writing([&] {
+        string requests;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            requests += request(2 * i, "all_ancestors", ids[i]);
+            requests += request(2 * i + 1, "count_descendants", ids[i]);
+        }
+        requests += "{\"id\": 999999, \"query\": \"all_ancestors\"}\n";
+        write_all(fds[0], requests);
+        shutdown(fds[0], SHUT_WR);
+    });
+    auto responses = read_responses(fds[0], 2 * ids.size() + 1);
+    writing.join();
+    serving.join();
+    close(fds[0]);
+
+    check(responses.size() == 2 * ids.size() + 1, "one response a request");
+    for (size_t i = 0; i < ids.size(); ++i) {
+        check(sorted(responses[2 * i]["result"]) ==
+                sorted(q.get_all_ancestors(ids[i])),
+                "all_ancestors of " + ids[i]);
+        check(responses[2 * i + 1]["result"].asUInt64() ==
+                q.count_descendants(ids[i]),
+                "count_descendants of " + ids[i]);
+    }
+    check(responses[999999]["error"].asString() == "missing identifier",
+            "missing identifier refused");
+}
+
+// A client that sends many requests and hangs up without reading any
+static void hang_up(int fd, vector<string>& ids) {
+    string requests;
+    for (size_t i = 0; i < 300; ++i) {
+        requests += request(i, "neighborhood", ids[i % ids.size()], 3);
+    }
+    write_all(fd, requests);
+    close(fd);
+}
+
+static int connect_socket() {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketfile.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    for (int tries = 0; tries < 100; ++tries) {
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0) {
+            return fd;
+        }
+        usleep(10000);
+    }
+    close(fd);
+    return -1;
+}
+
+static bool socket_answers(const Querier& q, string id) {
+    int fd = connect_socket();
+    if (fd < 0) {
+        return false;
+    }
+    write_all(fd, request(1, "direct_ancestors", id));
+    auto responses = read_responses(fd, 1);
+    close(fd);
+    return responses.count(1) && sorted(responses[1]["result"]) ==
+        sorted(q.get_direct_ancestors(id));
+}
+
+int main() {
+    DummyQuerier q(auditfile);
+    vector<string> all_ids = q.get_node_ids();
+    vector<string> ids;
+    size_t step = max<size_t>(1, all_ids.size() / 40);
+    for (size_t i = 0; i < all_ids.size(); i += step) {
+        ids.push_back(all_ids[i]);
+    }
+    if (ids.size() < 2) {
+        cout << "no nodes in " << auditfile << endl;
+        return 1;
+    }
+
+    Query_Server server(q, 4);
+    check_stream(q, server, ids);
+
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    std::thread serving([&] {
+        server.serve(fds[1], fds[1]);
+        close(fds[1]);
+    });
+    hang_up(fds[0], ids);
+    serving.join();
+
+    // serve_socket never returns, so its server is left to the end of the
+    // process
+    Query_Server* socket_server = new Query_Server(q, 4);
+    std::thread([socket_server] {
+        socket_server->serve_socket(socketfile);
+    }).detach();
+    check(socket_answers(q, ids[0]), "socket answers");
+    for (int i = 0; i < 3; ++i) {
+        int fd = connect_socket();
+        check(fd >= 0, "connect");
+        hang_up(fd, ids);
+    }
+    check(socket_answers(q, ids[1]), "socket answers after clients hang up");
+    unlink(socketfile.c_str());
+
+    cout << (failures ? "FAIL" : "PASS") << endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,164 @@
+#include <atomic>
+#include <thread>
+
+#include "helpers.hh"
+#include "queriers.hh"
+
+/*
+ * Runs every query type from many threads against one shared querier and
+ * checks each answer against a single-threaded run.
+ *
+ * Usage: ./stress [threads] [rounds] [cache MB]
+ */
+
+string metafile = "../compression/compressed_metadata.txt";
+string graphfile = "../compression/graph.cpg";
+string auditfile = "../copythrice.log";
+
+static string show(const string& s) { return s; }
+
+template <typename T>
+static string show(const vector<T>& v) {
+    ostringstream out;
+    for (auto& x : v) {
+        out << x << ",";
+    }
+    return out.str();
+}
+
+template <typename K, typename V>
+static string show(const map<K, V>& m) {
+    ostringstream out;
+    for (auto& kv : m) {
+        out << kv.first << "=" << show(kv.second) << ";";
+    }
+    return out.str();
+}
+
+// Answers to every query type for every sampled node, in a fixed order.
+// Queries are run starting from the given one, so that threads starting
+// at different points are spread over different query types.
+static vector<string> run_all(const Querier& q, vector<string>& ids,
+        string& pathname, string& task, size_t start) {
+    Traversal_Filter typed = q.make_type_filter({"write", "exec"}, {"file"});
+    Traversal_Filter windowed;
+    windowed.t_from = 0;
+    windowed.t_to = numeric_limits<time_t>::max() / 2;
+    vector<Batch_Request> batch;
+    for (auto& id : ids) {
+        batch.push_back({ALL_ANCESTORS, id});
+        batch.push_back({COUNT_DESCENDANTS, id});
+    }
+
+    // each query type, given a node and some other node
+    typedef function<string(string&, string&)> Query;
+    vector<Query> kinds = {
+        [&](string& id, string&) { return show(q.get_metadata(id)); },
+        [&](string& id, string&) { return show(q.get_all_ancestors(id)); },
+        [&](string& id, string&) { return show(q.get_direct_ancestors(id)); },
+        [&](string& id, string&) { return show(q.get_all_descendants(id)); },
+        [&](string& id, string&) { return show(q.get_direct_descendants(id)); },
+        [&](string& id, string&) {
+            return show(q.get_filtered_ancestors(id, typed)); },
+        [&](string& id, string&) {
+            return show(q.get_filtered_descendants(id, windowed)); },
+        [&](string& id, string&) {
+            return show(q.get_ancestors_between(id, 0, windowed.t_to)); },
+        [&](string& id, string&) { return show(q.get_k_hop_ancestors(id, 2)); },
+        [&](string& id, string&) {
+            return to_string(q.count_k_hop_descendants(id, 3)); },
+        [&](string& id, string&) {
+            Neighborhood n = q.get_neighborhood(id, 2);
+            return show(n.nodes) + to_string(n.edges.size()); },
+        [&](string& id, string&) {
+            return to_string(q.count_ancestors(id, typed)); },
+        [&](string& id, string&) {
+            return to_string(q.descendant_exists(id, typed)); },
+        [&](string& id, string& other) {
+            return to_string(q.count_paths(id, other)); },
+        [&](string& id, string& other) {
+            return to_string(q.path_exists(other, id)); },
+        [&](string& id, string& other) {
+            return to_string(q.all_paths(id, other).size()); },
+    };
+    if (!pathname.empty()) {
+        kinds.push_back([&](string&, string&) {
+            return show(q.friends_of(pathname, task)); });
+    }
+    kinds.push_back([&](string&, string&) {
+        string out;
+        for (auto& result : q.run_batch(batch)) {
+            out += show(result.nodes) + to_string(result.count) + ";";
+        }
+        return out;
+    });
+
+    size_t nqueries = kinds.size() * ids.size();
+    vector<string> results(nqueries);
+    for (size_t i = 0; i < nqueries; ++i) {
+        size_t j = (start + i) % nqueries;
+        size_t node = j / kinds.size();
+        results[j] = kinds[j % kinds.size()](ids[node],
+                ids[(node * 7 + 3) % ids.size()]);
+    }
+    return results;
+}
+
+int main(int argc, char* argv[]) {
+    size_t nthreads = argc > 1 ? atoi(argv[1]) : 8;
+    size_t rounds = argc > 2 ? atoi(argv[2]) : 4;
+    size_t cache_bytes = argc > 3 ? (size_t)atoi(argv[3]) << 20 : 0;
+
+#if COMPRESSED
+    CompressedQuerier q(metafile, graphfile, cache_bytes);
+#else
+    DummyQuerier q(auditfile, cache_bytes);
+#endif
+    vector<string> all_ids = q.get_node_ids();
+    vector<string> ids;
+    for (size_t i = 0; i < all_ids.size(); i += max<size_t>(1, all_ids.size() / 40)) {
+        ids.push_back(all_ids[i]);
+    }
+    string pathname, task;
+    for (auto& id : all_ids) {
+        string typ = q.get_metadata(id)["cf:type"];
+        if (typ == "file_name" && pathname.empty()) {
+            pathname = id;
+        } else if (typ == "task" && task.empty()) {
+            task = id;
+        }
+    }
+    if (task.empty()) {
+        pathname.clear();
+    }
+
+    vector<string> expected = run_all(q, ids, pathname, task, 0);
+    cout << expected.size() << " queries, " << nthreads << " threads, "
+        << rounds << " rounds" << endl;
+
+    std::atomic<size_t> mismatches(0);
+    vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < nthreads; ++t) {
+        threads.push_back(std::thread([&, t] {
+            for (size_t r = 0; r < rounds; ++r) {
+                size_t offset = (t * 131 + r * 17) % expected.size();
+                vector<string> got = run_all(q, ids, pathname, task, offset);
+                for (size_t i = 0; i < got.size(); ++i) {
+                    if (got[i] != expected[i]) {
+                        ++mismatches;
+                    }
+                }
+            }
+        }));
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    cout << "mismatches: " << mismatches << " (" << elapsed.count()
+        << " ms)" << endl;
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,481 @@
+#include <random>
+
+#include "helpers.hh"
+
+/*
+ * Writes a synthetic CamFlow log, shaped like the ones CamFlow writes, for
+ * scaling benchmarks on machines without a CamFlow kernel. Tasks clone new
+ * tasks, create files (each with a file_name), and read, write, open,
+ * exec and mmap them. Flows of information make new versions, chained by
+ * version edges as CamFlow chains them, up to a given depth per object.
+ * Which task and file each event touches is drawn from a Zipf
+ * distribution over them, oldest first, so a few hub files (think shared
+ * libraries) fan out to most tasks and a few long-lived tasks do most of
+ * the work; a skew of 0 draws uniformly.
+ *
+ * Records are written as they are made, with only a version counter kept
+ * per object, so the log can be far larger than memory.
+ *
+ * Usage: ./synth_trace [--nodes=N] [--depth=N] [--skew=S] [--seed=N]
+ *            [--records=PER_LINE] [--out=FILE]
+ */
+
+static const uint32_t BOOT_ID = 1507152837;
+static const uint32_t MACHINE_ID = 1930185093;
+// jiffies per second
+static const uint64_t HZ = 250;
+// 2016-11-30 00:00:00 UTC
+static const time_t START_TIME = 1480464000;
+
+// The type word CamFlow puts at the start of an identifier
+enum Camflow_Type : uint64_t {
+    TYPE_TASK = 0x4000000000000001,
+    TYPE_FILE = 0x2000000000000100,
+    TYPE_FILE_NAME = 0x2000000000080000,
+    TYPE_READ = 0x8010000000000800,
+    TYPE_MMAP_READ = 0x8010000000001000,
+    TYPE_PERM_READ = 0x8010000000002000,
+    TYPE_EXEC = 0x8010000000004000,
+    TYPE_MMAP_EXEC = 0x8010000000008000,
+    TYPE_PERM_EXEC = 0x8010000000010000,
+    TYPE_OPEN = 0x8010000000080000,
+    TYPE_CREATE = 0x8040000000000004,
+    TYPE_WRITE = 0x8040000000000008,
+    TYPE_PERM_WRITE = 0x8040000000000010,
+    TYPE_MMAP_WRITE = 0x8040000000000020,
+    TYPE_CLONE = 0x8008000000200000,
+    TYPE_TASK_VERSION = 0x8008000000400000,
+    TYPE_NAMED = 0x8080000000000001,
+    TYPE_FILE_VERSION = 0x8080000000000002,
+};
+
+// How a relation names its ends, from the record group it is in
+struct Relation_Kind {
+    const char* group;
+    const char* from;
+    const char* to;
+};
+static const Relation_Kind USED = {"used", "prov:entity", "prov:activity"};
+static const Relation_Kind GENERATED = {"wasGeneratedBy", "prov:activity",
+    "prov:entity"};
+static const Relation_Kind INFORMED = {"wasInformedBy", "prov:informant",
+    "prov:informed"};
+static const Relation_Kind DERIVED = {"wasDerivedFrom", "prov:usedEntity",
+    "prov:generatedEntity"};
+
+static const char* GROUPS[] = {"activity", "entity", "used",
+    "wasGeneratedBy", "wasInformedBy", "wasDerivedFrom"};
+static const size_t NUM_GROUPS = sizeof(GROUPS) / sizeof(GROUPS[0]);
+
+/*
+ * Draws from a Zipf distribution over 1..n with exponent s in constant
+ * time for any n, by rejection-inversion (Hormann and Derflinger, "Rejection-
+ * inversion to generate variates from monotone discrete distributions",
+ * 1996). n may change between draws.
+ */
+class Zipf_Sampler {
+    public:
+        Zipf_Sampler(double s) : s_(s) {
+            h_integral_x1_ = h_integral(1.5) - 1;
+            threshold_ = 2 - h_integral_inverse(h_integral(2.5) - h(2));
+        }
+
+        template <typename Rng>
+        uint64_t draw(uint64_t n, Rng& rng) {
+            std::uniform_real_distribution<double> uniform;
+            if (s_ == 0) {
+                return 1 + (uint64_t) (uniform(rng) * n) % n;
+            }
+            double h_integral_n = h_integral(n + 0.5);
+            while (true) {
+                double u = h_integral_n + uniform(rng) *
+                    (h_integral_x1_ - h_integral_n);
+                double x = h_integral_inverse(u);
+                uint64_t k = min<double>(max(x + 0.5, 1.0), n);
+                if (k - x <= threshold_ ||
+                        u >= h_integral(k + 0.5) - h(k)) {
+                    return k;
+                }
+            }
+        }
+
+    private:
+        double s_;
+        double h_integral_x1_;
+        double threshold_;
+
+        // log1p(x) / x and expm1(x) / x, without cancellation near 0
+        static double helper1(double x) {
+            return fabs(x) > 1e-8 ? log1p(x) / x :
+                1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+        }
+        static double helper2(double x) {
+            return fabs(x) > 1e-8 ? expm1(x) / x :
+                1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+        }
+        double h(double x) const {
+            return exp(-s_ * log(x));
+        }
+        double h_integral(double x) const {
+            double log_x = log(x);
+            return helper2((1 - s_) * log_x) * log_x;
+        }
+        double h_integral_inverse(double x) const {
+            double t = max(x * (1 - s_), -1.0);
+            return exp(helper1(t) * x);
+        }
+};
+
+class Trace_Writer {
+    public:
+        Trace_Writer(FILE* out, uint64_t nodes, uint32_t depth, double skew,
+                uint64_t seed, size_t records_per_line)
+            : out_(out), max_nodes_(nodes), depth_(depth), zipf_(skew),
+              rng_(seed), records_per_line_(records_per_line), groups_(NUM_GROUPS),
+              records_(0), node_ids_(0), relation_ids_(0), jiffies_(0),
+              nodes_(0), edges_(0), lines_(0), bytes_(0) {}
+
+        void run();
+        void print_stats() const;
+
+    private:
+        FILE* out_;
+        uint64_t max_nodes_;
+        uint32_t depth_;
+        Zipf_Sampler zipf_;
+        std::mt19937_64 rng_;
+        size_t records_per_line_;
+
+        // the records of the line being built, by group
+        vector<string> groups_;
+        size_t records_;
+        // cf:id and current version of every task and file
+        vector<uint64_t> task_ids_;
+        vector<uint32_t> task_versions_;
+        vector<uint64_t> file_ids_;
+        vector<uint32_t> file_versions_;
+        uint64_t node_ids_;
+        uint64_t relation_ids_;
+        uint64_t jiffies_;
+
+        uint64_t nodes_, edges_, lines_, bytes_;
+
+        string identifier(uint64_t type, uint64_t id, uint32_t version) const;
+        string common(uint64_t id, const char* type) const;
+        void add(size_t group, const string& identifier, const string& body);
+        void flush();
+
+        string new_task();
+        string task_node(size_t task) const;
+        string new_file();
+        string file_node(size_t file) const;
+        void relate(const Relation_Kind&, uint64_t type, const char* label,
+                const string& from, const string& to, bool offset = false);
+        // A new version of a task or file if it has not reached the depth
+        // limit, chained to the one before; otherwise the current one
+        string bump_task(size_t task);
+        string bump_file(size_t file);
+
+        size_t pick_task() { return zipf_.draw(task_ids_.size(), rng_) - 1; }
+        size_t pick_file() { return zipf_.draw(file_ids_.size(), rng_) - 1; }
+        void event();
+};
+
+static void append_base64(string& out, const unsigned char* p, size_t n) {
+    static const char digits[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (size_t i = 0; i < n; i += 3) {
+        uint32_t v = p[i] << 16;
+        v |= i + 1 < n ? p[i + 1] << 8 : 0;
+        v |= i + 2 < n ? p[i + 2] : 0;
+        out += digits[(v >> 18) & 63];
+        out += digits[(v >> 12) & 63];
+        out += i + 1 < n ? digits[(v >> 6) & 63] : '=';
+        out += i + 2 < n ? digits[v & 63] : '=';
+    }
+}
+
+// As CamFlow lays it out: the type word, cf:id, boot and machine ids and
+// version, little-endian, in 32 bytes
+string Trace_Writer::identifier(uint64_t type, uint64_t id,
+        uint32_t version) const {
+    unsigned char bytes[32] = {0};
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = type >> (8 * i);
+        bytes[8 + i] = id >> (8 * i);
+    }
+    for (int i = 0; i < 4; ++i) {
+        bytes[16 + i] = BOOT_ID >> (8 * i);
+        bytes[20 + i] = MACHINE_ID >> (8 * i);
+        bytes[24 + i] = version >> (8 * i);
+    }
+    string s;
+    append_base64(s, bytes, sizeof(bytes));
+    return s;
+}
+
+// The attributes every record has
+string Trace_Writer::common(uint64_t id, const char* type) const {
+    time_t t = START_TIME + jiffies_ / HZ;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char date[32];
+    strftime(date, sizeof(date), "%Y:%m:%dT%H:%M:%S", &tm);
+    return "\"cf:id\":\"" + to_string(id) + "\",\"cf:type\":\"" + type +
+        "\",\"cf:boot_id\":" + to_string(BOOT_ID) + ",\"cf:machine_id\":" +
+        to_string(MACHINE_ID) + ",\"cf:date\":\"" + date +
+        "\",\"cf:jiffies\":\"" + to_string(4309511553ull + jiffies_) + "\"";
+}
+
+void Trace_Writer::add(size_t group, const string& identifier,
+        const string& body) {
+    string& s = groups_[group];
+    s += s.empty() ? "" : ",";
+    s += "\"" + identifier + "\":{" + body + "}";
+    ++records_;
+}
+
+void Trace_Writer::flush() {
+    if (!records_) {
+        return;
+    }
+    time_t t = START_TIME + jiffies_ / HZ;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "[%Y-%m-%d %H:%M:%S]", &tm);
+    string line = string(stamp) + "\tINFO  : {\"prefix\":{\"prov\" : "
+        "\"http://www.w3.org/ns/prov\", \"cf\":\"http://www.camflow.org\"}";
+    for (size_t i = 0; i < NUM_GROUPS; ++i) {
+        if (!groups_[i].empty()) {
+            line += ", \"" + string(GROUPS[i]) + "\":{" + groups_[i] + "}";
+            groups_[i].clear();
+        }
+    }
+    line += "}\n";
+    if (fwrite(line.data(), 1, line.size(), out_) != line.size()) {
+        perror("synth_trace");
+        exit(1);
+    }
+    records_ = 0;
+    ++lines_;
+    bytes_ += line.size();
+}
+
+static string task_attributes(uint64_t id, uint32_t version) {
+    string pid = to_string(id % 32768 + 1);
+    return ",\"cf:version\":" + to_string(version) + ",\"cf:uid\":1000,"
+        "\"cf:gid\":1000,\"cf:pid\":" + pid + ",\"cf:vpid\":" + pid +
+        ",\"prov:label\":\"[task] " + to_string(version) + "\"";
+}
+
+string Trace_Writer::new_task() {
+    task_ids_.push_back(node_ids_++);
+    task_versions_.push_back(0);
+    string id = task_node(task_ids_.size() - 1);
+    add(0, id, common(task_ids_.back(), "task") +
+            task_attributes(task_ids_.back(), 0));
+    ++nodes_;
+    return id;
+}
+
+string Trace_Writer::task_node(size_t task) const {
+    return identifier(TYPE_TASK, task_ids_[task], task_versions_[task]);
+}
+
+string Trace_Writer::file_node(size_t file) const {
+    return identifier(TYPE_FILE, file_ids_[file], file_versions_[file]);
+}
+
+static string file_attributes(uint64_t id, uint32_t version) {
+    char uuid[40];
+    snprintf(uuid, sizeof(uuid), "%08llx-46ea-86ca-d69e-82031b250b52",
+            (unsigned long long) (id & 0xFFFFFFFF));
+    return ",\"cf:version\":" + to_string(version) + ",\"cf:uid\":0,"
+        "\"cf:gid\":0,\"prov:type\":\"file\",\"cf:mode\":\"0x81a4\","
+        "\"cf:uuid\":\"" + uuid + "\",\"prov:label\":\"[file] " +
+        to_string(version) + "\"";
+}
+
+// A new file and the name it is created under
+string Trace_Writer::new_file() {
+    file_ids_.push_back(node_ids_++);
+    file_versions_.push_back(0);
+    string file = file_node(file_ids_.size() - 1);
+    add(1, file, common(file_ids_.back(), "file") +
+            file_attributes(file_ids_.back(), 0));
+
+    uint64_t name_id = node_ids_++;
+    string name = identifier(TYPE_FILE_NAME, name_id, 0);
+    string path = "/data/d" + to_string(file_ids_.size() % 97) + "/f" +
+        to_string(file_ids_.size() - 1);
+    add(1, name, common(name_id, "file_name") + ",\"cf:version\":0,"
+            "\"cf:pathname\":\"" + path + "\",\"prov:label\":\"[path] " +
+            path + "\"");
+    nodes_ += 2;
+    relate(DERIVED, TYPE_NAMED, "named", name, file);
+    return file;
+}
+
+void Trace_Writer::relate(const Relation_Kind& kind, uint64_t type,
+        const char* label, const string& from, const string& to,
+        bool offset) {
+    uint64_t id = relation_ids_++;
+    size_t group = find(GROUPS, GROUPS + NUM_GROUPS, string(kind.group)) -
+        GROUPS;
+    add(group, identifier(type, id, 0), common(id, label) +
+            ",\"prov:label\":\"" + label + "\",\"cf:allowed\":\"true\"," +
+            (offset ? "\"cf:offset\":\"0\"," : "") + "\"" + kind.from +
+            "\":\"" + from + "\",\"" + kind.to + "\":\"" + to + "\"");
+    ++edges_;
+}
+
+string Trace_Writer::bump_task(size_t task) {
+    string old = task_node(task);
+    if (task_versions_[task] + 1 >= depth_ || nodes_ >= max_nodes_) {
+        return old;
+    }
+    ++task_versions_[task];
+    string id = task_node(task);
+    add(0, id, common(task_ids_[task], "task") +
+            task_attributes(task_ids_[task], task_versions_[task]));
+    ++nodes_;
+    relate(INFORMED, TYPE_TASK_VERSION, "version", old, id);
+    return id;
+}
+
+string Trace_Writer::bump_file(size_t file) {
+    string old = file_node(file);
+    if (file_versions_[file] + 1 >= depth_ || nodes_ >= max_nodes_) {
+        return old;
+    }
+    ++file_versions_[file];
+    string id = file_node(file);
+    add(1, id, common(file_ids_[file], "file") +
+            file_attributes(file_ids_[file], file_versions_[file]));
+    ++nodes_;
+    relate(DERIVED, TYPE_FILE_VERSION, "version", old, id);
+    return id;
+}
+
+// One system call's worth of records
+void Trace_Writer::event() {
+    jiffies_ += 1 + rng_() % 3;
+    size_t task = pick_task();
+    uint64_t r = rng_() % 100;
+    if (r < 6) {
+        // clone
+        string parent = task_node(task);
+        string child = new_task();
+        relate(INFORMED, TYPE_CLONE, "clone", parent, child);
+    } else if (r < 18) {
+        // create, and write what was created
+        string file = new_file();
+        relate(GENERATED, TYPE_CREATE, "create", task_node(task), file);
+        relate(GENERATED, TYPE_WRITE, "write", task_node(task),
+                bump_file(file_ids_.size() - 1), true);
+    } else if (r < 35) {
+        // open and permission checks, which make no new versions
+        static const uint64_t types[] = {TYPE_OPEN, TYPE_PERM_READ,
+            TYPE_PERM_EXEC};
+        static const char* labels[] = {"open", "perm_read", "perm_exec"};
+        size_t i = rng_() % 3;
+        relate(USED, types[i], labels[i], file_node(pick_file()),
+                task_node(task), i == 0);
+    } else if (r < 80) {
+        // information flows into the task
+        static const uint64_t types[] = {TYPE_READ, TYPE_READ,
+            TYPE_MMAP_READ, TYPE_EXEC, TYPE_MMAP_EXEC};
+        static const char* labels[] = {"read", "read", "mmap_read", "exec",
+            "mmap_exec"};
+        size_t i = rng_() % 5;
+        string file = file_node(pick_file());
+        relate(USED, types[i], labels[i], file, bump_task(task), i < 2);
+    } else {
+        // and out of it
+        static const uint64_t types[] = {TYPE_WRITE, TYPE_WRITE,
+            TYPE_PERM_WRITE, TYPE_MMAP_WRITE};
+        static const char* labels[] = {"write", "write", "perm_write",
+            "mmap_write"};
+        size_t i = rng_() % 4;
+        string from = task_node(task);
+        relate(GENERATED, types[i], labels[i], from, bump_file(pick_file()),
+                i < 2);
+    }
+    if (records_ >= records_per_line_) {
+        flush();
+    }
+}
+
+void Trace_Writer::run() {
+    // CamFlow's first record describes the machine
+    string machine = "[2016-11-30 00:00:00]\tINFO  : {\"prefix\":{\"prov\" : "
+        "\"http://www.w3.org/ns/prov\", \"cf\":\"http://www.camflow.org\"},"
+        "\"entity\":{\"" + to_string(MACHINE_ID) + "\":{\"prov:label\":"
+        "\"[machine] " + to_string(MACHINE_ID) + "\",\"cf:camflow\":"
+        "\"v0.1.10\",\"cf:sysname\":\"Linux\",\"cf:nodename\":"
+        "\"localhost.localdomain\",\"cf:release\":\"4.4.31\","
+        "\"cf:machine\":\"x86_64\"}}}\n";
+    fputs(machine.c_str(), out_);
+    bytes_ += machine.size();
+    ++lines_;
+
+    new_task();
+    new_file();
+    while (nodes_ < max_nodes_) {
+        event();
+    }
+    flush();
+}
+
+void Trace_Writer::print_stats() const {
+    fprintf(stderr, "nodes %llu (tasks %zu, files %zu) edges %llu lines %llu "
+            "bytes %llu\n", (unsigned long long) nodes_, task_ids_.size(),
+            file_ids_.size(), (unsigned long long) edges_,
+            (unsigned long long) lines_, (unsigned long long) bytes_);
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t nodes = 10000, seed = 1;
+    uint32_t depth = 8;
+    double skew = 1.0;
+    size_t records = 16;
+    string outfile;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        string val = arg.substr(arg.find('=') + 1);
+        if (arg.find("--nodes=") == 0) {
+            nodes = strtoull(val.c_str(), nullptr, 10);
+        } else if (arg.find("--depth=") == 0) {
+            depth = atoi(val.c_str());
+        } else if (arg.find("--skew=") == 0) {
+            skew = atof(val.c_str());
+        } else if (arg.find("--seed=") == 0) {
+            seed = strtoull(val.c_str(), nullptr, 10);
+        } else if (arg.find("--records=") == 0) {
+            records = atoi(val.c_str());
+        } else if (arg.find("--out=") == 0) {
+            outfile = val;
+        } else {
+            depth = 0;
+        }
+    }
+    if (depth < 1 || skew < 0 || records < 1) {
+        cerr << "Usage: ./synth_trace [--nodes=N] [--depth=N] [--skew=S] "
+            "[--seed=N] [--records=PER_LINE] [--out=FILE]" << endl;
+        return 1;
+    }
+    FILE* out = outfile.empty() ? stdout : fopen(outfile.c_str(), "w");
+    if (!out) {
+        perror(outfile.c_str());
+        return 1;
+    }
+    Trace_Writer writer(out, nodes, depth, skew, seed, records);
+    writer.run();
+    writer.print_stats();
+    if (fclose(out) != 0) {
+        perror("synth_trace");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cstring>
+
+#include "unpack.hh"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Widest field that one unaligned 8-byte (or 4-byte) load always covers
+static const size_t MAX_LOAD_WIDTH = 57;
+static const size_t MAX_LOAD_WIDTH_32 = 25;
+
+using std::min;
+
+static inline uint64_t read_field(const unsigned char* data, size_t pos,
+        size_t width) {
+    const unsigned char* p = data + (pos >> 3);
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    word = __builtin_bswap64(word) << (pos & 7);
+    uint64_t val = word >> (64 - width);
+    size_t avail = 64 - (pos & 7);
+    if (width > avail) {
+        val |= p[8] >> (8 - (width - avail));
+    }
+    return val;
+}
+
+void unpack_prefix_sum_scalar(const unsigned char* data, size_t pos,
+        size_t width, size_t count, uint64_t base, uint64_t* out) {
+    if (!width) {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = base;
+        }
+        return;
+    }
+    for (size_t i = 0; i < count; ++i, pos += width) {
+        base += read_field(data, pos, width);
+        out[i] = base;
+    }
+}
+
+#if defined(__x86_64__)
+
+// Two fields per step; SSE2 has no per-lane shifts, so only the running
+// sum is vectorized.
+__attribute__((target("sse2")))
+void unpack_prefix_sum_sse2(const unsigned char* data, size_t pos,
+        size_t width, size_t count, uint64_t base, uint64_t* out) {
+    if (!width) {
+        unpack_prefix_sum_scalar(data, pos, width, count, base, out);
+        return;
+    }
+    __m128i carry = _mm_set1_epi64x(base);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2, pos += 2 * width) {
+        __m128i x = _mm_set_epi64x(read_field(data, pos + width, width),
+                read_field(data, pos, width));
+        x = _mm_add_epi64(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi64(x, carry);
+        _mm_storeu_si128((__m128i*) (out + i), x);
+        carry = _mm_unpackhi_epi64(x, x);
+    }
+    if (i < count) {
+        unpack_prefix_sum_scalar(data, pos, width, count - i,
+                i ? out[i - 1] : base, out + i);
+    }
+}
+
+// Running sums of four 64-bit lanes, plus the carry from earlier lanes
+__attribute__((target("avx2")))
+static inline __m256i prefix_sum_avx2(__m256i x, __m256i carry) {
+    const __m256i zero = _mm256_setzero_si256();
+    x = _mm256_add_epi64(x, _mm256_blend_epi32(
+                _mm256_permute4x64_epi64(x, _MM_SHUFFLE(2, 1, 0, 0)),
+                zero, 0x03));
+    x = _mm256_add_epi64(x, _mm256_blend_epi32(
+                _mm256_permute4x64_epi64(x, _MM_SHUFFLE(1, 0, 0, 0)),
+                zero, 0x0F));
+    return _mm256_add_epi64(x, carry);
+}
+
+// Eight fields per step for narrow fields: each 32-bit lane gathers the 4
+// bytes holding its field, byte swaps and shifts it into place, and the
+// lanes are widened to 64 bits for the running sum.
+__attribute__((target("avx2")))
+static void unpack_prefix_sum_avx2_narrow(const unsigned char* data,
+        size_t pos, size_t width, size_t count, uint64_t base,
+        uint64_t* out) {
+    const __m256i bswap = _mm256_setr_epi8(
+            3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+            3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m256i seven = _mm256_set1_epi32(7);
+    const __m256i step = _mm256_set1_epi32(8 * width);
+    const __m128i rshift = _mm_cvtsi32_si128(32 - width);
+    const unsigned char* start = data + (pos >> 3);
+    __m256i offsets = _mm256_mullo_epi32(_mm256_set1_epi32(width),
+            _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    offsets = _mm256_add_epi32(offsets, _mm256_set1_epi32(pos & 7));
+    __m256i carry = _mm256_set1_epi64x(base);
+
+    size_t i = 0;
+    // keep the 32-bit bit offsets from overflowing
+    size_t limit = min(count, ((size_t) 1 << 30) / width);
+    for (; i + 8 <= limit; i += 8) {
+        __m256i words = _mm256_i32gather_epi32((const int*) start,
+                _mm256_srli_epi32(offsets, 3), 1);
+        words = _mm256_shuffle_epi8(words, bswap);
+        words = _mm256_sllv_epi32(words, _mm256_and_si256(offsets, seven));
+        __m256i x = _mm256_srl_epi32(words, rshift);
+
+        __m256i lo = prefix_sum_avx2(
+                _mm256_cvtepu32_epi64(_mm256_castsi256_si128(x)), carry);
+        carry = _mm256_permute4x64_epi64(lo, _MM_SHUFFLE(3, 3, 3, 3));
+        __m256i hi = prefix_sum_avx2(
+                _mm256_cvtepu32_epi64(_mm256_extracti128_si256(x, 1)), carry);
+        carry = _mm256_permute4x64_epi64(hi, _MM_SHUFFLE(3, 3, 3, 3));
+        _mm256_storeu_si256((__m256i*) (out + i), lo);
+        _mm256_storeu_si256((__m256i*) (out + i + 4), hi);
+        offsets = _mm256_add_epi32(offsets, step);
+    }
+    if (i < count) {
+        unpack_prefix_sum_scalar(data, pos + i * width, width, count - i,
+                i ? out[i - 1] : base, out + i);
+    }
+}
+
+// Four fields per step: each lane gathers the 8 bytes holding its field,
+// byte swaps and shifts it into place, then the lanes are summed in two
+// shift-and-add rounds.
+__attribute__((target("avx2")))
+void unpack_prefix_sum_avx2(const unsigned char* data, size_t pos,
+        size_t width, size_t count, uint64_t base, uint64_t* out) {
+    if (!width || width > MAX_LOAD_WIDTH) {
+        unpack_prefix_sum_scalar(data, pos, width, count, base, out);
+        return;
+    }
+    if (width <= MAX_LOAD_WIDTH_32) {
+        unpack_prefix_sum_avx2_narrow(data, pos, width, count, base, out);
+        return;
+    }
+    const __m256i bswap = _mm256_setr_epi8(
+            7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+            7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    const __m256i seven = _mm256_set1_epi64x(7);
+    const __m256i step = _mm256_set1_epi64x(4 * width);
+    const __m128i rshift = _mm_cvtsi32_si128(64 - width);
+    __m256i offsets = _mm256_add_epi64(_mm256_set1_epi64x(pos),
+            _mm256_setr_epi64x(0, width, 2 * width, 3 * width));
+    __m256i carry = _mm256_set1_epi64x(base);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i words = _mm256_i64gather_epi64((const long long*) data,
+                _mm256_srli_epi64(offsets, 3), 1);
+        words = _mm256_shuffle_epi8(words, bswap);
+        words = _mm256_sllv_epi64(words, _mm256_and_si256(offsets, seven));
+        __m256i x = prefix_sum_avx2(_mm256_srl_epi64(words, rshift), carry);
+        _mm256_storeu_si256((__m256i*) (out + i), x);
+        carry = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 3, 3, 3));
+        offsets = _mm256_add_epi64(offsets, step);
+    }
+    if (i < count) {
+        unpack_prefix_sum_scalar(data, pos + i * width, width, count - i,
+                i ? out[i - 1] : base, out + i);
+    }
+}
+
+#endif
+
+typedef void (*Unpack_Kernel)(const unsigned char*, size_t, size_t, size_t,
+        uint64_t, uint64_t*);
+
+struct Kernel_Choice {
+    Unpack_Kernel kernel;
+    const char* name;
+};
+
+static Kernel_Choice pick_kernel() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {unpack_prefix_sum_avx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return {unpack_prefix_sum_sse2, "sse2"};
+    }
+#endif
+    return {unpack_prefix_sum_scalar, "scalar"};
+}
+
+static const Kernel_Choice& kernel_choice() {
+    static const Kernel_Choice choice = pick_kernel();
+    return choice;
+}
+
+void unpack_prefix_sum(const unsigned char* data, size_t pos, size_t width,
+        size_t count, uint64_t base, uint64_t* out) {
+    if (count < UNPACK_MIN_VECTOR_RUN) {
+        unpack_prefix_sum_scalar(data, pos, width, count, base, out);
+        return;
+    }
+    kernel_choice().kernel(data, pos, width, count, base, out);
+}
+
+const char* unpack_kernel_name() {
+    return kernel_choice().name;
+}
@@ -0,0 +1,36 @@
+#ifndef UNPACK_HH
+#define UNPACK_HH
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Reads count consecutive width-bit fields, most significant bit first,
+ * starting at bit pos of data, and writes their running sums, starting
+ * from base, to out. data must be readable for 16 bytes past the last
+ * field. The kernel (AVX2, SSE2 or scalar) is picked once from what the
+ * CPU supports, but runs shorter than UNPACK_MIN_VECTOR_RUN always take
+ * the scalar one.
+ */
+void unpack_prefix_sum(const unsigned char* data, size_t pos, size_t width,
+        size_t count, uint64_t base, uint64_t* out);
+
+// Below this many fields the vector kernels lose to the scalar one, which
+// unpack_bench shows for AVX2 at run length 4 but not at 8
+const size_t UNPACK_MIN_VECTOR_RUN = 8;
+
+// Name of the kernel unpack_prefix_sum uses for runs of at least
+// UNPACK_MIN_VECTOR_RUN
+const char* unpack_kernel_name();
+
+// The individual kernels, for testing and benchmarks
+void unpack_prefix_sum_scalar(const unsigned char* data, size_t pos,
+        size_t width, size_t count, uint64_t base, uint64_t* out);
+#if defined(__x86_64__)
+void unpack_prefix_sum_sse2(const unsigned char* data, size_t pos,
+        size_t width, size_t count, uint64_t base, uint64_t* out);
+void unpack_prefix_sum_avx2(const unsigned char* data, size_t pos,
+        size_t width, size_t count, uint64_t base, uint64_t* out);
+#endif
+
+#endif
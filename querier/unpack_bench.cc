@@ -0,0 +1,89 @@
+#include <random>
+
+#include "helpers.hh"
+#include "unpack.hh"
+
+/*
+ * Checks the unpack kernels against each other and times them on runs of
+ * random fields of each width, along with unpack_prefix_sum itself, which
+ * picks between them.
+ *
+ * Usage: ./unpack_bench [run length] [reps]
+ */
+
+typedef void (*Kernel)(const unsigned char*, size_t, size_t, size_t,
+        uint64_t, uint64_t*);
+
+// A positive count, or 0 if arg is not one
+static size_t parse_count(const char* arg) {
+    char* end;
+    long n = strtol(arg, &end, 10);
+    return *arg && !*end && n > 0 ? n : 0;
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? parse_count(argv[1]) : 1024;
+    size_t reps = argc > 2 ? parse_count(argv[2]) : 2000;
+    if (argc > 3 || !count || !reps) {
+        cerr << "Usage: ./unpack_bench [run length] [reps]" << endl;
+        return 1;
+    }
+
+    vector<pair<string, Kernel>> kernels = {{"scalar", unpack_prefix_sum_scalar}};
+#if defined(__x86_64__)
+    kernels.push_back({"sse2", unpack_prefix_sum_sse2});
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({"avx2", unpack_prefix_sum_avx2});
+    }
+#endif
+    kernels.push_back({"dispatch", unpack_prefix_sum});
+    cout << "dispatch: " << unpack_kernel_name() << ", scalar below run "
+        "length " << UNPACK_MIN_VECTOR_RUN << endl;
+    cout << "width";
+    for (auto& k : kernels) {
+        cout << "\t" << k.first << " ns/edge";
+    }
+    cout << endl;
+
+    std::mt19937_64 rng(1);
+    bool ok = true;
+    for (size_t width : {1, 3, 7, 12, 20, 32, 57, 64}) {
+        // a run starting at an odd bit, as runs inside a group usually do
+        size_t pos = 5;
+        string bytes((pos + count * width) / 8 + 1, '\0');
+        vector<uint64_t> expected(count);
+        uint64_t sum = 7;
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t v = width == 64 ? rng() : rng() & ((1ULL << width) - 1);
+            sum += v;
+            expected[i] = sum;
+            for (size_t b = 0; b < width; ++b) {
+                if ((v >> (width - 1 - b)) & 1) {
+                    size_t bit = pos + i * width + b;
+                    bytes[bit >> 3] |= 0x80 >> (bit & 7);
+                }
+            }
+        }
+        BitSet bs(bytes);
+
+        cout << width;
+        vector<uint64_t> out(count);
+        for (auto& k : kernels) {
+            k.second(bs.data(), pos, width, count, 7, out.data());
+            if (out != expected) {
+                cerr << k.first << " wrong at width " << width << endl;
+                ok = false;
+            }
+            auto start = std::chrono::steady_clock::now();
+            for (size_t r = 0; r < reps; ++r) {
+                k.second(bs.data(), pos, width, count, r, out.data());
+            }
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+            printf("\t%.3f", (double) ns / (reps * count));
+        }
+        cout << endl;
+    }
+    return ok ? 0 : 1;
+}